@@ -1,6 +1,42 @@
 /// @ref core
 
-namespace glm
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+
+#include "../simd/matrix.h"
+
+namespace glm{
+namespace detail
 {
+	template<qualifier Q>
+	struct compute_mat4_mul_vec4<float, Q, true>
+	{
+		GLM_FUNC_QUALIFIER static vec<4, float, Q> call(mat<4, 4, float, Q> const& m, vec<4, float, Q> const& v)
+		{
+			vec<4, float, Q> Result;
+#			if GLM_ARCH & GLM_ARCH_AVX2_BIT
+				Result.data = glm_mat4_mul_vec4_avx2(&m[0].data, v.data);
+#			else
+				Result.data = glm_mat4_mul_vec4(&m[0].data, v.data);
+#			endif
+			return Result;
+		}
+	};
 
+	template<qualifier Q>
+	struct compute_mat4_mul<float, Q, true>
+	{
+		GLM_FUNC_QUALIFIER static mat<4, 4, float, Q> call(mat<4, 4, float, Q> const& m1, mat<4, 4, float, Q> const& m2)
+		{
+			mat<4, 4, float, Q> Result;
+#			if GLM_ARCH & GLM_ARCH_AVX2_BIT
+				glm_mat4_mul_avx2(&m1[0].data, &m2[0].data, &Result[0].data);
+#			else
+				glm_mat4_mul(&m1[0].data, &m2[0].data, &Result[0].data);
+#			endif
+			return Result;
+		}
+	};
+}//namespace detail
 }//namespace glm
+
+#endif//GLM_ARCH & GLM_ARCH_SSE2_BIT
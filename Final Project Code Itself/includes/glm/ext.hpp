@@ -51,12 +51,14 @@
 #include "./ext/matrix_float4x4.hpp"
 #include "./ext/matrix_float4x4_precision.hpp"
 
+#include "./ext/matrix_batch.hpp"
 #include "./ext/matrix_relational.hpp"
 
 #include "./ext/quaternion_double.hpp"
 #include "./ext/quaternion_double_precision.hpp"
 #include "./ext/quaternion_float.hpp"
 #include "./ext/quaternion_float_precision.hpp"
+#include "./ext/quaternion_batch.hpp"
 #include "./ext/quaternion_geometric.hpp"
 #include "./ext/quaternion_relational.hpp"
 
@@ -0,0 +1,85 @@
+/// @ref ext_matrix_batch
+/// @file glm/ext/matrix_batch.hpp
+///
+/// @defgroup ext_matrix_batch GLM_EXT_matrix_batch
+/// @ingroup ext
+///
+/// Transforms whole arrays of points and matrices at once. Data is laid out as a structure of
+/// arrays (SoA): one float array per component, so each instruction works on 8 elements with
+/// AVX2 or 4 with SSE2, and the remaining elements are handled one at a time.
+///
+/// The SoA types are views over arrays owned by the caller. Arrays aligned to 32 bytes load
+/// fastest, but any alignment works. Only float data is supported.
+///
+/// Include <glm/ext/matrix_batch.hpp> to use the features of this extension.
+///
+/// @see ext_matrix_transform
+
+#pragma once
+
+// Dependencies
+#include "../mat3x3.hpp"
+#include "../mat4x4.hpp"
+#include <cmath>
+#include <cstddef>
+
+#if GLM_MESSAGES == GLM_ENABLE && !defined(GLM_EXT_INCLUDED)
+#	pragma message("GLM: GLM_EXT_matrix_batch extension included")
+#endif
+
+namespace glm
+{
+	/// @addtogroup ext_matrix_batch
+	/// @{
+
+	/// N three component vectors, one array per component.
+	struct soa_vec3
+	{
+		float* x;
+		float* y;
+		float* z;
+	};
+
+	/// N 3x3 matrices, one array per component: m[Column * 3 + Row][i] is element [Column][Row] of matrix i.
+	struct soa_mat3
+	{
+		float* m[9];
+	};
+
+	/// N 4x4 matrices, one array per component: m[Column * 4 + Row][i] is element [Column][Row] of matrix i.
+	struct soa_mat4
+	{
+		float* m[16];
+	};
+
+	/// Transforms Count points by the matrix: Out[i] = vec3(M * vec4(In[i], 1)), without a perspective divide.
+	/// Out may be the same arrays as In.
+	///
+	/// @tparam Q Value from qualifier enum
+	template<qualifier Q>
+	GLM_FUNC_DECL void transformPoints(mat<4, 4, float, Q> const& M, soa_vec3 const& In, soa_vec3 const& Out, std::size_t Count);
+
+	/// Multiplies Count pairs of matrices: Out[i] = A[i] * B[i].
+	/// Out must not share arrays with A or B.
+	GLM_FUNC_DECL void multiplyMatrices(soa_mat4 const& A, soa_mat4 const& B, soa_mat4 const& Out, std::size_t Count);
+
+	/// Computes Count normal matrices, the inverse transpose of the upper 3x3 of each model matrix:
+	/// Out[i] = transpose(inverse(mat3(Model[i]))).
+	GLM_FUNC_DECL void normalMatrices(soa_mat4 const& Model, soa_mat3 const& Out, std::size_t Count);
+
+	/// Stores matrix In in lane Index of Out.
+	///
+	/// @tparam Q Value from qualifier enum
+	template<qualifier Q>
+	GLM_FUNC_DECL void setMatrix(soa_mat4 const& Out, std::size_t Index, mat<4, 4, float, Q> const& In);
+
+	/// Returns the matrix in lane Index of In.
+	GLM_FUNC_DECL mat4 getMatrix(soa_mat4 const& In, std::size_t Index);
+
+	/// Returns the matrix in lane Index of In.
+	GLM_FUNC_DECL mat3 getMatrix(soa_mat3 const& In, std::size_t Index);
+
+	/// @}
+}//namespace glm
+
+#include "matrix_batch.inl"
@@ -0,0 +1,262 @@
+/// @ref ext_matrix_batch
+
+namespace glm{
+namespace detail
+{
+	// Packs of float lanes the batch kernels are written against. Each kernel runs with the widest
+	// pack available and hands what is left to the next narrower one, down to single floats.
+	struct batch_float1
+	{
+		typedef float type;
+		static std::size_t const width = 1;
+
+		GLM_FUNC_QUALIFIER static type load(float const* p) { return *p; }
+		GLM_FUNC_QUALIFIER static void store(float* p, type v) { *p = v; }
+		GLM_FUNC_QUALIFIER static type set1(float s) { return s; }
+		GLM_FUNC_QUALIFIER static type add(type a, type b) { return a + b; }
+		GLM_FUNC_QUALIFIER static type sub(type a, type b) { return a - b; }
+		GLM_FUNC_QUALIFIER static type mul(type a, type b) { return a * b; }
+		GLM_FUNC_QUALIFIER static type div(type a, type b) { return a / b; }
+		GLM_FUNC_QUALIFIER static type sqrt(type a) { return std::sqrt(a); }
+		GLM_FUNC_QUALIFIER static type fma(type a, type b, type c) { return a * b + c; }
+		GLM_FUNC_QUALIFIER static type fms(type a, type b, type c) { return a * b - c; }
+
+		// Negates the lanes of v where s is negative
+		GLM_FUNC_QUALIFIER static type negate_if_negative(type s, type v) { return s < 0.0f ? -v : v; }
+	};
+
+#	if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	struct batch_float4
+	{
+		typedef __m128 type;
+		static std::size_t const width = 4;
+
+		GLM_FUNC_QUALIFIER static type load(float const* p) { return _mm_loadu_ps(p); }
+		GLM_FUNC_QUALIFIER static void store(float* p, type v) { _mm_storeu_ps(p, v); }
+		GLM_FUNC_QUALIFIER static type set1(float s) { return _mm_set1_ps(s); }
+		GLM_FUNC_QUALIFIER static type add(type a, type b) { return _mm_add_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type sub(type a, type b) { return _mm_sub_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type mul(type a, type b) { return _mm_mul_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type div(type a, type b) { return _mm_div_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type sqrt(type a) { return _mm_sqrt_ps(a); }
+		GLM_FUNC_QUALIFIER static type fma(type a, type b, type c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		GLM_FUNC_QUALIFIER static type fms(type a, type b, type c) { return _mm_sub_ps(_mm_mul_ps(a, b), c); }
+
+		GLM_FUNC_QUALIFIER static type negate_if_negative(type s, type v)
+		{
+			__m128 const Negative = _mm_cmplt_ps(s, _mm_setzero_ps());
+			return _mm_xor_ps(v, _mm_and_ps(Negative, _mm_set1_ps(-0.0f)));
+		}
+	};
+#	endif
+
+#	if GLM_ARCH & GLM_ARCH_AVX2_BIT
+	struct batch_float8
+	{
+		typedef __m256 type;
+		static std::size_t const width = 8;
+
+		GLM_FUNC_QUALIFIER static type load(float const* p) { return _mm256_loadu_ps(p); }
+		GLM_FUNC_QUALIFIER static void store(float* p, type v) { _mm256_storeu_ps(p, v); }
+		GLM_FUNC_QUALIFIER static type set1(float s) { return _mm256_set1_ps(s); }
+		GLM_FUNC_QUALIFIER static type add(type a, type b) { return _mm256_add_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type sub(type a, type b) { return _mm256_sub_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type div(type a, type b) { return _mm256_div_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type sqrt(type a) { return _mm256_sqrt_ps(a); }
+
+		GLM_FUNC_QUALIFIER static type negate_if_negative(type s, type v)
+		{
+			__m256 const Negative = _mm256_cmp_ps(s, _mm256_setzero_ps(), _CMP_LT_OQ);
+			return _mm256_xor_ps(v, _mm256_and_ps(Negative, _mm256_set1_ps(-0.0f)));
+		}
+
+		// Fused only where the compiler emits FMA3, as in glm_mat4_fmadd_ps256
+		GLM_FUNC_QUALIFIER static type fma(type a, type b, type c)
+		{
+#			if (GLM_COMPILER & GLM_COMPILER_VC) || defined(__FMA__)
+				return _mm256_fmadd_ps(a, b, c);
+#			else
+				return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#			endif
+		}
+
+		GLM_FUNC_QUALIFIER static type fms(type a, type b, type c)
+		{
+#			if (GLM_COMPILER & GLM_COMPILER_VC) || defined(__FMA__)
+				return _mm256_fmsub_ps(a, b, c);
+#			else
+				return _mm256_sub_ps(_mm256_mul_ps(a, b), c);
+#			endif
+		}
+	};
+#	endif
+
+	// The kernels below process elements [First, Count) in whole packs and return where they stopped.
+	// Sums follow the order of the scalar mat4 code, so without FMA the results match it exactly.
+
+	template<typename pack>
+	GLM_FUNC_QUALIFIER std::size_t batch_transform_points(float const M[16], soa_vec3 const& In, soa_vec3 const& Out, std::size_t First, std::size_t Count)
+	{
+		typedef typename pack::type type;
+
+		type const m00 = pack::set1(M[0]), m01 = pack::set1(M[1]), m02 = pack::set1(M[2]);
+		type const m10 = pack::set1(M[4]), m11 = pack::set1(M[5]), m12 = pack::set1(M[6]);
+		type const m20 = pack::set1(M[8]), m21 = pack::set1(M[9]), m22 = pack::set1(M[10]);
+		type const m30 = pack::set1(M[12]), m31 = pack::set1(M[13]), m32 = pack::set1(M[14]);
+
+		std::size_t i = First;
+		for(; i + pack::width <= Count; i += pack::width)
+		{
+			type const x = pack::load(In.x + i);
+			type const y = pack::load(In.y + i);
+			type const z = pack::load(In.z + i);
+
+			// (M[0] * x + M[1] * y) + (M[2] * z + M[3])
+			pack::store(Out.x + i, pack::add(pack::fma(m10, y, pack::mul(m00, x)), pack::fma(m20, z, m30)));
+			pack::store(Out.y + i, pack::add(pack::fma(m11, y, pack::mul(m01, x)), pack::fma(m21, z, m31)));
+			pack::store(Out.z + i, pack::add(pack::fma(m12, y, pack::mul(m02, x)), pack::fma(m22, z, m32)));
+		}
+		return i;
+	}
+
+	template<typename pack>
+	GLM_FUNC_QUALIFIER std::size_t batch_multiply_matrices(soa_mat4 const& A, soa_mat4 const& B, soa_mat4 const& Out, std::size_t First, std::size_t Count)
+	{
+		typedef typename pack::type type;
+
+		std::size_t i = First;
+		for(; i + pack::width <= Count; i += pack::width)
+		{
+			for(int Column = 0; Column < 4; ++Column)
+			{
+				type const b0 = pack::load(B.m[Column * 4 + 0] + i);
+				type const b1 = pack::load(B.m[Column * 4 + 1] + i);
+				type const b2 = pack::load(B.m[Column * 4 + 2] + i);
+				type const b3 = pack::load(B.m[Column * 4 + 3] + i);
+
+				// Out[Column] = A[0] * B[Column][0] + A[1] * B[Column][1] + A[2] * B[Column][2] + A[3] * B[Column][3]
+				for(int Row = 0; Row < 4; ++Row)
+				{
+					type Sum = pack::mul(pack::load(A.m[0 + Row] + i), b0);
+					Sum = pack::fma(pack::load(A.m[4 + Row] + i), b1, Sum);
+					Sum = pack::fma(pack::load(A.m[8 + Row] + i), b2, Sum);
+					Sum = pack::fma(pack::load(A.m[12 + Row] + i), b3, Sum);
+					pack::store(Out.m[Column * 4 + Row] + i, Sum);
+				}
+			}
+		}
+		return i;
+	}
+
+	template<typename pack>
+	GLM_FUNC_QUALIFIER std::size_t batch_normal_matrices(soa_mat4 const& Model, soa_mat3 const& Out, std::size_t First, std::size_t Count)
+	{
+		typedef typename pack::type type;
+
+		std::size_t i = First;
+		for(; i + pack::width <= Count; i += pack::width)
+		{
+			type const ax = pack::load(Model.m[0] + i), ay = pack::load(Model.m[1] + i), az = pack::load(Model.m[2] + i);
+			type const bx = pack::load(Model.m[4] + i), by = pack::load(Model.m[5] + i), bz = pack::load(Model.m[6] + i);
+			type const cx = pack::load(Model.m[8] + i), cy = pack::load(Model.m[9] + i), cz = pack::load(Model.m[10] + i);
+
+			// The columns of the inverse transpose are cross(b, c), cross(c, a) and cross(a, b) over the determinant
+			type const bcx = pack::fms(by, cz, pack::mul(bz, cy));
+			type const bcy = pack::fms(bz, cx, pack::mul(bx, cz));
+			type const bcz = pack::fms(bx, cy, pack::mul(by, cx));
+
+			type const cax = pack::fms(cy, az, pack::mul(cz, ay));
+			type const cay = pack::fms(cz, ax, pack::mul(cx, az));
+			type const caz = pack::fms(cx, ay, pack::mul(cy, ax));
+
+			type const abx = pack::fms(ay, bz, pack::mul(az, by));
+			type const aby = pack::fms(az, bx, pack::mul(ax, bz));
+			type const abz = pack::fms(ax, by, pack::mul(ay, bx));
+
+			type const Determinant = pack::fma(az, bcz, pack::fma(ay, bcy, pack::mul(ax, bcx)));
+			type const OneOverDeterminant = pack::div(pack::set1(1.0f), Determinant);
+
+			pack::store(Out.m[0] + i, pack::mul(bcx, OneOverDeterminant));
+			pack::store(Out.m[1] + i, pack::mul(bcy, OneOverDeterminant));
+			pack::store(Out.m[2] + i, pack::mul(bcz, OneOverDeterminant));
+			pack::store(Out.m[3] + i, pack::mul(cax, OneOverDeterminant));
+			pack::store(Out.m[4] + i, pack::mul(cay, OneOverDeterminant));
+			pack::store(Out.m[5] + i, pack::mul(caz, OneOverDeterminant));
+			pack::store(Out.m[6] + i, pack::mul(abx, OneOverDeterminant));
+			pack::store(Out.m[7] + i, pack::mul(aby, OneOverDeterminant));
+			pack::store(Out.m[8] + i, pack::mul(abz, OneOverDeterminant));
+		}
+		return i;
+	}
+}//namespace detail
+
+	template<qualifier Q>
+	GLM_FUNC_QUALIFIER void transformPoints(mat<4, 4, float, Q> const& M, soa_vec3 const& In, soa_vec3 const& Out, std::size_t Count)
+	{
+		float const Values[16] = {
+			M[0][0], M[0][1], M[0][2], M[0][3],
+			M[1][0], M[1][1], M[1][2], M[1][3],
+			M[2][0], M[2][1], M[2][2], M[2][3],
+			M[3][0], M[3][1], M[3][2], M[3][3]};
+
+		std::size_t i = 0;
+#		if GLM_ARCH & GLM_ARCH_AVX2_BIT
+			i = detail::batch_transform_points<detail::batch_float8>(Values, In, Out, i, Count);
+#		endif
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			i = detail::batch_transform_points<detail::batch_float4>(Values, In, Out, i, Count);
+#		endif
+		detail::batch_transform_points<detail::batch_float1>(Values, In, Out, i, Count);
+	}
+
+	GLM_FUNC_QUALIFIER void multiplyMatrices(soa_mat4 const& A, soa_mat4 const& B, soa_mat4 const& Out, std::size_t Count)
+	{
+		std::size_t i = 0;
+#		if GLM_ARCH & GLM_ARCH_AVX2_BIT
+			i = detail::batch_multiply_matrices<detail::batch_float8>(A, B, Out, i, Count);
+#		endif
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			i = detail::batch_multiply_matrices<detail::batch_float4>(A, B, Out, i, Count);
+#		endif
+		detail::batch_multiply_matrices<detail::batch_float1>(A, B, Out, i, Count);
+	}
+
+	GLM_FUNC_QUALIFIER void normalMatrices(soa_mat4 const& Model, soa_mat3 const& Out, std::size_t Count)
+	{
+		std::size_t i = 0;
+#		if GLM_ARCH & GLM_ARCH_AVX2_BIT
+			i = detail::batch_normal_matrices<detail::batch_float8>(Model, Out, i, Count);
+#		endif
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			i = detail::batch_normal_matrices<detail::batch_float4>(Model, Out, i, Count);
+#		endif
+		detail::batch_normal_matrices<detail::batch_float1>(Model, Out, i, Count);
+	}
+
+	template<qualifier Q>
+	GLM_FUNC_QUALIFIER void setMatrix(soa_mat4 const& Out, std::size_t Index, mat<4, 4, float, Q> const& In)
+	{
+		for(length_t Column = 0; Column < 4; ++Column)
+		for(length_t Row = 0; Row < 4; ++Row)
+			Out.m[Column * 4 + Row][Index] = In[Column][Row];
+	}
+
+	GLM_FUNC_QUALIFIER mat4 getMatrix(soa_mat4 const& In, std::size_t Index)
+	{
+		mat4 Result;
+		for(length_t Column = 0; Column < 4; ++Column)
+		for(length_t Row = 0; Row < 4; ++Row)
+			Result[Column][Row] = In.m[Column * 4 + Row][Index];
+		return Result;
+	}
+
+	GLM_FUNC_QUALIFIER mat3 getMatrix(soa_mat3 const& In, std::size_t Index)
+	{
+		mat3 Result;
+		for(length_t Column = 0; Column < 3; ++Column)
+		for(length_t Row = 0; Row < 3; ++Row)
+			Result[Column][Row] = In.m[Column * 3 + Row][Index];
+		return Result;
+	}
+}//namespace glm
@@ -0,0 +1,73 @@
+/// @ref ext_quaternion_batch
+/// @file glm/ext/quaternion_batch.hpp
+///
+/// @defgroup ext_quaternion_batch GLM_EXT_quaternion_batch
+/// @ingroup ext
+///
+/// Multiplies, interpolates and converts whole arrays of quaternions at once, laid out as a
+/// structure of arrays like the types of GLM_EXT_matrix_batch. Each instruction works on 8
+/// quaternions with AVX2 or 4 with SSE2, and the remaining ones are handled one at a time.
+///
+/// slerpQuaternions evaluates sin(t * angle) / sin(angle) with a polynomial in cos(angle)
+/// (Eberly, "A Fast and Accurate Algorithm for Computing SLERP"), so it needs neither acos
+/// nor sin and has no special case for nearly equal quaternions. Its components stay within
+/// 2e-7 of the exact result for unit quaternions, the same as slerp in float.
+///
+/// Include <glm/ext/quaternion_batch.hpp> to use the features of this extension.
+///
+/// @see ext_matrix_batch
+/// @see ext_quaternion_common
+
+#pragma once
+
+// Dependencies
+#include "../ext/matrix_batch.hpp"
+#include "../ext/quaternion_float.hpp"
+#include <cstddef>
+
+#if GLM_MESSAGES == GLM_ENABLE && !defined(GLM_EXT_INCLUDED)
+#	pragma message("GLM: GLM_EXT_quaternion_batch extension included")
+#endif
+
+namespace glm
+{
+	/// @addtogroup ext_quaternion_batch
+	/// @{
+
+	/// N quaternions, one array per component.
+	struct soa_quat
+	{
+		float* x;
+		float* y;
+		float* z;
+		float* w;
+	};
+
+	/// Multiplies Count pairs of quaternions: Out[i] = A[i] * B[i].
+	/// Out may be the same arrays as A or B.
+	GLM_FUNC_DECL void multiplyQuaternions(soa_quat const& A, soa_quat const& B, soa_quat const& Out, std::size_t Count);
+
+	/// Normalized linear interpolation along the shortest path: Out[i] = normalize(mix(A[i], +-B[i], Factors[i])).
+	/// Out may be the same arrays as A or B.
+	GLM_FUNC_DECL void nlerpQuaternions(soa_quat const& A, soa_quat const& B, float const* Factors, soa_quat const& Out, std::size_t Count);
+
+	/// Spherical linear interpolation along the shortest path, as slerp: Out[i] = slerp(A[i], B[i], Factors[i]).
+	/// A and B must be unit quaternions and Factors in [0, 1]. Out may be the same arrays as A or B.
+	GLM_FUNC_DECL void slerpQuaternions(soa_quat const& A, soa_quat const& B, float const* Factors, soa_quat const& Out, std::size_t Count);
+
+	/// Converts Count unit quaternions to rotation matrices, as mat4_cast: Out[i] = mat4_cast(In[i]).
+	GLM_FUNC_DECL void rotationMatrices(soa_quat const& In, soa_mat4 const& Out, std::size_t Count);
+
+	/// Stores quaternion In in lane Index of Out.
+	///
+	/// @tparam Q Value from qualifier enum
+	template<qualifier Q>
+	GLM_FUNC_DECL void setQuaternion(soa_quat const& Out, std::size_t Index, qua<float, Q> const& In);
+
+	/// Returns the quaternion in lane Index of In.
+	GLM_FUNC_DECL quat getQuaternion(soa_quat const& In, std::size_t Index);
+
+	/// @}
+}//namespace glm
+
+#include "quaternion_batch.inl"
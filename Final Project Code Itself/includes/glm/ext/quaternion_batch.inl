@@ -0,0 +1,232 @@
+/// @ref ext_quaternion_batch
+
+namespace glm{
+namespace detail
+{
+	// The kernels below process quaternions [First, Count) in whole packs of GLM_EXT_matrix_batch
+	// and return where they stopped. Products and sums follow the order of the scalar quaternion
+	// code, so without FMA the products and matrices match it exactly.
+
+	template<typename pack>
+	GLM_FUNC_QUALIFIER std::size_t batch_multiply_quaternions(soa_quat const& A, soa_quat const& B, soa_quat const& Out, std::size_t First, std::size_t Count)
+	{
+		typedef typename pack::type type;
+
+		std::size_t i = First;
+		for(; i + pack::width <= Count; i += pack::width)
+		{
+			type const px = pack::load(A.x + i), py = pack::load(A.y + i), pz = pack::load(A.z + i), pw = pack::load(A.w + i);
+			type const qx = pack::load(B.x + i), qy = pack::load(B.y + i), qz = pack::load(B.z + i), qw = pack::load(B.w + i);
+
+			pack::store(Out.w + i, pack::sub(pack::sub(pack::fms(pw, qw, pack::mul(px, qx)), pack::mul(py, qy)), pack::mul(pz, qz)));
+			pack::store(Out.x + i, pack::sub(pack::fma(py, qz, pack::fma(px, qw, pack::mul(pw, qx))), pack::mul(pz, qy)));
+			pack::store(Out.y + i, pack::sub(pack::fma(pz, qx, pack::fma(py, qw, pack::mul(pw, qy))), pack::mul(px, qz)));
+			pack::store(Out.z + i, pack::sub(pack::fma(px, qy, pack::fma(pz, qw, pack::mul(pw, qz))), pack::mul(py, qx)));
+		}
+		return i;
+	}
+
+	template<typename pack>
+	GLM_FUNC_QUALIFIER std::size_t batch_nlerp_quaternions(soa_quat const& A, soa_quat const& B, float const* Factors, soa_quat const& Out, std::size_t First, std::size_t Count)
+	{
+		typedef typename pack::type type;
+
+		type const One = pack::set1(1.0f);
+
+		std::size_t i = First;
+		for(; i + pack::width <= Count; i += pack::width)
+		{
+			type const ax = pack::load(A.x + i), ay = pack::load(A.y + i), az = pack::load(A.z + i), aw = pack::load(A.w + i);
+			type const bx = pack::load(B.x + i), by = pack::load(B.y + i), bz = pack::load(B.z + i), bw = pack::load(B.w + i);
+			type const t = pack::load(Factors + i);
+			type const s = pack::sub(One, t);
+
+			// Negate B where the quaternions are more than 90 degrees apart, to take the shorter path
+			type const CosTheta = pack::fma(aw, bw, pack::fma(az, bz, pack::fma(ay, by, pack::mul(ax, bx))));
+			type const t1 = pack::negate_if_negative(CosTheta, t);
+
+			type const x = pack::fma(bx, t1, pack::mul(ax, s));
+			type const y = pack::fma(by, t1, pack::mul(ay, s));
+			type const z = pack::fma(bz, t1, pack::mul(az, s));
+			type const w = pack::fma(bw, t1, pack::mul(aw, s));
+
+			type const OneOverLength = pack::div(One, pack::sqrt(pack::fma(w, w, pack::fma(z, z, pack::fma(y, y, pack::mul(x, x))))));
+			pack::store(Out.x + i, pack::mul(x, OneOverLength));
+			pack::store(Out.y + i, pack::mul(y, OneOverLength));
+			pack::store(Out.z + i, pack::mul(z, OneOverLength));
+			pack::store(Out.w + i, pack::mul(w, OneOverLength));
+		}
+		return i;
+	}
+
+	// sin(t * angle) / sin(angle) as a polynomial in x - 1, where x = cos(angle) is in [0, 1]:
+	// t * (1 + b1 * (1 + b2 * (1 + ... b16))), with bi = (t * t / (i * (2i + 1)) - i / (2i + 1)) * (x - 1).
+	// The last term is scaled by Mu to absorb the truncated series, which keeps the error of the
+	// weights below 3.1e-8 over the whole range.
+	// Both weights are evaluated together, to share the coefficients: WeightS for s, WeightT for t.
+	template<typename pack>
+	GLM_FUNC_QUALIFIER void batch_slerp_weights(typename pack::type s, typename pack::type t, typename pack::type xm1, typename pack::type& WeightS, typename pack::type& WeightT)
+	{
+		static float const Mu = 1.91666681f;
+		static float const U[16] = {
+			1.0f / 3, 1.0f / 10, 1.0f / 21, 1.0f / 36, 1.0f / 55,
+			1.0f / 78, 1.0f / 105, 1.0f / 136, 1.0f / 171, 1.0f / 210,
+			1.0f / 253, 1.0f / 300, 1.0f / 351, 1.0f / 406, 1.0f / 465,
+			Mu / 528};
+		static float const V[16] = {
+			1.0f / 3, 2.0f / 5, 3.0f / 7, 4.0f / 9, 5.0f / 11,
+			6.0f / 13, 7.0f / 15, 8.0f / 17, 9.0f / 19, 10.0f / 21,
+			11.0f / 23, 12.0f / 25, 13.0f / 27, 14.0f / 29, 15.0f / 31,
+			Mu * 16 / 33};
+
+		typename pack::type const ss = pack::mul(s, s);
+		typename pack::type const tt = pack::mul(t, t);
+		typename pack::type const One = pack::set1(1.0f);
+
+		typename pack::type ResultS = One;
+		typename pack::type ResultT = One;
+		for(int Term = 15; Term >= 0; --Term)
+		{
+			typename pack::type const u = pack::set1(U[Term]);
+			typename pack::type const v = pack::set1(V[Term]);
+			ResultS = pack::fma(pack::mul(pack::fms(u, ss, v), xm1), ResultS, One);
+			ResultT = pack::fma(pack::mul(pack::fms(u, tt, v), xm1), ResultT, One);
+		}
+		WeightS = pack::mul(s, ResultS);
+		WeightT = pack::mul(t, ResultT);
+	}
+
+	template<typename pack>
+	GLM_FUNC_QUALIFIER std::size_t batch_slerp_quaternions(soa_quat const& A, soa_quat const& B, float const* Factors, soa_quat const& Out, std::size_t First, std::size_t Count)
+	{
+		typedef typename pack::type type;
+
+		type const One = pack::set1(1.0f);
+
+		std::size_t i = First;
+		for(; i + pack::width <= Count; i += pack::width)
+		{
+			type const ax = pack::load(A.x + i), ay = pack::load(A.y + i), az = pack::load(A.z + i), aw = pack::load(A.w + i);
+			type const bx = pack::load(B.x + i), by = pack::load(B.y + i), bz = pack::load(B.z + i), bw = pack::load(B.w + i);
+			type const t = pack::load(Factors + i);
+
+			// Take the shorter path as slerp does: negate B, and so cos(angle), where it is negative
+			type const CosTheta = pack::fma(aw, bw, pack::fma(az, bz, pack::fma(ay, by, pack::mul(ax, bx))));
+			type const xm1 = pack::sub(pack::negate_if_negative(CosTheta, CosTheta), One);
+
+			type WeightA, WeightB;
+			batch_slerp_weights<pack>(pack::sub(One, t), t, xm1, WeightA, WeightB);
+			WeightB = pack::negate_if_negative(CosTheta, WeightB);
+
+			pack::store(Out.x + i, pack::fma(bx, WeightB, pack::mul(ax, WeightA)));
+			pack::store(Out.y + i, pack::fma(by, WeightB, pack::mul(ay, WeightA)));
+			pack::store(Out.z + i, pack::fma(bz, WeightB, pack::mul(az, WeightA)));
+			pack::store(Out.w + i, pack::fma(bw, WeightB, pack::mul(aw, WeightA)));
+		}
+		return i;
+	}
+
+	template<typename pack>
+	GLM_FUNC_QUALIFIER std::size_t batch_rotation_matrices(soa_quat const& In, soa_mat4 const& Out, std::size_t First, std::size_t Count)
+	{
+		typedef typename pack::type type;
+
+		type const Zero = pack::set1(0.0f);
+		type const One = pack::set1(1.0f);
+		type const Two = pack::set1(2.0f);
+
+		std::size_t i = First;
+		for(; i + pack::width <= Count; i += pack::width)
+		{
+			type const x = pack::load(In.x + i), y = pack::load(In.y + i), z = pack::load(In.z + i), w = pack::load(In.w + i);
+
+			type const qxx = pack::mul(x, x), qyy = pack::mul(y, y), qzz = pack::mul(z, z);
+			type const qxz = pack::mul(x, z), qxy = pack::mul(x, y), qyz = pack::mul(y, z);
+			type const qwx = pack::mul(w, x), qwy = pack::mul(w, y), qwz = pack::mul(w, z);
+
+			pack::store(Out.m[0] + i, pack::sub(One, pack::mul(Two, pack::add(qyy, qzz))));
+			pack::store(Out.m[1] + i, pack::mul(Two, pack::add(qxy, qwz)));
+			pack::store(Out.m[2] + i, pack::mul(Two, pack::sub(qxz, qwy)));
+			pack::store(Out.m[3] + i, Zero);
+
+			pack::store(Out.m[4] + i, pack::mul(Two, pack::sub(qxy, qwz)));
+			pack::store(Out.m[5] + i, pack::sub(One, pack::mul(Two, pack::add(qxx, qzz))));
+			pack::store(Out.m[6] + i, pack::mul(Two, pack::add(qyz, qwx)));
+			pack::store(Out.m[7] + i, Zero);
+
+			pack::store(Out.m[8] + i, pack::mul(Two, pack::add(qxz, qwy)));
+			pack::store(Out.m[9] + i, pack::mul(Two, pack::sub(qyz, qwx)));
+			pack::store(Out.m[10] + i, pack::sub(One, pack::mul(Two, pack::add(qxx, qyy))));
+			pack::store(Out.m[11] + i, Zero);
+
+			pack::store(Out.m[12] + i, Zero);
+			pack::store(Out.m[13] + i, Zero);
+			pack::store(Out.m[14] + i, Zero);
+			pack::store(Out.m[15] + i, One);
+		}
+		return i;
+	}
+}//namespace detail
+
+	GLM_FUNC_QUALIFIER void multiplyQuaternions(soa_quat const& A, soa_quat const& B, soa_quat const& Out, std::size_t Count)
+	{
+		std::size_t i = 0;
+#		if GLM_ARCH & GLM_ARCH_AVX2_BIT
+			i = detail::batch_multiply_quaternions<detail::batch_float8>(A, B, Out, i, Count);
+#		endif
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			i = detail::batch_multiply_quaternions<detail::batch_float4>(A, B, Out, i, Count);
+#		endif
+		detail::batch_multiply_quaternions<detail::batch_float1>(A, B, Out, i, Count);
+	}
+
+	GLM_FUNC_QUALIFIER void nlerpQuaternions(soa_quat const& A, soa_quat const& B, float const* Factors, soa_quat const& Out, std::size_t Count)
+	{
+		std::size_t i = 0;
+#		if GLM_ARCH & GLM_ARCH_AVX2_BIT
+			i = detail::batch_nlerp_quaternions<detail::batch_float8>(A, B, Factors, Out, i, Count);
+#		endif
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			i = detail::batch_nlerp_quaternions<detail::batch_float4>(A, B, Factors, Out, i, Count);
+#		endif
+		detail::batch_nlerp_quaternions<detail::batch_float1>(A, B, Factors, Out, i, Count);
+	}
+
+	GLM_FUNC_QUALIFIER void slerpQuaternions(soa_quat const& A, soa_quat const& B, float const* Factors, soa_quat const& Out, std::size_t Count)
+	{
+		std::size_t i = 0;
+#		if GLM_ARCH & GLM_ARCH_AVX2_BIT
+			i = detail::batch_slerp_quaternions<detail::batch_float8>(A, B, Factors, Out, i, Count);
+#		endif
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			i = detail::batch_slerp_quaternions<detail::batch_float4>(A, B, Factors, Out, i, Count);
+#		endif
+		detail::batch_slerp_quaternions<detail::batch_float1>(A, B, Factors, Out, i, Count);
+	}
+
+	GLM_FUNC_QUALIFIER void rotationMatrices(soa_quat const& In, soa_mat4 const& Out, std::size_t Count)
+	{
+		std::size_t i = 0;
+#		if GLM_ARCH & GLM_ARCH_AVX2_BIT
+			i = detail::batch_rotation_matrices<detail::batch_float8>(In, Out, i, Count);
+#		endif
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			i = detail::batch_rotation_matrices<detail::batch_float4>(In, Out, i, Count);
+#		endif
+		detail::batch_rotation_matrices<detail::batch_float1>(In, Out, i, Count);
+	}
+
+	template<qualifier Q>
+	GLM_FUNC_QUALIFIER void setQuaternion(soa_quat const& Out, std::size_t Index, qua<float, Q> const& In)
+	{
+		Out.x[Index] = In.x;
+		Out.y[Index] = In.y;
+		Out.z[Index] = In.z;
+		Out.w[Index] = In.w;
+	}
+
+	GLM_FUNC_QUALIFIER quat getQuaternion(soa_quat const& In, std::size_t Index)
+	{
+		return quat(In.w[Index], In.x[Index], In.y[Index], In.z[Index]);
+	}
+}//namespace glm
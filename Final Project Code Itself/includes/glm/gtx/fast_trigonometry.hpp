@@ -9,11 +9,22 @@
 /// Include <glm/gtx/fast_trigonometry.hpp> to use the features of this extension.
 ///
 /// Fast but less accurate implementations of trigonometric functions.
+///
+/// fastSinCos computes the sine and cosine of whole arrays of float angles, 8 at a time with
+/// AVX2 and 4 with SSE2. Its largest absolute error, over angles in [-1e4, 1e4], is:
+/// - trig_accuracy_low: 3.3e-4
+/// - trig_accuracy_medium: 1.1e-6
+/// - trig_accuracy_high: 1e-7, within a few ulp of std::sin and std::cos
+///
+/// The angle is reduced to [-pi/4, pi/4] in float precision, which stays accurate up to about 1e5.
+/// Larger angles lose bits in the reduction, up to an error of 3e-2 at 1e6 (less with FMA), so
+/// angles that keep growing, like accumulated time, should be wrapped by the caller.
 
 #pragma once
 
 // Dependency:
 #include "../gtc/constants.hpp"
+#include <cstddef>
 
 #if GLM_MESSAGES == GLM_ENABLE && !defined(GLM_EXT_INCLUDED)
 #	ifndef GLM_ENABLE_EXPERIMENTAL
@@ -28,6 +39,15 @@ namespace glm
 	/// @addtogroup gtx_fast_trigonometry
 	/// @{
 
+	/// Polynomial used by fastSinCos, from the fastest to the most accurate.
+	/// From GLM_GTX_fast_trigonometry extension.
+	enum trig_accuracy
+	{
+		trig_accuracy_low,		///< Degree 3 sine and degree 4 cosine
+		trig_accuracy_medium,	///< Degree 5 sine and degree 6 cosine
+		trig_accuracy_high		///< Degree 7 sine and degree 8 cosine
+	};
+
 	/// Wrap an angle to [0 2pi[
 	/// From GLM_GTX_fast_trigonometry extension.
 	template<typename T>
@@ -73,6 +93,16 @@ namespace glm
 	template<typename T>
 	GLM_FUNC_DECL T fastAtan(T angle);
 
+	/// Computes Sines[i] = sin(Angles[i]) and Cosines[i] = cos(Angles[i]) for Count angles.
+	/// Sines or Cosines may be the Angles array itself.
+	/// From GLM_GTX_fast_trigonometry extension.
+	GLM_FUNC_DECL void fastSinCos(float const* Angles, float* Sines, float* Cosines, std::size_t Count, trig_accuracy Accuracy = trig_accuracy_high);
+
+	/// Computes the sine and cosine of each component of Angles.
+	/// From GLM_GTX_fast_trigonometry extension.
+	template<length_t L, qualifier Q>
+	GLM_FUNC_DECL void fastSinCos(vec<L, float, Q> const& Angles, vec<L, float, Q>& Sines, vec<L, float, Q>& Cosines, trig_accuracy Accuracy = trig_accuracy_high);
+
 	/// @}
 }//namespace glm
 
@@ -139,4 +139,243 @@ namespace detail
 	{
 		return detail::functor1<vec, L, T, T, Q>::call(fastAtan, x);
 	}
+
+namespace detail
+{
+	// Packs of float lanes for the fastSinCos kernel, with the integer quadrant of each lane
+	// kept alongside. Each call runs the widest pack available and hands what is left to the
+	// next narrower one, down to single floats.
+	struct sincos_float1
+	{
+		typedef float type;
+		typedef int itype;
+		static std::size_t const width = 1;
+
+		GLM_FUNC_QUALIFIER static type load(float const* p) { return *p; }
+		GLM_FUNC_QUALIFIER static void store(float* p, type v) { *p = v; }
+		GLM_FUNC_QUALIFIER static type set1(float s) { return s; }
+		GLM_FUNC_QUALIFIER static type mul(type a, type b) { return a * b; }
+		GLM_FUNC_QUALIFIER static type fma(type a, type b, type c) { return a * b + c; }
+		GLM_FUNC_QUALIFIER static type fnma(type a, type b, type c) { return c - a * b; }
+		GLM_FUNC_QUALIFIER static itype round(type a) { return static_cast<int>(a < 0.0f ? a - 0.5f : a + 0.5f); }
+		GLM_FUNC_QUALIFIER static type convert(itype a) { return static_cast<float>(a); }
+		GLM_FUNC_QUALIFIER static itype increment(itype a) { return a + 1; }
+
+		// Lanes whose quadrant is odd take b instead of a
+		GLM_FUNC_QUALIFIER static type swap_odd(itype q, type a, type b) { return (q & 1) ? b : a; }
+
+		// Lanes whose quadrant has bit 1 set are negated
+		GLM_FUNC_QUALIFIER static type negate_bit1(itype q, type a) { return (q & 2) ? -a : a; }
+	};
+
+#	if GLM_ARCH & GLM_ARCH_SSE2_BIT
+	struct sincos_float4
+	{
+		typedef __m128 type;
+		typedef __m128i itype;
+		static std::size_t const width = 4;
+
+		GLM_FUNC_QUALIFIER static type load(float const* p) { return _mm_loadu_ps(p); }
+		GLM_FUNC_QUALIFIER static void store(float* p, type v) { _mm_storeu_ps(p, v); }
+		GLM_FUNC_QUALIFIER static type set1(float s) { return _mm_set1_ps(s); }
+		GLM_FUNC_QUALIFIER static type mul(type a, type b) { return _mm_mul_ps(a, b); }
+		GLM_FUNC_QUALIFIER static type fma(type a, type b, type c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		GLM_FUNC_QUALIFIER static type fnma(type a, type b, type c) { return _mm_sub_ps(c, _mm_mul_ps(a, b)); }
+		GLM_FUNC_QUALIFIER static itype round(type a) { return _mm_cvtps_epi32(a); }
+		GLM_FUNC_QUALIFIER static type convert(itype a) { return _mm_cvtepi32_ps(a); }
+		GLM_FUNC_QUALIFIER static itype increment(itype a) { return _mm_add_epi32(a, _mm_set1_epi32(1)); }
+
+		GLM_FUNC_QUALIFIER static type swap_odd(itype q, type a, type b)
+		{
+			__m128i const one = _mm_set1_epi32(1);
+			__m128 const mask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, one), one));
+			return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+		}
+
+		GLM_FUNC_QUALIFIER static type negate_bit1(itype q, type a)
+		{
+			return _mm_xor_ps(a, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30)));
+		}
+	};
+#	endif
+
+#	if GLM_ARCH & GLM_ARCH_AVX2_BIT
+	struct sincos_float8
+	{
+		typedef __m256 type;
+		typedef __m256i itype;
+		static std::size_t const width = 8;
+
+		GLM_FUNC_QUALIFIER static type load(float const* p) { return _mm256_loadu_ps(p); }
+		GLM_FUNC_QUALIFIER static void store(float* p, type v) { _mm256_storeu_ps(p, v); }
+		GLM_FUNC_QUALIFIER static type set1(float s) { return _mm256_set1_ps(s); }
+		GLM_FUNC_QUALIFIER static type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+
+		// Fused only where the compiler emits FMA3, as in glm_mat4_fmadd_ps256
+		GLM_FUNC_QUALIFIER static type fma(type a, type b, type c)
+		{
+#			if (GLM_COMPILER & GLM_COMPILER_VC) || defined(__FMA__)
+				return _mm256_fmadd_ps(a, b, c);
+#			else
+				return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#			endif
+		}
+
+		GLM_FUNC_QUALIFIER static type fnma(type a, type b, type c)
+		{
+#			if (GLM_COMPILER & GLM_COMPILER_VC) || defined(__FMA__)
+				return _mm256_fnmadd_ps(a, b, c);
+#			else
+				return _mm256_sub_ps(c, _mm256_mul_ps(a, b));
+#			endif
+		}
+
+		GLM_FUNC_QUALIFIER static itype round(type a) { return _mm256_cvtps_epi32(a); }
+		GLM_FUNC_QUALIFIER static type convert(itype a) { return _mm256_cvtepi32_ps(a); }
+		GLM_FUNC_QUALIFIER static itype increment(itype a) { return _mm256_add_epi32(a, _mm256_set1_epi32(1)); }
+
+		GLM_FUNC_QUALIFIER static type swap_odd(itype q, type a, type b)
+		{
+			__m256i const one = _mm256_set1_epi32(1);
+			return _mm256_blendv_ps(a, b, _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, one), one)));
+		}
+
+		GLM_FUNC_QUALIFIER static type negate_bit1(itype q, type a)
+		{
+			return _mm256_xor_ps(a, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, _mm256_set1_epi32(2)), 30)));
+		}
+	};
+#	endif
+
+	// Minimax polynomials for sin and cos on [-pi/4, pi/4], taking r and r * r
+	template<trig_accuracy Accuracy>
+	struct sincos_poly;
+
+	template<>
+	struct sincos_poly<trig_accuracy_low>
+	{
+		template<typename pack>
+		GLM_FUNC_QUALIFIER static typename pack::type sin(typename pack::type r, typename pack::type rr)
+		{
+			return pack::fma(pack::mul(r, rr), pack::set1(-1.6225911488e-1f), r);
+		}
+
+		template<typename pack>
+		GLM_FUNC_QUALIFIER static typename pack::type cos(typename pack::type rr)
+		{
+			typename pack::type const p = pack::fma(rr, pack::set1(4.0488936813e-2f), pack::set1(-4.9977630756e-1f));
+			return pack::fma(p, rr, pack::set1(1.0f));
+		}
+	};
+
+	template<>
+	struct sincos_poly<trig_accuracy_medium>
+	{
+		template<typename pack>
+		GLM_FUNC_QUALIFIER static typename pack::type sin(typename pack::type r, typename pack::type rr)
+		{
+			typename pack::type const p = pack::fma(rr, pack::set1(8.1529919662e-3f), pack::set1(-1.6662833786e-1f));
+			return pack::fma(pack::mul(r, rr), p, r);
+		}
+
+		template<typename pack>
+		GLM_FUNC_QUALIFIER static typename pack::type cos(typename pack::type rr)
+		{
+			typename pack::type const p = pack::fma(rr, pack::set1(-1.3652449421e-3f), pack::set1(4.1661278581e-2f));
+			return pack::fma(pack::mul(rr, rr), p, pack::fnma(rr, pack::set1(0.5f), pack::set1(1.0f)));
+		}
+	};
+
+	template<>
+	struct sincos_poly<trig_accuracy_high>
+	{
+		template<typename pack>
+		GLM_FUNC_QUALIFIER static typename pack::type sin(typename pack::type r, typename pack::type rr)
+		{
+			typename pack::type p = pack::fma(rr, pack::set1(-1.9495635999e-4f), pack::set1(8.3319786607e-3f));
+			p = pack::fma(p, rr, pack::set1(-1.6666650669e-1f));
+			return pack::fma(pack::mul(r, rr), p, r);
+		}
+
+		template<typename pack>
+		GLM_FUNC_QUALIFIER static typename pack::type cos(typename pack::type rr)
+		{
+			typename pack::type p = pack::fma(rr, pack::set1(2.4438451062e-5f), pack::set1(-1.3887367510e-3f));
+			p = pack::fma(p, rr, pack::set1(4.1666646866e-2f));
+			return pack::fma(pack::mul(rr, rr), p, pack::fnma(rr, pack::set1(0.5f), pack::set1(1.0f)));
+		}
+	};
+
+	// Processes angles [First, Count) in whole packs and returns where it stopped. Each angle is
+	// reduced to r in [-pi/4, pi/4] and a quadrant q, with pi/2 split in three parts (Cody-Waite)
+	// so that q * part is exact; the quadrant then swaps and negates the two polynomials.
+	template<typename pack, trig_accuracy Accuracy>
+	GLM_FUNC_QUALIFIER std::size_t batch_sincos(float const* Angles, float* Sines, float* Cosines, std::size_t First, std::size_t Count)
+	{
+		typedef typename pack::type type;
+		typedef typename pack::itype itype;
+
+		type const TwoOverPi = pack::set1(0.636619772367581343f);
+		type const HalfPi1 = pack::set1(1.5703125f);
+		type const HalfPi2 = pack::set1(4.837512969970703125e-4f);
+		type const HalfPi3 = pack::set1(7.54978995489188216e-8f);
+
+		std::size_t i = First;
+		for(; i + pack::width <= Count; i += pack::width)
+		{
+			type const x = pack::load(Angles + i);
+			itype const q = pack::round(pack::mul(x, TwoOverPi));
+			type const qf = pack::convert(q);
+
+			type r = pack::fnma(qf, HalfPi1, x);
+			r = pack::fnma(qf, HalfPi2, r);
+			r = pack::fnma(qf, HalfPi3, r);
+			type const rr = pack::mul(r, r);
+
+			type const s = sincos_poly<Accuracy>::template sin<pack>(r, rr);
+			type const c = sincos_poly<Accuracy>::template cos<pack>(rr);
+
+			// sin(x) is s, c, -s, -c and cos(x) is c, -s, -c, s for quadrants 0 to 3
+			pack::store(Sines + i, pack::negate_bit1(q, pack::swap_odd(q, s, c)));
+			pack::store(Cosines + i, pack::negate_bit1(pack::increment(q), pack::swap_odd(q, c, s)));
+		}
+		return i;
+	}
+
+	template<trig_accuracy Accuracy>
+	GLM_FUNC_QUALIFIER void call_batch_sincos(float const* Angles, float* Sines, float* Cosines, std::size_t Count)
+	{
+		std::size_t i = 0;
+#		if GLM_ARCH & GLM_ARCH_AVX2_BIT
+			i = batch_sincos<sincos_float8, Accuracy>(Angles, Sines, Cosines, i, Count);
+#		endif
+#		if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			i = batch_sincos<sincos_float4, Accuracy>(Angles, Sines, Cosines, i, Count);
+#		endif
+		batch_sincos<sincos_float1, Accuracy>(Angles, Sines, Cosines, i, Count);
+	}
+}//namespace detail
+
+	// sincos
+	GLM_FUNC_QUALIFIER void fastSinCos(float const* Angles, float* Sines, float* Cosines, std::size_t Count, trig_accuracy Accuracy)
+	{
+		switch(Accuracy)
+		{
+		case trig_accuracy_low:
+			detail::call_batch_sincos<trig_accuracy_low>(Angles, Sines, Cosines, Count);
+			break;
+		case trig_accuracy_medium:
+			detail::call_batch_sincos<trig_accuracy_medium>(Angles, Sines, Cosines, Count);
+			break;
+		default:
+			detail::call_batch_sincos<trig_accuracy_high>(Angles, Sines, Cosines, Count);
+			break;
+		}
+	}
+
+	template<length_t L, qualifier Q>
+	GLM_FUNC_QUALIFIER void fastSinCos(vec<L, float, Q> const& Angles, vec<L, float, Q>& Sines, vec<L, float, Q>& Cosines, trig_accuracy Accuracy)
+	{
+		fastSinCos(&Angles[0], &Sines[0], &Cosines[0], static_cast<std::size_t>(L), Accuracy);
+	}
 }//namespace glm
@@ -1025,4 +1025,162 @@ GLM_FUNC_QUALIFIER void glm_mat4_outerProduct(__m128 const& c, __m128 const& r,
 	out[3] = _mm_mul_ps(c, _mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 3, 3, 3)));
 }
 
+#if GLM_ARCH & GLM_ARCH_AVX2_BIT
+
+// Every AVX2 CPU has FMA3, but GCC and Clang only emit it when -mfma (or -march=haswell or later) is given as well
+GLM_FUNC_QUALIFIER __m128 glm_mat4_fmsub_ps(__m128 a, __m128 b, __m128 c)
+{
+#	if (GLM_COMPILER & GLM_COMPILER_VC) || defined(__FMA__)
+		return _mm_fmsub_ps(a, b, c);
+#	else
+		return _mm_sub_ps(_mm_mul_ps(a, b), c);
+#	endif
+}
+
+GLM_FUNC_QUALIFIER __m256 glm_mat4_fmadd_ps256(__m256 a, __m256 b, __m256 c)
+{
+#	if (GLM_COMPILER & GLM_COMPILER_VC) || defined(__FMA__)
+		return _mm256_fmadd_ps(a, b, c);
+#	else
+		return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#	endif
+}
+
+GLM_FUNC_QUALIFIER __m256 glm_mat4_fnmadd_ps256(__m256 a, __m256 b, __m256 c)
+{
+#	if (GLM_COMPILER & GLM_COMPILER_VC) || defined(__FMA__)
+		return _mm256_fnmadd_ps(a, b, c);
+#	else
+		return _mm256_sub_ps(c, _mm256_mul_ps(a, b));
+#	endif
+}
+
+// Two columns in one register, lo in the low lane
+GLM_FUNC_QUALIFIER __m256 glm_mat4_columns_ps256(__m128 lo, __m128 hi)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+GLM_FUNC_QUALIFIER glm_vec4 glm_mat4_mul_vec4_avx2(glm_vec4 const m[4], glm_vec4 v)
+{
+	__m256 m01 = _mm256_loadu_ps(reinterpret_cast<float const*>(&m[0]));
+	__m256 m23 = _mm256_loadu_ps(reinterpret_cast<float const*>(&m[2]));
+
+	// (v.x v.x v.x v.x | v.y v.y v.y v.y) and (v.z ... | v.w ...)
+	__m256 vv = glm_mat4_columns_ps256(v, v);
+	__m256 v01 = _mm256_permutevar_ps(vv, _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1));
+	__m256 v23 = _mm256_permutevar_ps(vv, _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3));
+
+	__m256 Sum = glm_mat4_fmadd_ps256(m23, v23, _mm256_mul_ps(m01, v01));
+	return _mm_add_ps(_mm256_castps256_ps128(Sum), _mm256_extractf128_ps(Sum, 1));
+}
+
+GLM_FUNC_QUALIFIER void glm_mat4_mul_avx2(glm_vec4 const in1[4], glm_vec4 const in2[4], glm_vec4 out[4])
+{
+	// Both lanes hold the same column of in1, while each lane of b01 and b23 holds its own column of in2,
+	// so every instruction below works on two result columns
+	__m256 a0 = _mm256_broadcast_ps(&in1[0]);
+	__m256 a1 = _mm256_broadcast_ps(&in1[1]);
+	__m256 a2 = _mm256_broadcast_ps(&in1[2]);
+	__m256 a3 = _mm256_broadcast_ps(&in1[3]);
+
+	__m256 b01 = _mm256_loadu_ps(reinterpret_cast<float const*>(&in2[0]));
+	__m256 b23 = _mm256_loadu_ps(reinterpret_cast<float const*>(&in2[2]));
+
+	__m256 m0 = _mm256_mul_ps(a0, _mm256_permute_ps(b01, _MM_SHUFFLE(0, 0, 0, 0)));
+	__m256 m1 = _mm256_mul_ps(a2, _mm256_permute_ps(b01, _MM_SHUFFLE(2, 2, 2, 2)));
+	__m256 f0 = glm_mat4_fmadd_ps256(a1, _mm256_permute_ps(b01, _MM_SHUFFLE(1, 1, 1, 1)), m0);
+	__m256 f1 = glm_mat4_fmadd_ps256(a3, _mm256_permute_ps(b01, _MM_SHUFFLE(3, 3, 3, 3)), m1);
+	__m256 r01 = _mm256_add_ps(f0, f1);
+
+	__m256 m2 = _mm256_mul_ps(a0, _mm256_permute_ps(b23, _MM_SHUFFLE(0, 0, 0, 0)));
+	__m256 m3 = _mm256_mul_ps(a2, _mm256_permute_ps(b23, _MM_SHUFFLE(2, 2, 2, 2)));
+	__m256 f2 = glm_mat4_fmadd_ps256(a1, _mm256_permute_ps(b23, _MM_SHUFFLE(1, 1, 1, 1)), m2);
+	__m256 f3 = glm_mat4_fmadd_ps256(a3, _mm256_permute_ps(b23, _MM_SHUFFLE(3, 3, 3, 3)), m3);
+	__m256 r23 = _mm256_add_ps(f2, f3);
+
+	_mm256_storeu_ps(reinterpret_cast<float*>(&out[0]), r01);
+	_mm256_storeu_ps(reinterpret_cast<float*>(&out[2]), r23);
+}
+
+GLM_FUNC_QUALIFIER void glm_mat4_transpose_avx2(glm_vec4 const in[4], glm_vec4 out[4])
+{
+	__m256 c01 = _mm256_loadu_ps(reinterpret_cast<float const*>(&in[0]));
+	__m256 c23 = _mm256_loadu_ps(reinterpret_cast<float const*>(&in[2]));
+
+	// (c0.x c2.x c0.y c2.y | c1.x c3.x c1.y c3.y) and the same for z and w
+	__m256 lo = _mm256_unpacklo_ps(c01, c23);
+	__m256 hi = _mm256_unpackhi_ps(c01, c23);
+
+	// Interleave the lanes: (c0.x c1.x c2.x c3.x | c0.y c1.y c2.y c3.y)
+	__m256i Order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	_mm256_storeu_ps(reinterpret_cast<float*>(&out[0]), _mm256_permutevar8x32_ps(lo, Order));
+	_mm256_storeu_ps(reinterpret_cast<float*>(&out[2]), _mm256_permutevar8x32_ps(hi, Order));
+}
+
+// Same cofactor expansion as glm_mat4_inverse, with the products fused and two columns of the
+// result computed per instruction
+GLM_FUNC_QUALIFIER void glm_mat4_inverse_avx2(glm_vec4 const in[4], glm_vec4 out[4])
+{
+	// S(k) = (m[2][k], m[2][k], m[1][k], m[1][k])
+	__m128 S0 = _mm_shuffle_ps(in[2], in[1], _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 S1 = _mm_shuffle_ps(in[2], in[1], _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 S2 = _mm_shuffle_ps(in[2], in[1], _MM_SHUFFLE(2, 2, 2, 2));
+	__m128 S3 = _mm_shuffle_ps(in[2], in[1], _MM_SHUFFLE(3, 3, 3, 3));
+
+	// T(k) = (m[3][k], m[3][k], m[3][k], m[2][k])
+	__m128 T0 = _mm_permute_ps(_mm_shuffle_ps(in[3], in[2], _MM_SHUFFLE(0, 0, 0, 0)), _MM_SHUFFLE(2, 0, 0, 0));
+	__m128 T1 = _mm_permute_ps(_mm_shuffle_ps(in[3], in[2], _MM_SHUFFLE(1, 1, 1, 1)), _MM_SHUFFLE(2, 0, 0, 0));
+	__m128 T2 = _mm_permute_ps(_mm_shuffle_ps(in[3], in[2], _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 0, 0));
+	__m128 T3 = _mm_permute_ps(_mm_shuffle_ps(in[3], in[2], _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 0, 0));
+
+	// The sub factors of glm_mat4_inverse: Fac(a, b) = S(a) * T(b) - T(a) * S(b)
+	__m128 Fac0 = glm_mat4_fmsub_ps(S2, T3, _mm_mul_ps(T2, S3));
+	__m128 Fac1 = glm_mat4_fmsub_ps(S1, T3, _mm_mul_ps(T1, S3));
+	__m128 Fac2 = glm_mat4_fmsub_ps(S1, T2, _mm_mul_ps(T1, S2));
+	__m128 Fac3 = glm_mat4_fmsub_ps(S0, T3, _mm_mul_ps(T0, S3));
+	__m128 Fac4 = glm_mat4_fmsub_ps(S0, T2, _mm_mul_ps(T0, S2));
+	__m128 Fac5 = glm_mat4_fmsub_ps(S0, T1, _mm_mul_ps(T0, S1));
+
+	// Vec(k) = (m[1][k], m[0][k], m[0][k], m[0][k])
+	__m128 Vec0 = _mm_permute_ps(_mm_shuffle_ps(in[1], in[0], _MM_SHUFFLE(0, 0, 0, 0)), _MM_SHUFFLE(2, 2, 2, 0));
+	__m128 Vec1 = _mm_permute_ps(_mm_shuffle_ps(in[1], in[0], _MM_SHUFFLE(1, 1, 1, 1)), _MM_SHUFFLE(2, 2, 2, 0));
+	__m128 Vec2 = _mm_permute_ps(_mm_shuffle_ps(in[1], in[0], _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 2, 2, 0));
+	__m128 Vec3 = _mm_permute_ps(_mm_shuffle_ps(in[1], in[0], _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 2, 2, 0));
+
+	// Inv0 = SignB * (Vec1 * Fac0 - Vec2 * Fac1 + Vec3 * Fac2)
+	// Inv1 = SignA * (Vec0 * Fac0 - Vec2 * Fac3 + Vec3 * Fac4)
+	__m256 Add01 = glm_mat4_fmadd_ps256(glm_mat4_columns_ps256(Vec3, Vec3), glm_mat4_columns_ps256(Fac2, Fac4),
+		glm_mat4_fnmadd_ps256(glm_mat4_columns_ps256(Vec2, Vec2), glm_mat4_columns_ps256(Fac1, Fac3),
+			_mm256_mul_ps(glm_mat4_columns_ps256(Vec1, Vec0), glm_mat4_columns_ps256(Fac0, Fac0))));
+
+	// Inv2 = SignB * (Vec0 * Fac1 - Vec1 * Fac3 + Vec3 * Fac5)
+	// Inv3 = SignA * (Vec0 * Fac2 - Vec1 * Fac4 + Vec2 * Fac5)
+	__m256 Add23 = glm_mat4_fmadd_ps256(glm_mat4_columns_ps256(Vec3, Vec2), glm_mat4_columns_ps256(Fac5, Fac5),
+		glm_mat4_fnmadd_ps256(glm_mat4_columns_ps256(Vec1, Vec1), glm_mat4_columns_ps256(Fac3, Fac4),
+			_mm256_mul_ps(glm_mat4_columns_ps256(Vec0, Vec0), glm_mat4_columns_ps256(Fac1, Fac2))));
+
+	// SignB in the low lane and SignA in the high lane, applied by flipping sign bits
+	__m256 Sign = _mm256_setr_ps(0.0f, -0.0f, 0.0f, -0.0f, -0.0f, 0.0f, -0.0f, 0.0f);
+	__m256 Inv01 = _mm256_xor_ps(Add01, Sign);
+	__m256 Inv23 = _mm256_xor_ps(Add23, Sign);
+
+	//	valType Determinant = m[0][0] * Inverse[0][0]
+	//						+ m[0][1] * Inverse[1][0]
+	//						+ m[0][2] * Inverse[2][0]
+	//						+ m[0][3] * Inverse[3][0];
+	__m128 Row0 = _mm_shuffle_ps(_mm256_castps256_ps128(Inv01), _mm256_extractf128_ps(Inv01, 1), _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 Row1 = _mm_shuffle_ps(_mm256_castps256_ps128(Inv23), _mm256_extractf128_ps(Inv23, 1), _MM_SHUFFLE(0, 0, 0, 0));
+	__m128 Row2 = _mm_shuffle_ps(Row0, Row1, _MM_SHUFFLE(2, 0, 2, 0));
+	__m128 Det0 = glm_vec4_dot(in[0], Row2);
+	__m128 Rcp0 = _mm_div_ps(_mm_set1_ps(1.0f), Det0);
+	__m256 Rcp1 = glm_mat4_columns_ps256(Rcp0, Rcp0);
+
+	//	Inverse /= Determinant;
+	_mm256_storeu_ps(reinterpret_cast<float*>(&out[0]), _mm256_mul_ps(Inv01, Rcp1));
+	_mm256_storeu_ps(reinterpret_cast<float*>(&out[2]), _mm256_mul_ps(Inv23, Rcp1));
+}
+
+#endif//GLM_ARCH & GLM_ARCH_AVX2_BIT
+
 #endif//GLM_ARCH & GLM_ARCH_SSE2_BIT
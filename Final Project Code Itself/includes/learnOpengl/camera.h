@@ -18,6 +18,7 @@ https://creativecommons.org/licenses/by-nc/4.0/legalcode
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/fast_trigonometry.hpp>
 
 #include <vector>
 
@@ -147,10 +148,12 @@ private:
     void updateCameraVectors()
     {
         // calculate the new Front vector
+        glm::vec2 sines, cosines;
+        glm::fastSinCos(glm::radians(glm::vec2(Yaw, Pitch)), sines, cosines);
         glm::vec3 front;
-        front.x = cos(glm::radians(Yaw)) * cos(glm::radians(Pitch));
-        front.y = sin(glm::radians(Pitch));
-        front.z = sin(glm::radians(Yaw)) * cos(glm::radians(Pitch));
+        front.x = cosines.x * cosines.y;
+        front.y = sines.y;
+        front.z = sines.x * cosines.y;
         Front = glm::normalize(front);
         // also re-calculate the Right and Up vector
         Right = glm::normalize(glm::cross(Front, WorldUp));  // normalize the vectors, because their length gets closer to 0 the more you look up or down which results in slower movement.
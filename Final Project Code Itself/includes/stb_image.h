@@ -307,11 +307,20 @@ publish, and distribute this file as you see fit.
 // code.)
 //
 // On x86, SSE2 will automatically be used when available based on a run-time
-// test; if not, the generic C versions are used as a fall-back. On ARM targets,
+// test; if not, the generic C versions are used as a fall-back. The PNG decoder
+// uses SSE2 the same way to undo "up" filtering, and "avg" and "paeth" filtering
+// of 8-bit RGB and RGBA scanlines. On ARM targets,
 // the typical path is to have separate builds for NEON and non-NEON devices
 // (at least this is true for iOS and Android). Therefore, the NEON support is
 // toggled by a build flag: define STBI_NEON to get NEON loops.
 //
+// On x86 compilers that can target AVX2 without it being enabled for the
+// whole build (VC++ 2012+, GCC 4.9+, Clang), AVX2 versions of the IDCT,
+// YCbCr-to-RGB, 2x2 chroma upsampling and PNG "up"/"sub" unfiltering are
+// also built and picked at run time when CPUID (and the OS) report AVX2
+// support. Their output is identical to the SSE2 and C kernels. Define
+// STBI_NO_AVX2 to leave them out.
+//
 // The output of the JPEG decoder is slightly different from versions where
 // SIMD support was introduced (that is, for versions before 1.49). The
 // difference is only +-1 in the 8-bit RGB channels, and only on a small
@@ -325,6 +334,27 @@ publish, and distribute this file as you see fit.
 //
 // ===========================================================================
 //
+// Multithreaded JPEG decoding
+//
+// Define STBI_JPEG_THREADS before including the implementation to spread
+// JPEG decoding over several threads (Win32 threads or pthreads):
+//
+//   - baseline scans with restart intervals have their restart segments
+//     entropy-decoded (and IDCT'd) in parallel; this needs the whole file
+//     in memory, so it applies to the *_from_memory entry points only
+//   - progressive images dequantize and IDCT bands of block rows in parallel
+//   - every image upsamples and color-converts bands of rows in parallel
+//
+// The output is identical to the single-threaded decoder. Images under
+// 512x512 pixels are decoded on the calling thread. The thread count is
+// set at run time; 0 (the default) uses one thread per core, capped at
+// STBI_JPEG_MAX_THREADS (16 unless defined otherwise):
+//
+//     stbi_set_jpeg_thread_count(0);   // one per core
+//     stbi_set_jpeg_thread_count(1);   // single threaded
+//
+// ===========================================================================
+//
 // HDR image support   (disable by defining STBI_NO_HDR)
 //
 // stb_image now supports loading HDR images in general, and currently
@@ -510,6 +540,9 @@ extern "C" {
     // flip the image vertically, so the first pixel in the output array is the bottom left
     STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+    // threads used by the JPEG decoder when built with STBI_JPEG_THREADS; 0 means one per core
+    STBIDEF void stbi_set_jpeg_thread_count(int thread_count);
+
     // ZLIB client - used by PNG, available for other purposes
 
     STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -584,6 +617,21 @@ extern "C" {
 #include <stdio.h>
 #endif
 
+#ifdef STBI_JPEG_THREADS
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#endif
+
 #ifndef STBI_ASSERT
 #include <assert.h>
 #define STBI_ASSERT(x) assert(x)
@@ -606,12 +654,14 @@ typedef unsigned short stbi__uint16;
 typedef   signed short stbi__int16;
 typedef unsigned int   stbi__uint32;
 typedef   signed int   stbi__int32;
+typedef unsigned __int64 stbi__uint64;
 #else
 #include <stdint.h>
 typedef uint16_t stbi__uint16;
 typedef int16_t  stbi__int16;
 typedef uint32_t stbi__uint32;
 typedef int32_t  stbi__int32;
+typedef uint64_t stbi__uint64;
 #endif
 
 // should produce compiler error if size is wrong
@@ -738,6 +788,38 @@ static int stbi__sse2_available()
 #undef STBI_NEON
 #endif
 
+// AVX2 kernels are compiled for that target per function, so the rest of the
+// file doesn't require AVX2, and chosen at run time like the SSE2 ones
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) && \
+    ((defined(_MSC_VER) && _MSC_VER >= 1700) || defined(__clang__) || \
+     (defined(__GNUC__) && (__GNUC__ * 100 + __GNUC_MINOR__) >= 409))
+#define STBI_AVX2
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define STBI__AVX2_TARGET
+
+static int stbi__avx2_available()
+{
+    int info[4];
+    __cpuid(info, 1);
+    // the CPU has to support AVX and XSAVE, and the OS has to save the YMM registers (XCR0 bits 1 and 2)
+    if ((info[2] & ((1 << 27) | (1 << 28))) != ((1 << 27) | (1 << 28))) return 0;
+    if ((_xgetbv(0) & 6) != 6) return 0;
+    __cpuidex(info, 7, 0);
+    return ((info[1] >> 5) & 1) != 0;
+}
+#else
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+
+static int stbi__avx2_available()
+{
+    // also checks that the OS saves the YMM registers
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+#endif
+
 #ifdef STBI_NEON
 #include <arm_neon.h>
 // assume GCC or Clang on ARM targets
@@ -1022,6 +1104,12 @@ static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp);
 #endif
 
 static int stbi__vertically_flip_on_load = 0;
+static int stbi__jpeg_thread_count = 0;
+
+STBIDEF void stbi_set_jpeg_thread_count(int thread_count)
+{
+    stbi__jpeg_thread_count = thread_count;
+}
 
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
 {
@@ -2478,6 +2566,161 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// avx2 version of the sse2 IDCT above, with the same arithmetic (so the output is
+// identical). the 32-bit intermediates of a whole row fit in one register instead
+// of two, which halves the multiplies and wide adds; transposes stay 128-bit.
+STBI__AVX2_TARGET static void stbi__idct_avx2(stbi_uc *out, int out_stride, short data[64])
+{
+    __m128i row0, row1, row2, row3, row4, row5, row6, row7;
+    __m128i tmp;
+
+#define dct_const(x,y)  _mm256_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y))
+
+    // out0 = c0[even]*x + c0[odd]*y, out1 likewise with c1 (x, y 16-bit rows, out 32-bit)
+#define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##xy = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16((x),(y))), _mm_unpackhi_epi16((x),(y)), 1); \
+      __m256i out0 = _mm256_madd_epi16(c0##xy, c0); \
+      __m256i out1 = _mm256_madd_epi16(c0##xy, c1)
+
+    // out = in << 12  (in 16-bit, out 32-bit)
+#define dct_widen(out, in) \
+      __m256i out = _mm256_slli_epi32(_mm256_cvtepi16_epi32(in), 12)
+
+    // butterfly a/b, add bias, then shift by "s" and pack
+#define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased = _mm256_add_epi32(a, bias); \
+         __m256i sum = _mm256_srai_epi32(_mm256_add_epi32(abiased, b), s); \
+         __m256i dif = _mm256_srai_epi32(_mm256_sub_epi32(abiased, b), s); \
+         __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(sum, dif), 0xd8); \
+         out0 = _mm256_castsi256_si128(packed); \
+         out1 = _mm256_extracti128_si256(packed, 1); \
+      }
+
+#define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi8(a, b); \
+      b = _mm_unpackhi_epi8(tmp, b)
+
+#define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi16(a, b); \
+      b = _mm_unpackhi_epi16(tmp, b)
+
+#define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m128i sum04 = _mm_add_epi16(row0, row4); \
+         __m128i dif04 = _mm_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         __m256i x0 = _mm256_add_epi32(t0e, t3e); \
+         __m256i x3 = _mm256_sub_epi32(t0e, t3e); \
+         __m256i x1 = _mm256_add_epi32(t1e, t2e); \
+         __m256i x2 = _mm256_sub_epi32(t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m128i sum17 = _mm_add_epi16(row1, row7); \
+         __m128i sum35 = _mm_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         __m256i x4 = _mm256_add_epi32(y0o, y4o); \
+         __m256i x5 = _mm256_add_epi32(y1o, y5o); \
+         __m256i x6 = _mm256_add_epi32(y2o, y5o); \
+         __m256i x7 = _mm256_add_epi32(y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+    __m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+    __m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f(0.765366865f), stbi__f2f(0.5411961f));
+    __m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+    __m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+    __m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f(0.298631336f), stbi__f2f(-1.961570560f));
+    __m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f(3.072711026f));
+    __m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f(2.053119869f), stbi__f2f(-0.390180644f));
+    __m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f(1.501321110f));
+
+    // rounding biases in column/row passes, see stbi__idct_block for explanation.
+    __m256i bias_0 = _mm256_set1_epi32(512);
+    __m256i bias_1 = _mm256_set1_epi32(65536 + (128 << 17));
+
+    // load
+    row0 = _mm_load_si128((const __m128i *) (data + 0 * 8));
+    row1 = _mm_load_si128((const __m128i *) (data + 1 * 8));
+    row2 = _mm_load_si128((const __m128i *) (data + 2 * 8));
+    row3 = _mm_load_si128((const __m128i *) (data + 3 * 8));
+    row4 = _mm_load_si128((const __m128i *) (data + 4 * 8));
+    row5 = _mm_load_si128((const __m128i *) (data + 5 * 8));
+    row6 = _mm_load_si128((const __m128i *) (data + 6 * 8));
+    row7 = _mm_load_si128((const __m128i *) (data + 7 * 8));
+
+    // column pass
+    dct_pass(bias_0, 10);
+
+    {
+        // 16bit 8x8 transpose
+        dct_interleave16(row0, row4);
+        dct_interleave16(row1, row5);
+        dct_interleave16(row2, row6);
+        dct_interleave16(row3, row7);
+
+        dct_interleave16(row0, row2);
+        dct_interleave16(row1, row3);
+        dct_interleave16(row4, row6);
+        dct_interleave16(row5, row7);
+
+        dct_interleave16(row0, row1);
+        dct_interleave16(row2, row3);
+        dct_interleave16(row4, row5);
+        dct_interleave16(row6, row7);
+    }
+
+    // row pass
+    dct_pass(bias_1, 17);
+
+    {
+        // pack, then 8bit 8x8 transpose
+        __m128i p0 = _mm_packus_epi16(row0, row1);
+        __m128i p1 = _mm_packus_epi16(row2, row3);
+        __m128i p2 = _mm_packus_epi16(row4, row5);
+        __m128i p3 = _mm_packus_epi16(row6, row7);
+
+        dct_interleave8(p0, p2);
+        dct_interleave8(p1, p3);
+
+        dct_interleave8(p0, p1);
+        dct_interleave8(p2, p3);
+
+        dct_interleave8(p0, p2);
+        dct_interleave8(p1, p3);
+
+        // store
+        _mm_storel_epi64((__m128i *) out, p0); out += out_stride;
+        _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p0, 0x4e)); out += out_stride;
+        _mm_storel_epi64((__m128i *) out, p2); out += out_stride;
+        _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p2, 0x4e)); out += out_stride;
+        _mm_storel_epi64((__m128i *) out, p1); out += out_stride;
+        _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p1, 0x4e)); out += out_stride;
+        _mm_storel_epi64((__m128i *) out, p3); out += out_stride;
+        _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p3, 0x4e));
+    }
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+}
+
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -2720,9 +2963,244 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
     // since we don't even allow 1<<30 pixels
 }
 
+#ifdef STBI_JPEG_THREADS
+
+#ifndef STBI_JPEG_MAX_THREADS
+#define STBI_JPEG_MAX_THREADS 16
+#endif
+
+// images with fewer pixels than this are decoded on the calling thread
+#define STBI__JPEG_THREAD_MIN_PIXELS (512 * 512)
+
+typedef void(*stbi__parallel_func)(void *context, int index);
+
+typedef struct
+{
+    stbi__parallel_func func;
+    void *context;
+    int index;
+} stbi__parallel_task;
+
+#ifdef _WIN32
+static DWORD WINAPI stbi__parallel_entry(LPVOID param)
+{
+    stbi__parallel_task *t = (stbi__parallel_task *)param;
+    t->func(t->context, t->index);
+    return 0;
+}
+#else
+static void *stbi__parallel_entry(void *param)
+{
+    stbi__parallel_task *t = (stbi__parallel_task *)param;
+    t->func(t->context, t->index);
+    return NULL;
+}
+#endif
+
+// runs func(context, i) for i in [0, count), index 0 on the calling thread. a task
+// whose thread can't be created runs on the calling thread instead.
+static void stbi__parallel_for(int count, stbi__parallel_func func, void *context)
+{
+    stbi__parallel_task tasks[STBI_JPEG_MAX_THREADS];
+    int started[STBI_JPEG_MAX_THREADS];
+#ifdef _WIN32
+    HANDLE threads[STBI_JPEG_MAX_THREADS];
+#else
+    pthread_t threads[STBI_JPEG_MAX_THREADS];
+#endif
+    int i;
+
+    if (count > STBI_JPEG_MAX_THREADS) count = STBI_JPEG_MAX_THREADS;
+    for (i = 1; i < count; ++i) {
+        tasks[i].func = func;
+        tasks[i].context = context;
+        tasks[i].index = i;
+#ifdef _WIN32
+        threads[i] = CreateThread(NULL, 0, stbi__parallel_entry, &tasks[i], 0, NULL);
+        started[i] = threads[i] != NULL;
+#else
+        started[i] = pthread_create(&threads[i], NULL, stbi__parallel_entry, &tasks[i]) == 0;
+#endif
+        if (!started[i]) func(context, i);
+    }
+
+    func(context, 0);
+
+    for (i = 1; i < count; ++i) {
+        if (!started[i]) continue;
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+}
+
+// number of threads to decode this image with
+static int stbi__jpeg_threads_for(stbi__jpeg *z)
+{
+    int n = stbi__jpeg_thread_count;
+    if ((double)z->s->img_x * z->s->img_y < STBI__JPEG_THREAD_MIN_PIXELS) return 1;
+    if (n <= 0) {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        n = (int)info.dwNumberOfProcessors;
+#else
+        n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    }
+    if (n < 1) n = 1;
+    if (n > STBI_JPEG_MAX_THREADS) n = STBI_JPEG_MAX_THREADS;
+    return n;
+}
+
+// decode MCU number m of a baseline scan: one interleaved MCU, or a single
+// block for non-interleaved scans
+static int stbi__jpeg_decode_baseline_mcu(stbi__jpeg *z, int m)
+{
+    STBI_SIMD_ALIGN(short, data[64]);
+    if (z->scan_n == 1) {
+        int n = z->order[0];
+        int w = (z->img_comp[n].x + 7) >> 3;
+        int i = m % w, j = m / w;
+        int ha = z->img_comp[n].ha;
+        if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+        z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2*j * 8 + i * 8, z->img_comp[n].w2, data);
+    }
+    else {
+        int i = m % z->img_mcu_x, j = m / z->img_mcu_x;
+        int k, x, y;
+        for (k = 0; k < z->scan_n; ++k) {
+            int n = z->order[k];
+            for (y = 0; y < z->img_comp[n].v; ++y) {
+                for (x = 0; x < z->img_comp[n].h; ++x) {
+                    int x2 = (i*z->img_comp[n].h + x) * 8;
+                    int y2 = (j*z->img_comp[n].v + y) * 8;
+                    int ha = z->img_comp[n].ha;
+                    if (!stbi__jpeg_decode_block(z, data, z->huff_dc + z->img_comp[n].hd, z->huff_ac + ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+                    z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2*y2 + x2, z->img_comp[n].w2, data);
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+typedef struct
+{
+    stbi__jpeg *z;
+    stbi_uc **segments;     // first entropy-coded byte of each restart interval
+    int segment_count;
+    int mcu_count;          // MCUs in the scan (blocks, for non-interleaved scans)
+    int thread_count;
+    int ok[STBI_JPEG_MAX_THREADS];
+} stbi__jpeg_restart_job;
+
+// each thread decodes a contiguous run of restart intervals with its own copy of
+// the bit reader and DC predictors; the blocks it writes don't overlap any other's
+static void stbi__jpeg_restart_worker(void *context, int index)
+{
+    stbi__jpeg_restart_job *job = (stbi__jpeg_restart_job *)context;
+    int first = job->segment_count * index / job->thread_count;
+    int last = job->segment_count * (index + 1) / job->thread_count;
+    stbi__jpeg *z = (stbi__jpeg *)stbi__malloc(sizeof(stbi__jpeg));
+    stbi__context s;
+    int seg, m;
+
+    job->ok[index] = z != NULL;
+    if (!z) return;
+    memcpy(z, job->z, sizeof(stbi__jpeg));
+    s = *job->z->s;
+    z->s = &s;
+
+    for (seg = first; seg < last && job->ok[index]; ++seg) {
+        int end = (seg + 1) * z->restart_interval;
+        if (end > job->mcu_count) end = job->mcu_count;
+        s.img_buffer = job->segments[seg];
+        stbi__jpeg_reset(z);
+        for (m = seg * z->restart_interval; m < end; ++m) {
+            if (!stbi__jpeg_decode_baseline_mcu(z, m)) {
+                job->ok[index] = 0;
+                break;
+            }
+        }
+    }
+    STBI_FREE(z);
+}
+
+// decode a baseline scan's restart intervals in parallel. returns -1 if the scan
+// can't be split up (it's then decoded serially), otherwise the decode result
+static int stbi__jpeg_parse_restarts_parallel(stbi__jpeg *z)
+{
+    stbi__jpeg_restart_job job;
+    stbi_uc *p, *end;
+    int expected, count = 0, found_end = 0, result = 1, i;
+
+    if (z->progressive || !z->restart_interval || z->s->read_from_callbacks) return -1;
+    job.thread_count = stbi__jpeg_threads_for(z);
+    if (job.thread_count < 2) return -1;
+
+    if (z->scan_n == 1) {
+        int n = z->order[0];
+        job.mcu_count = ((z->img_comp[n].x + 7) >> 3) * ((z->img_comp[n].y + 7) >> 3);
+    }
+    else {
+        job.mcu_count = z->img_mcu_x * z->img_mcu_y;
+    }
+    expected = (job.mcu_count + z->restart_interval - 1) / z->restart_interval;
+    if (expected < 2) return -1;
+
+    job.segments = (stbi_uc **)stbi__malloc(sizeof(stbi_uc *) * expected);
+    if (!job.segments) return -1;
+
+    // find the RSTn markers; the scan ends at the first marker of any other kind
+    p = z->s->img_buffer;
+    end = z->s->img_buffer_end;
+    job.segments[count++] = p;
+    while (p + 1 < end) {
+        if (p[0] != 0xff) { ++p; continue; }
+        if (p[1] == 0x00) { p += 2; continue; } // stuffed zero
+        if (p[1] == 0xff) { ++p; continue; }    // fill byte
+        if (!STBI__RESTART(p[1])) { found_end = 1; break; }
+        if (count == expected) break;           // more intervals than MCUs
+        job.segments[count++] = p + 2;
+        p += 2;
+    }
+
+    // anything unexpected is left to the serial decoder, which tolerates corrupt streams
+    if (!found_end || count != expected) {
+        STBI_FREE(job.segments);
+        return -1;
+    }
+
+    job.z = z;
+    job.segment_count = count;
+    if (job.thread_count > count) job.thread_count = count;
+    stbi__parallel_for(job.thread_count, stbi__jpeg_restart_worker, &job);
+
+    for (i = 0; i < job.thread_count; ++i)
+        if (!job.ok[i]) result = 0;
+    STBI_FREE(job.segments);
+
+    // carry on parsing at the marker that ended the scan
+    z->s->img_buffer = p;
+    stbi__jpeg_reset(z);
+    return result;
+}
+
+#endif // STBI_JPEG_THREADS
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
     stbi__jpeg_reset(z);
+#ifdef STBI_JPEG_THREADS
+    {
+        int result = stbi__jpeg_parse_restarts_parallel(z);
+        if (result >= 0) return result;
+    }
+#endif
     if (!z->progressive) {
         if (z->scan_n == 1) {
             int i, j;
@@ -2855,25 +3333,51 @@ static void stbi__jpeg_dequantize(short *data, stbi_uc *dequant)
         data[i] *= dequant[i];
 }
 
-static void stbi__jpeg_finish(stbi__jpeg *z)
+// dequantize and idct band 'part' of 'parts' equal bands of block rows, in every component
+static void stbi__jpeg_finish_part(stbi__jpeg *z, int part, int parts)
 {
-    if (z->progressive) {
-        // dequantize and idct the data
-        int i, j, n;
-        for (n = 0; n < z->s->img_n; ++n) {
-            int w = (z->img_comp[n].x + 7) >> 3;
-            int h = (z->img_comp[n].y + 7) >> 3;
-            for (j = 0; j < h; ++j) {
-                for (i = 0; i < w; ++i) {
-                    short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
-                    stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-                    z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2*j * 8 + i * 8, z->img_comp[n].w2, data);
-                }
+    int i, j, n;
+    for (n = 0; n < z->s->img_n; ++n) {
+        int w = (z->img_comp[n].x + 7) >> 3;
+        int h = (z->img_comp[n].y + 7) >> 3;
+        for (j = h * part / parts; j < h * (part + 1) / parts; ++j) {
+            for (i = 0; i < w; ++i) {
+                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
+                z->idct_block_kernel(z->img_comp[n].data + z->img_comp[n].w2*j * 8 + i * 8, z->img_comp[n].w2, data);
             }
         }
     }
 }
 
+#ifdef STBI_JPEG_THREADS
+typedef struct
+{
+    stbi__jpeg *z;
+    int parts;
+} stbi__jpeg_finish_job;
+
+static void stbi__jpeg_finish_worker(void *context, int index)
+{
+    stbi__jpeg_finish_job *job = (stbi__jpeg_finish_job *)context;
+    stbi__jpeg_finish_part(job->z, index, job->parts);
+}
+#endif
+
+static void stbi__jpeg_finish(stbi__jpeg *z)
+{
+    if (z->progressive) {
+#ifdef STBI_JPEG_THREADS
+        stbi__jpeg_finish_job job;
+        job.z = z;
+        job.parts = stbi__jpeg_threads_for(z);
+        stbi__parallel_for(job.parts, stbi__jpeg_finish_worker, &job);
+#else
+        stbi__jpeg_finish_part(z, 0, 1);
+#endif
+    }
+}
+
 static int stbi__process_marker(stbi__jpeg *z, int m)
 {
     int L;
@@ -3561,6 +4065,125 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+// 16 pixels per iteration version of stbi__resample_row_hv_2_simd. the "prev" and
+// "next" neighbours cross the 128-bit lanes, so they're built with alignr against
+// the row with its lanes swapped.
+STBI__AVX2_TARGET static stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+    int i = 0, t0, t1;
+
+    if (w == 1) {
+        out[0] = out[1] = stbi__div4(3 * in_near[0] + in_far[0] + 2);
+        return out;
+    }
+
+    t1 = 3 * in_near[0] + in_far[0];
+    // the last pixel in a row is left to the scalar loop for its boundary condition
+    for (; i < ((w - 1) & ~15); i += 16) {
+        // vertical pass: 3*near + far = 4*near + (far - near)
+        __m256i farw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_far + i)));
+        __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_near + i)));
+        __m256i curr = _mm256_add_epi16(_mm256_slli_epi16(nearw, 2), _mm256_sub_epi16(farw, nearw));
+
+        // prev = curr shifted by one pixel with t1 in front, next = curr shifted the
+        // other way with the first pixel of the next group behind
+        __m128i first = _mm_insert_epi16(_mm_setzero_si128(), t1, 7);
+        __m128i last = _mm_cvtsi32_si128(3 * in_near[i + 16] + in_far[i + 16]);
+        __m256i before = _mm256_inserti128_si256(_mm256_castsi128_si256(first), _mm256_castsi256_si128(curr), 1);
+        __m256i after = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm256_extracti128_si256(curr, 1)), last, 1);
+        __m256i prev = _mm256_alignr_epi8(curr, before, 14);
+        __m256i next = _mm256_alignr_epi8(after, curr, 2);
+
+        // horizontal pass, even = 4*cur + (prev - cur), odd = 4*cur + (next - cur)
+        __m256i curb = _mm256_add_epi16(_mm256_slli_epi16(curr, 2), _mm256_set1_epi16(8));
+        __m256i even = _mm256_add_epi16(_mm256_sub_epi16(prev, curr), curb);
+        __m256i odd = _mm256_add_epi16(_mm256_sub_epi16(next, curr), curb);
+
+        // interleave, undo scaling, pack; unpack and pack both stay within lanes so the order comes back out right
+        __m256i de0 = _mm256_srli_epi16(_mm256_unpacklo_epi16(even, odd), 4);
+        __m256i de1 = _mm256_srli_epi16(_mm256_unpackhi_epi16(even, odd), 4);
+        _mm256_storeu_si256((__m256i *) (out + i * 2), _mm256_packus_epi16(de0, de1));
+
+        t1 = 3 * in_near[i + 15] + in_far[i + 15];
+    }
+
+    t0 = t1;
+    t1 = 3 * in_near[i] + in_far[i];
+    out[i * 2] = stbi__div16(3 * t1 + t0 + 8);
+
+    for (++i; i < w; ++i) {
+        t0 = t1;
+        t1 = 3 * in_near[i] + in_far[i];
+        out[i * 2 - 1] = stbi__div16(3 * t0 + t1 + 8);
+        out[i * 2] = stbi__div16(3 * t1 + t0 + 8);
+    }
+    out[w * 2 - 1] = stbi__div4(t1 + 2);
+
+    STBI_NOTUSED(hs);
+
+    return out;
+}
+
+// 16 pixels per iteration version of stbi__YCbCr_to_RGB_simd, which finishes the row
+STBI__AVX2_TARGET static void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+    int i = 0;
+
+    if (step == 4) {
+        __m128i signflip = _mm_set1_epi8(-0x80);
+        __m256i cr_const0 = _mm256_set1_epi16((short)(1.40200f*4096.0f + 0.5f));
+        __m256i cr_const1 = _mm256_set1_epi16(-(short)(0.71414f*4096.0f + 0.5f));
+        __m256i cb_const0 = _mm256_set1_epi16(-(short)(0.34414f*4096.0f + 0.5f));
+        __m256i cb_const1 = _mm256_set1_epi16((short)(1.77200f*4096.0f + 0.5f));
+        __m256i y_bias = _mm256_set1_epi16(128);
+        __m256i xw = _mm256_set1_epi16(255); // alpha channel
+
+        for (; i + 15 < count; i += 16) {
+            // load, and widen to (y << 8) + 128 and (c - 128) << 8 like the sse2 unpacks do
+            __m128i y_bytes = _mm_loadu_si128((__m128i *) (y + i));
+            __m128i cr_biased = _mm_xor_si128(_mm_loadu_si128((__m128i *) (pcr + i)), signflip);
+            __m128i cb_biased = _mm_xor_si128(_mm_loadu_si128((__m128i *) (pcb + i)), signflip);
+            __m256i yw = _mm256_or_si256(_mm256_slli_epi16(_mm256_cvtepu8_epi16(y_bytes), 8), y_bias);
+            __m256i crw = _mm256_slli_epi16(_mm256_cvtepi8_epi16(cr_biased), 8);
+            __m256i cbw = _mm256_slli_epi16(_mm256_cvtepi8_epi16(cb_biased), 8);
+
+            // color transform
+            __m256i yws = _mm256_srli_epi16(yw, 4);
+            __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+            __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+            __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+            __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+            __m256i rws = _mm256_add_epi16(cr0, yws);
+            __m256i gwt = _mm256_add_epi16(cb0, yws);
+            __m256i bws = _mm256_add_epi16(yws, cb1);
+            __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+            // descale
+            __m256i rw = _mm256_srai_epi16(rws, 4);
+            __m256i bw = _mm256_srai_epi16(bws, 4);
+            __m256i gw = _mm256_srai_epi16(gws, 4);
+
+            // back to byte and interleave; each lane ends up holding pixels 0-3/8-11 and 4-7/12-15
+            __m256i brb = _mm256_packus_epi16(rw, bw);
+            __m256i gxb = _mm256_packus_epi16(gw, xw);
+            __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+            __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+            __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+            __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+
+            // store
+            _mm256_storeu_si256((__m256i *) (out + 0), _mm256_permute2x128_si256(o0, o1, 0x20));
+            _mm256_storeu_si256((__m256i *) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+            out += 64;
+        }
+    }
+
+    // 8-pixel and scalar tails
+    stbi__YCbCr_to_RGB_simd(out, y + i, pcb + i, pcr + i, count - i, step);
+}
+#endif // STBI_AVX2
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
@@ -3578,6 +4201,16 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
     }
 #endif
 
+#ifdef STBI_AVX2
+    if (stbi__avx2_available()) {
+        j->idct_block_kernel = stbi__idct_avx2;
+#ifndef STBI_JPEG_OLD
+        j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+#endif
+        j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+    }
+#endif
+
 #ifdef STBI_NEON
     j->idct_block_kernel = stbi__idct_simd;
 #ifndef STBI_JPEG_OLD
@@ -3603,6 +4236,118 @@ typedef struct
     int ypos;    // which pre-expansion row we're on
 } stbi__resample;
 
+// position a resampler at output row j, as if rows 0..j-1 had already been produced
+static void stbi__resample_seek(stbi__resample *r, stbi_uc *data, int w2, int comp_y, int j)
+{
+    int t = (r->vs >> 1) + j;
+    int wraps = t / r->vs;
+    int row1 = wraps < comp_y - 1 ? wraps : comp_y - 1;
+    int row0 = wraps == 0 ? 0 : (wraps - 1 < comp_y - 1 ? wraps - 1 : comp_y - 1);
+    r->ystep = t % r->vs;
+    r->ypos = wraps;
+    r->line0 = data + w2 * row0;
+    r->line1 = data + w2 * row1;
+}
+
+// resample and color-convert output rows [first, last), using linebuf[k] as scratch for component k.
+// 3-channel conversion writes a 4th byte after each row's last pixel, onto the next row. when the next
+// row belongs to another thread, last_row (n * img_x + 1 bytes) takes the final row so nothing is
+// written past it; otherwise pass NULL
+static void stbi__jpeg_resample_rows(stbi__jpeg *z, const stbi__resample *res_start, stbi_uc **linebuf,
+    stbi_uc *output, int n, int decode_n, unsigned int first, unsigned int last, stbi_uc *last_row)
+{
+    int k;
+    unsigned int i, j;
+    stbi_uc *coutput[4];
+    stbi__resample res_comp[4];
+
+    for (k = 0; k < decode_n; ++k) {
+        res_comp[k] = res_start[k];
+        stbi__resample_seek(&res_comp[k], z->img_comp[k].data, z->img_comp[k].w2, z->img_comp[k].y, first);
+    }
+
+    for (j = first; j < last; ++j) {
+        stbi_uc *dest = output + n * z->s->img_x * j;
+        stbi_uc *row = last_row && j + 1 == last ? last_row : dest;
+        stbi_uc *out = row;
+        for (k = 0; k < decode_n; ++k) {
+            stbi__resample *r = &res_comp[k];
+            int y_bot = r->ystep >= (r->vs >> 1);
+            coutput[k] = r->resample(linebuf[k],
+                y_bot ? r->line1 : r->line0,
+                y_bot ? r->line0 : r->line1,
+                r->w_lores, r->hs);
+            if (++r->ystep >= r->vs) {
+                r->ystep = 0;
+                r->line0 = r->line1;
+                if (++r->ypos < z->img_comp[k].y)
+                    r->line1 += z->img_comp[k].w2;
+            }
+        }
+        if (n >= 3) {
+            stbi_uc *y = coutput[0];
+            if (z->s->img_n == 3) {
+                if (z->rgb == 3) {
+                    for (i = 0; i < z->s->img_x; ++i) {
+                        out[0] = y[i];
+                        out[1] = coutput[1][i];
+                        out[2] = coutput[2][i];
+                        out[3] = 255;
+                        out += n;
+                    }
+                }
+                else {
+                    z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+                }
+            }
+            else
+                for (i = 0; i < z->s->img_x; ++i) {
+                    out[0] = out[1] = out[2] = y[i];
+                    out[3] = 255; // not used if n==3
+                    out += n;
+                }
+        }
+        else {
+            stbi_uc *y = coutput[0];
+            if (n == 1)
+                for (i = 0; i < z->s->img_x; ++i) out[i] = y[i];
+            else
+                for (i = 0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
+        }
+        if (row != dest)
+            memcpy(dest, row, n * z->s->img_x);
+    }
+}
+
+#ifdef STBI_JPEG_THREADS
+typedef struct
+{
+    stbi__jpeg *z;
+    const stbi__resample *res_start;
+    stbi_uc *linebufs;      // parts * decode_n line buffers of img_x + 3 bytes
+    stbi_uc *last_rows;     // parts rows of n * img_x + 1 bytes for the last row of each band, when n == 3
+    stbi_uc *output;
+    int n, decode_n, parts;
+} stbi__jpeg_resample_job;
+
+static void stbi__jpeg_resample_worker(void *context, int index)
+{
+    stbi__jpeg_resample_job *job = (stbi__jpeg_resample_job *)context;
+    stbi__jpeg *z = job->z;
+    stbi_uc *linebuf[4];
+    stbi_uc *last_row = NULL;
+    int k;
+    for (k = 0; k < job->decode_n; ++k)
+        linebuf[k] = job->linebufs + (size_t)(index * job->decode_n + k) * (z->s->img_x + 3);
+    // the last band ends the image, where the output buffer has a spare byte for the overrun
+    if (job->last_rows && index + 1 < job->parts)
+        last_row = job->last_rows + (size_t)index * (job->n * z->s->img_x + 1);
+    stbi__jpeg_resample_rows(z, job->res_start, linebuf, job->output, job->n, job->decode_n,
+        (unsigned int)((double)z->s->img_y * index / job->parts),
+        (unsigned int)((double)z->s->img_y * (index + 1) / job->parts), last_row);
+}
+#endif
+
 static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
 {
     int n, decode_n;
@@ -3624,10 +4369,9 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
 
     // resample and color-convert
     {
-        int k;
-        unsigned int i, j;
+        int k, parts = 1;
         stbi_uc *output;
-        stbi_uc *coutput[4];
+        stbi_uc *linebuf[4];
 
         stbi__resample res_comp[4];
 
@@ -3657,53 +4401,33 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
         output = (stbi_uc *)stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
         if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
-        // now go ahead and resample
-        for (j = 0; j < z->s->img_y; ++j) {
-            stbi_uc *out = output + n * z->s->img_x * j;
-            for (k = 0; k < decode_n; ++k) {
-                stbi__resample *r = &res_comp[k];
-                int y_bot = r->ystep >= (r->vs >> 1);
-                coutput[k] = r->resample(z->img_comp[k].linebuf,
-                    y_bot ? r->line1 : r->line0,
-                    y_bot ? r->line0 : r->line1,
-                    r->w_lores, r->hs);
-                if (++r->ystep >= r->vs) {
-                    r->ystep = 0;
-                    r->line0 = r->line1;
-                    if (++r->ypos < z->img_comp[k].y)
-                        r->line1 += z->img_comp[k].w2;
-                }
-            }
-            if (n >= 3) {
-                stbi_uc *y = coutput[0];
-                if (z->s->img_n == 3) {
-                    if (z->rgb == 3) {
-                        for (i = 0; i < z->s->img_x; ++i) {
-                            out[0] = y[i];
-                            out[1] = coutput[1][i];
-                            out[2] = coutput[2][i];
-                            out[3] = 255;
-                            out += n;
-                        }
-                    }
-                    else {
-                        z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                    }
-                }
-                else
-                    for (i = 0; i < z->s->img_x; ++i) {
-                        out[0] = out[1] = out[2] = y[i];
-                        out[3] = 255; // not used if n==3
-                        out += n;
-                    }
+        // now go ahead and resample, in bands of rows on several threads if we can
+#ifdef STBI_JPEG_THREADS
+        parts = stbi__jpeg_threads_for(z);
+        if (parts > 1) {
+            stbi__jpeg_resample_job job;
+            job.linebufs = (stbi_uc *)stbi__malloc_mad3(parts * decode_n, z->s->img_x, 1, 3 * parts * decode_n);
+            job.last_rows = n == 3 ? (stbi_uc *)stbi__malloc_mad3(parts, n, z->s->img_x, parts) : NULL;
+            if (job.linebufs && (n != 3 || job.last_rows)) {
+                job.z = z;
+                job.res_start = res_comp;
+                job.output = output;
+                job.n = n;
+                job.decode_n = decode_n;
+                job.parts = parts;
+                stbi__parallel_for(parts, stbi__jpeg_resample_worker, &job);
             }
             else {
-                stbi_uc *y = coutput[0];
-                if (n == 1)
-                    for (i = 0; i < z->s->img_x; ++i) out[i] = y[i];
-                else
-                    for (i = 0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
+                parts = 1;
             }
+            STBI_FREE(job.linebufs);
+            STBI_FREE(job.last_rows);
+        }
+#endif
+        if (parts == 1) {
+            for (k = 0; k < decode_n; ++k)
+                linebuf[k] = z->img_comp[k].linebuf;
+            stbi__jpeg_resample_rows(z, res_comp, linebuf, output, n, decode_n, 0, z->s->img_y, NULL);
         }
         stbi__cleanup_jpeg(z);
         *out_x = z->s->img_x;
@@ -3771,6 +4495,10 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 #define STBI__ZFAST_BITS  9 // accelerate all cases in default tables
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 
+// literal/length lookup that can return two short literals at once
+#define STBI__ZPAIR_BITS  11
+#define STBI__ZPAIR_MASK  ((1 << STBI__ZPAIR_BITS) - 1)
+
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct
@@ -3847,6 +4575,51 @@ static int stbi__zbuild_huffman(stbi__zhuffman *z, stbi_uc *sizelist, int num)
     return 1;
 }
 
+// build the literal/length pair table from the same code lengths as stbi__zbuild_huffman
+// (which must have accepted them). each entry decodes the low STBI__ZPAIR_BITS bits of
+// the bit buffer:
+//    first symbol | second symbol << 9 | bits used << 17 | symbol count << 22
+// there's a second symbol only if both are literals and fit in the lookup together;
+// the entry is 0 if the first code is longer than the lookup.
+static void stbi__zbuild_pairs(stbi__uint32 *pairs, stbi_uc *sizelist, int num)
+{
+    stbi__uint16 single[1 << STBI__ZPAIR_BITS];
+    int i, j, s, code = 0, next_code[16], sizes[16];
+
+    memset(sizes, 0, sizeof(sizes));
+    memset(single, 0, sizeof(single));
+    for (i = 0; i < num; ++i)
+        ++sizes[sizelist[i]];
+    sizes[0] = 0;
+    for (s = 1; s < 16; ++s) {
+        next_code[s] = code;
+        code = (code + sizes[s]) << 1;
+    }
+    for (i = 0; i < num; ++i) {
+        s = sizelist[i];
+        if (!s) continue;
+        if (s <= STBI__ZPAIR_BITS)
+            for (j = stbi__bit_reverse(next_code[s], s); j < (1 << STBI__ZPAIR_BITS); j += 1 << s)
+                single[j] = (stbi__uint16)((s << 9) | i);
+        ++next_code[s];
+    }
+
+    for (i = 0; i < (1 << STBI__ZPAIR_BITS); ++i) {
+        int len0 = single[i] >> 9, sym0 = single[i] & 511;
+        stbi__uint32 entry = 0;
+        if (len0) {
+            entry = sym0 | (len0 << 17) | (1 << 22);
+            if (sym0 < 256) {
+                // the code after it only has STBI__ZPAIR_BITS - len0 valid bits in the index
+                int len1 = single[i >> len0] >> 9, sym1 = single[i >> len0] & 511;
+                if (len1 && sym1 < 256 && len0 + len1 <= STBI__ZPAIR_BITS)
+                    entry = sym0 | (sym1 << 9) | ((len0 + len1) << 17) | (2 << 22);
+            }
+        }
+        pairs[i] = entry;
+    }
+}
+
 // zlib-from-memory implementation for PNG reading
 //    because PNG allows splitting the zlib stream arbitrarily,
 //    and it's annoying structurally to have PNG call ZLIB call PNG,
@@ -3857,7 +4630,8 @@ typedef struct
 {
     stbi_uc *zbuffer, *zbuffer_end;
     int num_bits;
-    stbi__uint32 code_buffer;
+    int zpadding;            // zero bytes fed to the bit buffer past the end of the input
+    stbi__uint64 code_buffer;
 
     char *zout;
     char *zout_start;
@@ -3865,6 +4639,7 @@ typedef struct
     int   z_expandable;
 
     stbi__zhuffman z_length, z_distance;
+    stbi__uint32 z_length_pairs[1 << STBI__ZPAIR_BITS];
 } stbi__zbuf;
 
 stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
@@ -3873,20 +4648,42 @@ stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
     return *z->zbuffer++;
 }
 
+// little-endian unaligned 64-bit load
+stbi_inline static stbi__uint64 stbi__zload64(const stbi_uc *p)
+{
+#if defined(STBI__X86_TARGET) || defined(STBI__X64_TARGET)
+    stbi__uint64 v;
+    memcpy(&v, p, 8);
+    return v;
+#else
+    return (stbi__uint64)(p[0] | (p[1] << 8) | (p[2] << 16) | ((stbi__uint32)p[3] << 24)) |
+        ((stbi__uint64)(p[4] | (p[5] << 8) | (p[6] << 16) | ((stbi__uint32)p[7] << 24)) << 32);
+#endif
+}
+
+// top the bit buffer up to at least 56 bits. away from the end of the input that's one
+// 8-byte load, keeping the whole bytes that fit; the bits above num_bits then hold
+// the start of the next bytes rather than zeros, which every reader masks off.
 static void stbi__fill_bits(stbi__zbuf *z)
 {
+    if (z->zbuffer_end - z->zbuffer >= 8) {
+        z->code_buffer |= stbi__zload64(z->zbuffer) << z->num_bits;
+        z->zbuffer += (63 - z->num_bits) >> 3;
+        z->num_bits |= 56;
+        return;
+    }
     do {
-        STBI_ASSERT(z->code_buffer < (1U << z->num_bits));
-        z->code_buffer |= (unsigned int)stbi__zget8(z) << z->num_bits;
+        if (z->zbuffer >= z->zbuffer_end) ++z->zpadding;
+        z->code_buffer |= (stbi__uint64)stbi__zget8(z) << z->num_bits;
         z->num_bits += 8;
-    } while (z->num_bits <= 24);
+    } while (z->num_bits <= 56);
 }
 
 stbi_inline static unsigned int stbi__zreceive(stbi__zbuf *z, int n)
 {
     unsigned int k;
     if (z->num_bits < n) stbi__fill_bits(z);
-    k = z->code_buffer & ((1 << n) - 1);
+    k = (unsigned int)z->code_buffer & ((1 << n) - 1);
     z->code_buffer >>= n;
     z->num_bits -= n;
     return k;
@@ -3897,7 +4694,7 @@ static int stbi__zhuffman_decode_slowpath(stbi__zbuf *a, stbi__zhuffman *z)
     int b, s, k;
     // not resolved by fast table, so compute it the slow way
     // use jpeg approach, which requires MSbits at top
-    k = stbi__bit_reverse(a->code_buffer, 16);
+    k = stbi__bit_reverse((int)(a->code_buffer & 0xffff), 16);
     for (s = STBI__ZFAST_BITS + 1; ; ++s)
         if (k < z->maxcode[s])
             break;
@@ -3914,7 +4711,7 @@ stbi_inline static int stbi__zhuffman_decode(stbi__zbuf *a, stbi__zhuffman *z)
 {
     int b, s;
     if (a->num_bits < 16) stbi__fill_bits(a);
-    b = z->fast[a->code_buffer & STBI__ZFAST_MASK];
+    b = z->fast[(int)a->code_buffer & STBI__ZFAST_MASK];
     if (b) {
         s = b >> 9;
         a->code_buffer >>= s;
@@ -3961,7 +4758,31 @@ static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
     char *zout = a->zout;
     for (;;) {
-        int z = stbi__zhuffman_decode(a, &a->z_length);
+        int z;
+        stbi__uint32 pair;
+        // a literal/length code, its extra bits, a distance code and its extra bits
+        // take at most 48 bits, so one refill covers the whole symbol
+        if (a->num_bits < 48) stbi__fill_bits(a);
+        pair = a->z_length_pairs[(int)a->code_buffer & STBI__ZPAIR_MASK];
+        if (pair) {
+            int bits = (pair >> 17) & 31;
+            a->code_buffer >>= bits;
+            a->num_bits -= bits;
+            z = pair & 511;
+            if ((pair >> 22) == 2) {
+                if (zout + 2 > a->zout_end) {
+                    if (!stbi__zexpand(a, zout, 2)) return 0;
+                    zout = a->zout;
+                }
+                zout[0] = (char)z;
+                zout[1] = (char)(pair >> 9);
+                zout += 2;
+                continue;
+            }
+        }
+        else {
+            z = stbi__zhuffman_decode(a, &a->z_length);
+        }
         if (z < 256) {
             if (z < 0) return stbi__err("bad huffman code", "Corrupt PNG"); // error in huffman codes
             if (zout >= a->zout_end) {
@@ -3991,8 +4812,24 @@ static int stbi__parse_huffman_block(stbi__zbuf *a)
             }
             p = (stbi_uc *)(zout - dist);
             if (dist == 1) { // run of one byte; common in images.
-                stbi_uc v = *p;
-                if (len) { do *zout++ = v; while (--len); }
+                memset(zout, *p, len);
+                zout += len;
+            }
+            else if ((dist >= 8 || dist == 2 || dist == 4) && zout + len + 8 <= a->zout_end) {
+                // copy 8 bytes at a time, which may write up to 7 bytes past the match;
+                // they're inside the buffer and get overwritten by what follows
+                char *end = zout + len;
+                if (dist >= 8) {
+                    do { memcpy(zout, p, 8); zout += 8; p += 8; } while (zout < end);
+                }
+                else {
+                    // periods of 2 and 4 (gray+alpha and RGBA pixels) repeat exactly in 8 bytes
+                    stbi_uc pattern[8];
+                    int k;
+                    for (k = 0; k < 8; ++k) pattern[k] = p[k % dist];
+                    do { memcpy(zout, pattern, 8); zout += 8; } while (zout < end);
+                }
+                zout = end;
             }
             else {
                 if (len) { do *zout++ = *p++; while (--len); }
@@ -4048,6 +4885,7 @@ static int stbi__compute_huffman_codes(stbi__zbuf *a)
     if (n != ntot) return stbi__err("bad codelengths", "Corrupt PNG");
     if (!stbi__zbuild_huffman(&a->z_length, lencodes, hlit)) return 0;
     if (!stbi__zbuild_huffman(&a->z_distance, lencodes + hlit, hdist)) return 0;
+    stbi__zbuild_pairs(a->z_length_pairs, lencodes, hlit);
     return 1;
 }
 
@@ -4059,12 +4897,21 @@ static int stbi__parse_uncompressed_block(stbi__zbuf *a)
         stbi__zreceive(a, a->num_bits & 7); // discard
                                             // drain the bit-packed data into header
     k = 0;
-    while (a->num_bits > 0) {
+    while (a->num_bits > 0 && k < 4) {
         header[k++] = (stbi_uc)(a->code_buffer & 255); // suppress MSVC run-time check
         a->code_buffer >>= 8;
         a->num_bits -= 8;
     }
-    STBI_ASSERT(a->num_bits == 0);
+    // the bit buffer reads ahead; give back the whole bytes it still holds, except
+    // for any zero padding past the end of the input, which is the most recent
+    if (a->num_bits > 0) {
+        int held = a->num_bits >> 3;
+        if (held > a->zpadding)
+            a->zbuffer -= held - a->zpadding;
+    }
+    a->code_buffer = 0;
+    a->num_bits = 0;
+    a->zpadding = 0;
     // now fill header the normal way
     while (k < 4)
         header[k++] = stbi__zget8(a);
@@ -4112,6 +4959,7 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
     if (parse_header)
         if (!stbi__parse_zlib_header(a)) return 0;
     a->num_bits = 0;
+    a->zpadding = 0;
     a->code_buffer = 0;
     do {
         final = stbi__zreceive(a, 1);
@@ -4128,6 +4976,7 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
                 if (!stbi__zdefault_distance[31]) stbi__init_zdefaults();
                 if (!stbi__zbuild_huffman(&a->z_length, stbi__zdefault_length, 288)) return 0;
                 if (!stbi__zbuild_huffman(&a->z_distance, stbi__zdefault_distance, 32)) return 0;
+                stbi__zbuild_pairs(a->z_length_pairs, stbi__zdefault_length, 288);
             }
             else {
                 if (!stbi__compute_huffman_codes(a)) return 0;
@@ -4266,6 +5115,9 @@ typedef struct
     stbi__context *s;
     stbi_uc *idata, *expanded, *out;
     int depth;
+
+    // kernels
+    void(*unfilter_row_kernel)(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int count, int filter, int filter_bytes);
 } stbi__png;
 
 
@@ -4300,6 +5152,167 @@ static int stbi__paeth(int a, int b, int c)
     return c;
 }
 
+// unfilter the bytes of a scanline after its first pixel, when output pixels are packed like the input
+static void stbi__png_unfilter_row(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int count, int filter, int filter_bytes)
+{
+    int k;
+#define STBI__CASE(f) \
+       case f:     \
+          for (k=0; k < count; ++k)
+    switch (filter) {
+        // "none" filter turns into a memcpy here; make that explicit.
+    case STBI__F_none:         memcpy(cur, raw, count); break;
+        STBI__CASE(STBI__F_sub) { cur[k] = STBI__BYTECAST(raw[k] + cur[k - filter_bytes]); } break;
+        STBI__CASE(STBI__F_up) { cur[k] = STBI__BYTECAST(raw[k] + prior[k]); } break;
+        STBI__CASE(STBI__F_avg) { cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k - filter_bytes]) >> 1)); } break;
+        STBI__CASE(STBI__F_paeth) { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - filter_bytes], prior[k], prior[k - filter_bytes])); } break;
+        STBI__CASE(STBI__F_avg_first) { cur[k] = STBI__BYTECAST(raw[k] + (cur[k - filter_bytes] >> 1)); } break;
+        STBI__CASE(STBI__F_paeth_first) { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - filter_bytes], 0, 0)); } break;
+    }
+#undef STBI__CASE
+}
+
+#ifdef STBI_SSE2
+// 3- or 4-byte pixel loads and stores; bytes is a constant in every caller's loop
+stbi_inline static __m128i stbi__png_load_pixel(const stbi_uc *p, int bytes)
+{
+    int v;
+    if (bytes == 4)
+        memcpy(&v, p, 4);
+    else
+        v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return _mm_cvtsi32_si128(v);
+}
+
+stbi_inline static void stbi__png_store_pixel(stbi_uc *p, __m128i v, int bytes)
+{
+    int x = _mm_cvtsi128_si32(v);
+    if (bytes == 4) {
+        memcpy(p, &x, 4);
+    }
+    else {
+        p[0] = (stbi_uc)x;
+        p[1] = (stbi_uc)(x >> 8);
+        p[2] = (stbi_uc)(x >> 16);
+    }
+}
+
+// "up" 16 bytes at a time. avg and paeth depend on the pixel to the left, so they
+// go one 3- or 4-byte pixel at a time with all its channels in one register; paeth
+// picks its predictor with 16-bit compares instead of branches. "sub" is only an add
+// per byte, and the C loop does as well as a pixel at a time would.
+static void stbi__png_unfilter_row_simd(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int count, int filter, int filter_bytes)
+{
+    int k = 0;
+    if (filter == STBI__F_up) {
+        for (; k + 15 < count; k += 16) {
+            __m128i r = _mm_loadu_si128((const __m128i *) (raw + k));
+            __m128i p = _mm_loadu_si128((const __m128i *) (prior + k));
+            _mm_storeu_si128((__m128i *) (cur + k), _mm_add_epi8(r, p));
+        }
+        for (; k < count; ++k)
+            cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+    }
+    else if ((filter_bytes == 3 || filter_bytes == 4) && filter == STBI__F_avg) {
+        // floor((a + b) / 2) is the rounded-up average minus the bit it rounded by
+        __m128i one = _mm_set1_epi8(1);
+        __m128i a = stbi__png_load_pixel(cur - filter_bytes, filter_bytes);
+        for (; k < count; k += filter_bytes) {
+            __m128i b = stbi__png_load_pixel(prior + k, filter_bytes);
+            __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+            a = _mm_add_epi8(stbi__png_load_pixel(raw + k, filter_bytes), avg);
+            stbi__png_store_pixel(cur + k, a, filter_bytes);
+        }
+    }
+    else if ((filter_bytes == 3 || filter_bytes == 4) && filter == STBI__F_paeth) {
+        __m128i zero = _mm_setzero_si128();
+        __m128i a = _mm_unpacklo_epi8(stbi__png_load_pixel(cur - filter_bytes, filter_bytes), zero);
+        __m128i c = _mm_unpacklo_epi8(stbi__png_load_pixel(prior - filter_bytes, filter_bytes), zero);
+        for (; k < count; k += filter_bytes) {
+            __m128i b = _mm_unpacklo_epi8(stbi__png_load_pixel(prior + k, filter_bytes), zero);
+            // with p = a + b - c: |p - a| = |b - c|, |p - b| = |a - c|, |p - c| = |(b - c) + (a - c)|
+            __m128i pa = _mm_sub_epi16(b, c);
+            __m128i pb = _mm_sub_epi16(a, c);
+            __m128i pc = _mm_add_epi16(pa, pb);
+            __m128i smallest, use_a, use_b, pred, x;
+            pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+            pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+            pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+            // ties go to a, then b, like stbi__paeth
+            smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+            use_a = _mm_cmpeq_epi16(smallest, pa);
+            use_b = _mm_andnot_si128(use_a, _mm_cmpeq_epi16(smallest, pb));
+            pred = _mm_or_si128(_mm_and_si128(use_a, a), _mm_or_si128(_mm_and_si128(use_b, b),
+                _mm_andnot_si128(_mm_or_si128(use_a, use_b), c)));
+            x = _mm_add_epi8(stbi__png_load_pixel(raw + k, filter_bytes), _mm_packus_epi16(pred, pred));
+            stbi__png_store_pixel(cur + k, x, filter_bytes);
+            a = _mm_unpacklo_epi8(x, zero);
+            c = b;
+        }
+    }
+    else {
+        stbi__png_unfilter_row(cur, raw, prior, count, filter, filter_bytes);
+    }
+}
+#endif
+
+#ifdef STBI_AVX2
+// "up" is a plain byte add with the previous row, and "sub" on 4-byte pixels is a
+// running sum of pixels, done per 128-bit lane by shift-and-add and then carried
+// across lanes and iterations. the other filters depend on the previous pixel
+// through a nonlinear step, and are left to the sse2 version.
+STBI__AVX2_TARGET static void stbi__png_unfilter_row_avx2(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int count, int filter, int filter_bytes)
+{
+    int k = 0;
+    if (filter == STBI__F_up) {
+        for (; k + 31 < count; k += 32) {
+            __m256i r = _mm256_loadu_si256((const __m256i *) (raw + k));
+            __m256i p = _mm256_loadu_si256((const __m256i *) (prior + k));
+            _mm256_storeu_si256((__m256i *) (cur + k), _mm256_add_epi8(r, p));
+        }
+        for (; k < count; ++k)
+            cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+    }
+    else if (filter == STBI__F_sub && filter_bytes == 4) {
+        int left;
+        __m256i carry;
+        memcpy(&left, cur - 4, 4);
+        carry = _mm256_set1_epi32(left);
+        for (; k + 31 < count; k += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *) (raw + k));
+            v = _mm256_add_epi8(v, _mm256_slli_si256(v, 4));
+            v = _mm256_add_epi8(v, _mm256_slli_si256(v, 8));
+            // lane 0's total goes into every pixel of lane 1, the previous pixel into all of them
+            v = _mm256_add_epi8(v, _mm256_permute2x128_si256(_mm256_shuffle_epi32(v, 0xff), _mm256_shuffle_epi32(v, 0xff), 0x08));
+            v = _mm256_add_epi8(v, carry);
+            _mm256_storeu_si256((__m256i *) (cur + k), v);
+            carry = _mm256_permutevar8x32_epi32(v, _mm256_set1_epi32(7));
+        }
+        for (; k < count; ++k)
+            cur[k] = STBI__BYTECAST(raw[k] + cur[k - 4]);
+    }
+    else {
+        stbi__png_unfilter_row_simd(cur, raw, prior, count, filter, filter_bytes);
+    }
+}
+#endif
+
+// set up the kernels
+static void stbi__setup_png(stbi__png *p)
+{
+    p->unfilter_row_kernel = stbi__png_unfilter_row;
+
+#ifdef STBI_SSE2
+    if (stbi__sse2_available())
+        p->unfilter_row_kernel = stbi__png_unfilter_row_simd;
+#endif
+
+#ifdef STBI_AVX2
+    if (stbi__avx2_available())
+        p->unfilter_row_kernel = stbi__png_unfilter_row_avx2;
+#endif
+}
+
 static stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
 // create the png data from post-deflated data
@@ -4385,20 +5398,7 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
         // this is a little gross, so that we don't switch per-pixel or per-component
         if (depth < 8 || img_n == out_n) {
             int nk = (width - 1)*filter_bytes;
-#define STBI__CASE(f) \
-             case f:     \
-                for (k=0; k < nk; ++k)
-            switch (filter) {
-                // "none" filter turns into a memcpy here; make that explicit.
-            case STBI__F_none:         memcpy(cur, raw, nk); break;
-                STBI__CASE(STBI__F_sub) { cur[k] = STBI__BYTECAST(raw[k] + cur[k - filter_bytes]); } break;
-                STBI__CASE(STBI__F_up) { cur[k] = STBI__BYTECAST(raw[k] + prior[k]); } break;
-                STBI__CASE(STBI__F_avg) { cur[k] = STBI__BYTECAST(raw[k] + ((prior[k] + cur[k - filter_bytes]) >> 1)); } break;
-                STBI__CASE(STBI__F_paeth) { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - filter_bytes], prior[k], prior[k - filter_bytes])); } break;
-                STBI__CASE(STBI__F_avg_first) { cur[k] = STBI__BYTECAST(raw[k] + (cur[k - filter_bytes] >> 1)); } break;
-                STBI__CASE(STBI__F_paeth_first) { cur[k] = STBI__BYTECAST(raw[k] + stbi__paeth(cur[k - filter_bytes], 0, 0)); } break;
-            }
-#undef STBI__CASE
+            a->unfilter_row_kernel(cur, raw, prior, nk, filter, filter_bytes);
             raw += nk;
         }
         else {
@@ -4922,6 +5922,7 @@ static void *stbi__png_load(stbi__context *s, int *x, int *y, int *comp, int req
 {
     stbi__png p;
     p.s = s;
+    stbi__setup_png(&p);
     return stbi__do_png(&p, x, y, comp, req_comp, ri);
 }
 
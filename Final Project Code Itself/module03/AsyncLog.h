@@ -0,0 +1,368 @@
+/*
+* AsyncLog.h
+
+  Asynchronous logging for the frame loop. A LOG_* call does no I/O and
+  takes no lock: it copies its format string pointer and arguments into a
+  record in the calling thread's own single-producer ring buffer. A
+  background thread drains every ring, substitutes the arguments for the
+  "{}" placeholders in the format, and writes the lines a batch at a time,
+  so stdout is flushed once per batch instead of once per message.
+
+  Formats must be string literals; string arguments are copied into the
+  record. A full ring drops the message rather than stall the producer, and
+  the drop count is reported with the next batch.
+
+  Messages below LOG_MIN_LEVEL are removed at compile time, arguments and
+  all; by default that strips LOG_DEBUG from release (NDEBUG) builds. The
+  LOG_*_THROTTLED variants pass at most one message per LOG_THROTTLE_MS
+  from each call site, for messages repeated every frame, and report how
+  many were suppressed since the last one shown.
+
+      LOG_INFO("Camera Speed: {}", gCamera.MovementSpeed);
+      LOG_DEBUG_THROTTLED("W key pressed");
+*/
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_ERROR 3
+
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+const int LOG_RING_SIZE = 1024;         // Records per producer thread
+const int LOG_MAX_THREADS = 16;         // Producer threads; messages from any beyond this are dropped
+const int LOG_MAX_ARGS = 6;
+const int LOG_TEXT_SIZE = 96;           // Bytes for the string arguments of one record
+const int LOG_IDLE_MS = 5;              // Consumer sleep when every ring is empty
+const int LOG_THROTTLE_MS = 500;
+
+struct LogArg
+{
+    char type;          // 'i' signed, 'u' unsigned, 'f' floating point, 'b' bool, 's' offset into the record's text
+    union
+    {
+        long long i;
+        unsigned long long u;
+        double f;
+    };
+};
+
+struct LogRecord
+{
+    const char* format;
+    int64_t time;           // Nanoseconds on the steady clock
+    int level;
+    int argCount;
+    unsigned suppressed;    // Messages the call site's throttle held back before this one
+    LogArg args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_SIZE];
+    int textUsed;
+};
+
+// Single producer, single consumer: the owning thread advances head, the log thread advances tail
+struct LogRing
+{
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+    LogRecord records[LOG_RING_SIZE];
+};
+
+struct LogThrottle
+{
+    std::atomic<int64_t> lastTime;
+    std::atomic<unsigned> suppressed;
+};
+
+struct AsyncLog
+{
+    std::atomic<LogRing*> rings[LOG_MAX_THREADS];
+    std::atomic<int> ringCount;
+    std::atomic<unsigned> dropped;
+    std::atomic<bool> isRunning;
+    std::thread thread;
+    int64_t startTime;
+
+    AsyncLog();
+    ~AsyncLog();
+};
+
+inline int64_t ULogNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline AsyncLog& UGetLog()
+{
+    static AsyncLog log;
+    return log;
+}
+
+// The calling thread's ring, registered with the log on first use; null once every slot is taken
+inline LogRing* ULogThreadRing()
+{
+    thread_local LogRing* ring = nullptr;
+    thread_local bool isRegistered = false;
+    if (!isRegistered) {
+        isRegistered = true;
+        AsyncLog& log = UGetLog();
+        int slot = log.ringCount.fetch_add(1);
+        if (slot < LOG_MAX_THREADS) {
+            ring = new LogRing();
+            ring->head.store(0);
+            ring->tail.store(0);
+            log.rings[slot].store(ring, std::memory_order_release);
+        }
+    }
+    return ring;
+}
+
+// Argument packing: integers, floating point, bools and strings, which are copied
+inline void UPackLogString(LogRecord& record, LogArg& arg, const char* value)
+{
+    arg.type = 's';
+
+    // Earlier strings filled the text: this one is cut to nothing, pointing at the final terminator
+    if (record.textUsed >= LOG_TEXT_SIZE - 1) {
+        arg.i = LOG_TEXT_SIZE - 1;
+        record.text[LOG_TEXT_SIZE - 1] = '\0';
+        record.textUsed = LOG_TEXT_SIZE;
+        return;
+    }
+
+    size_t length = std::min(strlen(value ? value : "(null)"), (size_t)(LOG_TEXT_SIZE - 1 - record.textUsed));
+    memcpy(record.text + record.textUsed, value ? value : "(null)", length);
+    arg.i = record.textUsed;
+    record.textUsed += (int)length;
+    record.text[record.textUsed++] = '\0';
+}
+
+inline void UPackLogArg(LogRecord& record, LogArg& arg, const char* value) { UPackLogString(record, arg, value); }
+inline void UPackLogArg(LogRecord& record, LogArg& arg, char* value) { UPackLogString(record, arg, value); }
+inline void UPackLogArg(LogRecord& record, LogArg& arg, const unsigned char* value) { UPackLogString(record, arg, (const char*)value); }
+inline void UPackLogArg(LogRecord& record, LogArg& arg, const std::string& value) { UPackLogString(record, arg, value.c_str()); }
+inline void UPackLogArg(LogRecord&, LogArg& arg, bool value) { arg.type = 'b'; arg.i = value ? 1 : 0; }
+
+template <typename T>
+typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value>::type UPackLogArg(LogRecord&, LogArg& arg, T value)
+{
+    if (std::is_floating_point<T>::value) {
+        arg.type = 'f';
+        arg.f = (double)value;
+    }
+    else if (std::is_signed<T>::value || std::is_enum<T>::value) {
+        arg.type = 'i';
+        arg.i = (long long)value;
+    }
+    else {
+        arg.type = 'u';
+        arg.u = (unsigned long long)value;
+    }
+}
+
+inline void UPackLogArgs(LogRecord&, int) {}
+
+template <typename First, typename... Rest>
+void UPackLogArgs(LogRecord& record, int index, const First& first, const Rest&... rest)
+{
+    static_assert(sizeof...(Rest) < LOG_MAX_ARGS, "too many log arguments");
+    UPackLogArg(record, record.args[index], first);
+    UPackLogArgs(record, index + 1, rest...);
+}
+
+template <typename... Args>
+void ULog(int level, unsigned suppressed, const char* format, const Args&... args)
+{
+    LogRing* ring = ULogThreadRing();
+    size_t head = ring ? ring->head.load(std::memory_order_relaxed) : 0;
+    if (!ring || head - ring->tail.load(std::memory_order_acquire) >= (size_t)LOG_RING_SIZE) {
+        UGetLog().dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    LogRecord& record = ring->records[head % LOG_RING_SIZE];
+    record.format = format;
+    record.time = ULogNow();
+    record.level = level;
+    record.argCount = (int)sizeof...(Args);
+    record.suppressed = suppressed;
+    record.textUsed = 0;
+    UPackLogArgs(record, 0, args...);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+// Whether a throttled call site may log now; suppressed receives the messages held back since it last did
+inline bool UPassLogThrottle(LogThrottle& throttle, unsigned& suppressed)
+{
+    int64_t now = ULogNow();
+    int64_t last = throttle.lastTime.load(std::memory_order_relaxed);
+    if (last != 0 && now - last < (int64_t)LOG_THROTTLE_MS * 1000000) {
+        throttle.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    throttle.lastTime.store(now, std::memory_order_relaxed);
+    suppressed = throttle.suppressed.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+
+// Appends the record's line to out: elapsed time, level, then the format with its arguments substituted
+inline void UFormatLogRecord(const LogRecord& record, int64_t startTime, std::string& out)
+{
+    static const char* const levelNames[] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "[%10.3f] %s: ", (double)(record.time - startTime) / 1e9, levelNames[record.level]);
+    out += buffer;
+
+    int argIndex = 0;
+    for (const char* c = record.format; *c; ++c) {
+        if (c[0] != '{' || c[1] != '}' || argIndex >= record.argCount) {
+            out += *c;
+            continue;
+        }
+
+        const LogArg& arg = record.args[argIndex++];
+        switch (arg.type) {
+        case 'i': snprintf(buffer, sizeof(buffer), "%lld", arg.i); break;
+        case 'u': snprintf(buffer, sizeof(buffer), "%llu", arg.u); break;
+        case 'f': snprintf(buffer, sizeof(buffer), "%g", arg.f); break;
+        case 'b': snprintf(buffer, sizeof(buffer), "%s", arg.i ? "true" : "false"); break;
+        default: buffer[0] = '\0'; break;
+        }
+        out += arg.type == 's' ? record.text + arg.i : buffer;
+        ++c;
+    }
+
+    if (record.suppressed > 0) {
+        snprintf(buffer, sizeof(buffer), " (%u similar messages suppressed)", record.suppressed);
+        out += buffer;
+    }
+    out += '\n';
+}
+
+// Moves every queued record out of the rings, in time order, and writes them; false when there were none
+inline bool UFlushLog(AsyncLog& log, std::vector<LogRecord>& batch)
+{
+    batch.clear();
+    int ringCount = std::min(log.ringCount.load(), LOG_MAX_THREADS);
+    for (int i = 0; i < ringCount; ++i) {
+        LogRing* ring = log.rings[i].load(std::memory_order_acquire);
+        if (!ring)
+            continue;
+
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail)
+            batch.push_back(ring->records[tail % LOG_RING_SIZE]);
+        ring->tail.store(tail, std::memory_order_release);
+    }
+
+    unsigned dropped = log.dropped.exchange(0, std::memory_order_relaxed);
+    if (batch.empty() && dropped == 0)
+        return false;
+
+    std::stable_sort(batch.begin(), batch.end(), [](const LogRecord& a, const LogRecord& b) { return a.time < b.time; });
+
+    std::string out, errors;
+    for (const LogRecord& record : batch)
+        UFormatLogRecord(record, log.startTime, record.level >= LOG_LEVEL_WARNING ? errors : out);
+    if (dropped > 0)
+        errors += "Log: " + std::to_string(dropped) + " messages dropped, the ring buffers were full\n";
+
+    if (!out.empty()) {
+        fwrite(out.data(), 1, out.size(), stdout);
+        fflush(stdout);
+    }
+    if (!errors.empty()) {
+        fwrite(errors.data(), 1, errors.size(), stderr);
+        fflush(stderr);
+    }
+    return true;
+}
+
+inline AsyncLog::AsyncLog()
+{
+    for (std::atomic<LogRing*>& ring : rings)
+        ring.store(nullptr);
+    ringCount.store(0);
+    dropped.store(0);
+    isRunning.store(true);
+    startTime = ULogNow();
+
+    thread = std::thread([this]() {
+        std::vector<LogRecord> batch;
+        while (isRunning.load(std::memory_order_acquire)) {
+            if (!UFlushLog(*this, batch))
+                std::this_thread::sleep_for(std::chrono::milliseconds(LOG_IDLE_MS));
+        }
+        UFlushLog(*this, batch);
+    });
+}
+
+// Writes whatever is still queued; the rings are kept until here since their threads may outlive them
+inline AsyncLog::~AsyncLog()
+{
+    isRunning.store(false, std::memory_order_release);
+    if (thread.joinable())
+        thread.join();
+
+    for (std::atomic<LogRing*>& ring : rings)
+        delete ring.load();
+}
+
+#define LOG_AT(level, ...) ULog(level, 0, __VA_ARGS__)
+#define LOG_THROTTLED_AT(level, ...) do { \
+        static LogThrottle logThrottle; \
+        unsigned logSuppressed; \
+        if (UPassLogThrottle(logThrottle, logSuppressed)) \
+            ULog(level, logSuppressed, __VA_ARGS__); \
+    } while (0)
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_DEBUG_THROTTLED(...) LOG_THROTTLED_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#define LOG_DEBUG_THROTTLED(...) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_INFO_THROTTLED(...) LOG_THROTTLED_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#define LOG_INFO_THROTTLED(...) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING(...) LOG_AT(LOG_LEVEL_WARNING, __VA_ARGS__)
+#else
+#define LOG_WARNING(...) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,517 @@
+/*
+* BlockCompression.h
+
+  Load-time BCn texture encoder for 8-bit RGB/RGBA images: BC1 (opaque RGB,
+  4 bits per texel), BC3 (RGBA, 8 bits per texel) and BC7 (RGBA, 8 bits per
+  texel). BC7 blocks are always written in mode 6 (one subset, RGBA
+  endpoints with per-endpoint p-bits, 4-bit indices), which keeps the
+  encoder simple and fast but is not the quality BC7 is known for. Alpha
+  shares its endpoints and indices with color in mode 6, so textures with
+  varying alpha come out worse than in BC3, which encodes alpha separately
+  (bandana.png at BC_QUALITY_BALANCED: 35.8 dB against 42.5 dB). The modes
+  with separate alpha (4 and 5) are not implemented.
+
+  Blocks are encoded independently, so rows of blocks are spread across
+  threads; palette index selection evaluates four texels per SSE register.
+*/
+
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "ImagePostDecode.h" // UParallelRows
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BLOCK_COMPRESSION_SSE2
+#endif
+
+enum BcFormat
+{
+    BC_FORMAT_BC1,  // RGB, 8 bytes per 4x4 block
+    BC_FORMAT_BC3,  // RGBA, 8 bytes of alpha followed by a BC1 color block
+    BC_FORMAT_BC7   // RGBA, 16 bytes per block, written in mode 6
+};
+
+// Quality/speed presets
+enum BcQuality
+{
+    BC_QUALITY_FAST,        // Bounding box endpoints, no refinement
+    BC_QUALITY_BALANCED,    // Principal axis endpoints, one least-squares refinement
+    BC_QUALITY_HIGH         // Principal axis endpoints, iterative refinement, exhaustive BC7 p-bit search
+};
+
+inline size_t UBcBlockBytes(BcFormat format)
+{
+    return format == BC_FORMAT_BC1 ? 8 : 16;
+}
+
+// Size of the compressed data for a width x height image
+inline size_t UBcImageBytes(BcFormat format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * UBcBlockBytes(format);
+}
+
+// 4x4 texels as floats in [0, 255], one array per channel
+struct BcBlockTexels
+{
+    float channel[4][16];
+};
+
+// Reads a 4x4 block, repeating the last row/column for blocks that hang over the edge
+inline void UBcLoadBlock(const unsigned char* image, int width, int height, int channels, int blockX, int blockY, BcBlockTexels& block)
+{
+    for (int y = 0; y < 4; ++y) {
+        int sy = std::min(blockY * 4 + y, height - 1);
+        for (int x = 0; x < 4; ++x) {
+            int sx = std::min(blockX * 4 + x, width - 1);
+            const unsigned char* texel = image + ((size_t)sy * width + sx) * channels;
+            for (int c = 0; c < 3; ++c)
+                block.channel[c][y * 4 + x] = texel[c];
+            block.channel[3][y * 4 + x] = channels == 4 ? texel[3] : 255.0f;
+        }
+    }
+}
+
+// Picks the nearest palette entry for each texel and returns the summed squared error.
+// Channels with a zero mask are ignored.
+inline float UBcSelectIndices(const BcBlockTexels& block, const float palette[][4], int paletteSize, const float mask[4], int indices[16])
+{
+    float totalError = 0.0f;
+
+#ifdef BLOCK_COMPRESSION_SSE2
+    for (int group = 0; group < 16; group += 4) {
+        __m128 texel[4];
+        for (int c = 0; c < 4; ++c)
+            texel[c] = _mm_mul_ps(_mm_loadu_ps(&block.channel[c][group]), _mm_set1_ps(mask[c]));
+
+        __m128 bestError = _mm_set1_ps(1e30f);
+        __m128i bestIndex = _mm_setzero_si128();
+
+        for (int k = 0; k < paletteSize; ++k) {
+            __m128 error = _mm_setzero_ps();
+            for (int c = 0; c < 4; ++c) {
+                __m128 d = _mm_sub_ps(texel[c], _mm_set1_ps(palette[k][c] * mask[c]));
+                error = _mm_add_ps(error, _mm_mul_ps(d, d));
+            }
+
+            __m128i better = _mm_castps_si128(_mm_cmplt_ps(error, bestError));
+            bestError = _mm_min_ps(error, bestError);
+            bestIndex = _mm_or_si128(_mm_and_si128(better, _mm_set1_epi32(k)), _mm_andnot_si128(better, bestIndex));
+        }
+
+        _mm_storeu_si128((__m128i*)&indices[group], bestIndex);
+
+        float errors[4];
+        _mm_storeu_ps(errors, bestError);
+        totalError += errors[0] + errors[1] + errors[2] + errors[3];
+    }
+#else
+    for (int i = 0; i < 16; ++i) {
+        float bestError = 1e30f;
+        for (int k = 0; k < paletteSize; ++k) {
+            float error = 0.0f;
+            for (int c = 0; c < 4; ++c) {
+                float d = (block.channel[c][i] - palette[k][c]) * mask[c];
+                error += d * d;
+            }
+            if (error < bestError) {
+                bestError = error;
+                indices[i] = k;
+            }
+        }
+        totalError += bestError;
+    }
+#endif
+
+    return totalError;
+}
+
+// Initial endpoints for the masked channels: the bounding box diagonal (fast) or the extent of the
+// texels along their principal axis
+inline void UBcInitialEndpoints(const BcBlockTexels& block, const float mask[4], BcQuality quality, float endpoint0[4], float endpoint1[4])
+{
+    float minimum[4], maximum[4], mean[4];
+    for (int c = 0; c < 4; ++c) {
+        minimum[c] = 255.0f;
+        maximum[c] = 0.0f;
+        mean[c] = 0.0f;
+        for (int i = 0; i < 16; ++i) {
+            minimum[c] = std::min(minimum[c], block.channel[c][i]);
+            maximum[c] = std::max(maximum[c], block.channel[c][i]);
+            mean[c] += block.channel[c][i] / 16.0f;
+        }
+    }
+
+    if (quality == BC_QUALITY_FAST) {
+        // Inset the box by 1/16 of its extent so the interpolated entries land on the data
+        for (int c = 0; c < 4; ++c) {
+            float inset = (maximum[c] - minimum[c]) / 16.0f;
+            endpoint0[c] = mask[c] != 0.0f ? minimum[c] + inset : 255.0f;
+            endpoint1[c] = mask[c] != 0.0f ? maximum[c] - inset : 255.0f;
+        }
+        return;
+    }
+
+    // Covariance of the masked channels
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; ++i) {
+        float d[4];
+        for (int c = 0; c < 4; ++c)
+            d[c] = (block.channel[c][i] - mean[c]) * mask[c];
+        for (int a = 0; a < 4; ++a)
+            for (int b = 0; b < 4; ++b)
+                covariance[a][b] += d[a] * d[b];
+    }
+
+    // Power iteration, seeded with the bounding box diagonal
+    float axis[4];
+    for (int c = 0; c < 4; ++c)
+        axis[c] = (maximum[c] - minimum[c]) * mask[c];
+
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float next[4] = {};
+        for (int a = 0; a < 4; ++a)
+            for (int b = 0; b < 4; ++b)
+                next[a] += covariance[a][b] * axis[b];
+
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 4; ++c)
+            axis[c] = next[c] / length;
+    }
+
+    float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3]);
+    if (axisLength < 1e-6f) {
+        // Flat block: both endpoints at the mean
+        for (int c = 0; c < 4; ++c)
+            endpoint0[c] = endpoint1[c] = mask[c] != 0.0f ? mean[c] : 255.0f;
+        return;
+    }
+    for (int c = 0; c < 4; ++c)
+        axis[c] /= axisLength;
+
+    // Extent of the texels projected onto the axis
+    float lowest = 1e30f, highest = -1e30f;
+    for (int i = 0; i < 16; ++i) {
+        float t = 0.0f;
+        for (int c = 0; c < 4; ++c)
+            t += (block.channel[c][i] - mean[c]) * mask[c] * axis[c];
+        lowest = std::min(lowest, t);
+        highest = std::max(highest, t);
+    }
+
+    for (int c = 0; c < 4; ++c) {
+        endpoint0[c] = mask[c] != 0.0f ? std::min(std::max(mean[c] + axis[c] * lowest, 0.0f), 255.0f) : 255.0f;
+        endpoint1[c] = mask[c] != 0.0f ? std::min(std::max(mean[c] + axis[c] * highest, 0.0f), 255.0f) : 255.0f;
+    }
+}
+
+// Least-squares endpoints for fixed indices, where weights[index] is the interpolation factor toward
+// endpoint1. Leaves the endpoints untouched when the system is degenerate.
+inline void UBcRefineEndpoints(const BcBlockTexels& block, const float mask[4], const int indices[16], const float* weights, float endpoint0[4], float endpoint1[4])
+{
+    float alpha2 = 0.0f, beta2 = 0.0f, alphaBeta = 0.0f;
+    float alphaX[4] = {}, betaX[4] = {};
+
+    for (int i = 0; i < 16; ++i) {
+        float w = weights[indices[i]];
+        alpha2 += (1.0f - w) * (1.0f - w);
+        beta2 += w * w;
+        alphaBeta += (1.0f - w) * w;
+        for (int c = 0; c < 4; ++c) {
+            alphaX[c] += (1.0f - w) * block.channel[c][i];
+            betaX[c] += w * block.channel[c][i];
+        }
+    }
+
+    float determinant = alpha2 * beta2 - alphaBeta * alphaBeta;
+    if (std::fabs(determinant) < 1e-6f)
+        return;
+
+    for (int c = 0; c < 4; ++c) {
+        if (mask[c] == 0.0f)
+            continue;
+        endpoint0[c] = std::min(std::max((alphaX[c] * beta2 - betaX[c] * alphaBeta) / determinant, 0.0f), 255.0f);
+        endpoint1[c] = std::min(std::max((betaX[c] * alpha2 - alphaX[c] * alphaBeta) / determinant, 0.0f), 255.0f);
+    }
+}
+
+// BC1
+// ---
+
+inline uint16_t UBcPack565(const float color[4])
+{
+    int r = std::min(31, std::max(0, (int)(color[0] * 31.0f / 255.0f + 0.5f)));
+    int g = std::min(63, std::max(0, (int)(color[1] * 63.0f / 255.0f + 0.5f)));
+    int b = std::min(31, std::max(0, (int)(color[2] * 31.0f / 255.0f + 0.5f)));
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+inline void UBcUnpack565(uint16_t packed, float color[4])
+{
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (float)((r << 3) | (r >> 2));
+    color[1] = (float)((g << 2) | (g >> 4));
+    color[2] = (float)((b << 3) | (b >> 2));
+    color[3] = 255.0f;
+}
+
+// Four color BC1 block (also the color half of BC3)
+inline void UBcEncodeColorBlock(const BcBlockTexels& block, BcQuality quality, unsigned char* out)
+{
+    static const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    const float mask[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+
+    float endpoint0[4], endpoint1[4];
+    UBcInitialEndpoints(block, mask, quality, endpoint0, endpoint1);
+
+    int refinements = quality == BC_QUALITY_FAST ? 0 : (quality == BC_QUALITY_BALANCED ? 1 : 4);
+    uint16_t bestColor0 = 0, bestColor1 = 0;
+    int bestIndices[16] = {};
+    float bestError = 1e30f;
+
+    for (int pass = 0; pass <= refinements; ++pass) {
+        uint16_t color0 = UBcPack565(endpoint0);
+        uint16_t color1 = UBcPack565(endpoint1);
+
+        float palette[4][4];
+        UBcUnpack565(color0, palette[0]);
+        UBcUnpack565(color1, palette[1]);
+        for (int c = 0; c < 4; ++c) {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+
+        int indices[16];
+        float error = UBcSelectIndices(block, palette, 4, mask, indices);
+        if (error < bestError) {
+            bestError = error;
+            bestColor0 = color0;
+            bestColor1 = color1;
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+
+        if (pass < refinements)
+            UBcRefineEndpoints(block, mask, indices, weights, endpoint0, endpoint1);
+    }
+
+    // Four color mode needs color0 > color1; equal endpoints would select the three color mode,
+    // where index 3 is black, so every texel uses index 0 instead
+    if (bestColor0 < bestColor1) {
+        std::swap(bestColor0, bestColor1);
+        for (int i = 0; i < 16; ++i)
+            bestIndices[i] ^= 1;
+    }
+    else if (bestColor0 == bestColor1) {
+        memset(bestIndices, 0, sizeof(bestIndices));
+    }
+
+    uint32_t indexBits = 0;
+    for (int i = 0; i < 16; ++i)
+        indexBits |= (uint32_t)bestIndices[i] << (i * 2);
+
+    out[0] = (unsigned char)(bestColor0 & 0xFF);
+    out[1] = (unsigned char)(bestColor0 >> 8);
+    out[2] = (unsigned char)(bestColor1 & 0xFF);
+    out[3] = (unsigned char)(bestColor1 >> 8);
+    for (int i = 0; i < 4; ++i)
+        out[4 + i] = (unsigned char)(indexBits >> (i * 8));
+}
+
+// BC3 alpha
+// ---------
+
+// Eight value alpha block: endpoints at the alpha extremes (a0 > a1), 3-bit indices
+inline void UBcEncodeAlphaBlock(const BcBlockTexels& block, unsigned char* out)
+{
+    float lowest = 255.0f, highest = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        lowest = std::min(lowest, block.channel[3][i]);
+        highest = std::max(highest, block.channel[3][i]);
+    }
+
+    int alpha0 = (int)highest;
+    int alpha1 = (int)lowest;
+
+    uint64_t indexBits = 0;
+    if (alpha0 > alpha1) {
+        float palette[8][4] = {};
+        palette[0][3] = (float)alpha0;
+        palette[1][3] = (float)alpha1;
+        for (int k = 1; k < 7; ++k)
+            palette[k + 1][3] = (float)(((7 - k) * alpha0 + k * alpha1) / 7);
+
+        const float mask[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        int indices[16];
+        UBcSelectIndices(block, palette, 8, mask, indices);
+        for (int i = 0; i < 16; ++i)
+            indexBits |= (uint64_t)indices[i] << (i * 3);
+    }
+
+    out[0] = (unsigned char)alpha0;
+    out[1] = (unsigned char)alpha1;
+    for (int i = 0; i < 6; ++i)
+        out[2 + i] = (unsigned char)(indexBits >> (i * 8));
+}
+
+// BC7 mode 6
+// ----------
+
+// Appends bits LSB first into a 128-bit block
+struct BcBitWriter
+{
+    unsigned char* out;
+    int position;
+
+    void Write(uint32_t value, int bits)
+    {
+        for (int i = 0; i < bits; ++i, ++position) {
+            if ((value >> i) & 1)
+                out[position >> 3] |= (unsigned char)(1 << (position & 7));
+        }
+    }
+};
+
+// Quantizes an endpoint to 7 bits per channel plus a shared p-bit and returns the 8-bit result
+inline void UBc7QuantizeEndpoint(const float endpoint[4], int pBit, int quantized[4], float expanded[4])
+{
+    for (int c = 0; c < 4; ++c) {
+        quantized[c] = std::min(127, std::max(0, (int)std::floor((endpoint[c] - pBit) / 2.0f + 0.5f)));
+        expanded[c] = (float)((quantized[c] << 1) | pBit);
+    }
+}
+
+inline void UBcEncodeBc7Block(const BcBlockTexels& block, BcQuality quality, unsigned char* out)
+{
+    static const int interpolation[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    static const float weights[16] = {
+        0 / 64.0f, 4 / 64.0f, 9 / 64.0f, 13 / 64.0f, 17 / 64.0f, 21 / 64.0f, 26 / 64.0f, 30 / 64.0f,
+        34 / 64.0f, 38 / 64.0f, 43 / 64.0f, 47 / 64.0f, 51 / 64.0f, 55 / 64.0f, 60 / 64.0f, 64 / 64.0f
+    };
+    const float mask[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+    float endpoint0[4], endpoint1[4];
+    UBcInitialEndpoints(block, mask, quality, endpoint0, endpoint1);
+
+    int refinements = quality == BC_QUALITY_FAST ? 0 : (quality == BC_QUALITY_BALANCED ? 1 : 3);
+
+    int bestQuantized[2][4] = {};
+    int bestPBits[2] = {};
+    int bestIndices[16] = {};
+    float bestError = 1e30f;
+
+    for (int pass = 0; pass <= refinements; ++pass) {
+        int passIndices[16] = {};
+        float passError = 1e30f;
+
+        // High quality tries every p-bit pair; otherwise each p-bit follows its endpoint's rounding
+        for (int combination = 0; combination < 4; ++combination) {
+            int pBits[2] = { combination & 1, combination >> 1 };
+
+            if (quality != BC_QUALITY_HIGH) {
+                if (combination > 0)
+                    break;
+                float sum0 = 0.0f, sum1 = 0.0f;
+                for (int c = 0; c < 4; ++c) {
+                    sum0 += endpoint0[c];
+                    sum1 += endpoint1[c];
+                }
+                pBits[0] = ((int)(sum0 / 4.0f + 0.5f)) & 1;
+                pBits[1] = ((int)(sum1 / 4.0f + 0.5f)) & 1;
+            }
+
+            int quantized[2][4];
+            float expanded[2][4];
+            UBc7QuantizeEndpoint(endpoint0, pBits[0], quantized[0], expanded[0]);
+            UBc7QuantizeEndpoint(endpoint1, pBits[1], quantized[1], expanded[1]);
+
+            float palette[16][4];
+            for (int k = 0; k < 16; ++k)
+                for (int c = 0; c < 4; ++c)
+                    palette[k][c] = (float)(((64 - interpolation[k]) * (int)expanded[0][c] + interpolation[k] * (int)expanded[1][c] + 32) >> 6);
+
+            int indices[16];
+            float error = UBcSelectIndices(block, palette, 16, mask, indices);
+            if (error < passError) {
+                passError = error;
+                memcpy(passIndices, indices, sizeof(indices));
+            }
+            if (error < bestError) {
+                bestError = error;
+                memcpy(bestQuantized, quantized, sizeof(quantized));
+                bestPBits[0] = pBits[0];
+                bestPBits[1] = pBits[1];
+                memcpy(bestIndices, indices, sizeof(indices));
+            }
+        }
+
+        if (pass < refinements)
+            UBcRefineEndpoints(block, mask, passIndices, weights, endpoint0, endpoint1);
+    }
+
+    // The anchor (first) index is stored without its top bit, so it must be below 8
+    if (bestIndices[0] & 8) {
+        for (int c = 0; c < 4; ++c)
+            std::swap(bestQuantized[0][c], bestQuantized[1][c]);
+        std::swap(bestPBits[0], bestPBits[1]);
+        for (int i = 0; i < 16; ++i)
+            bestIndices[i] = 15 - bestIndices[i];
+    }
+
+    memset(out, 0, 16);
+    BcBitWriter writer = { out, 0 };
+    writer.Write(1 << 6, 7); // Mode 6
+    for (int c = 0; c < 4; ++c) {
+        writer.Write(bestQuantized[0][c], 7);
+        writer.Write(bestQuantized[1][c], 7);
+    }
+    writer.Write(bestPBits[0], 1);
+    writer.Write(bestPBits[1], 1);
+    writer.Write(bestIndices[0], 3);
+    for (int i = 1; i < 16; ++i)
+        writer.Write(bestIndices[i], 4);
+}
+
+// Compresses an 8-bit image with 3 or 4 channels; rows of blocks are encoded on separate threads
+inline std::vector<unsigned char> UCompressImageBC(const unsigned char* image, int width, int height, int channels, BcFormat format, BcQuality quality)
+{
+    const int blocksWide = (width + 3) / 4;
+    const int blocksHigh = (height + 3) / 4;
+    const size_t blockBytes = UBcBlockBytes(format);
+
+    std::vector<unsigned char> compressed(UBcImageBytes(format, width, height));
+
+    UParallelRows(blocksHigh, (long long)width * height, [&](int firstRow, int lastRow) {
+        BcBlockTexels block;
+        for (int by = firstRow; by < lastRow; ++by) {
+            for (int bx = 0; bx < blocksWide; ++bx) {
+                unsigned char* out = &compressed[((size_t)by * blocksWide + bx) * blockBytes];
+                UBcLoadBlock(image, width, height, channels, bx, by, block);
+
+                switch (format) {
+                case BC_FORMAT_BC1:
+                    UBcEncodeColorBlock(block, quality, out);
+                    break;
+                case BC_FORMAT_BC3:
+                    UBcEncodeAlphaBlock(block, out);
+                    UBcEncodeColorBlock(block, quality, out + 8);
+                    break;
+                case BC_FORMAT_BC7:
+                    UBcEncodeBc7Block(block, quality, out);
+                    break;
+                }
+            }
+        }
+    });
+
+    return compressed;
+}
+
+#endif
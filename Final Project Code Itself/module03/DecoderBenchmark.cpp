@@ -0,0 +1,585 @@
+/*
+* DecoderBenchmark.cpp
+
+  Standalone benchmark comparing the two image decoders in the tree,
+  includes/stb_image.h and the older includes/stb_image_aug.c, over a corpus of
+  files. Every file is decoded by both, and one CSV row per decoder and file is
+  written to stdout, followed by one row per decoder and format that totals the
+  files of that format. Notes about the run go to stderr, so the output can be
+  redirected straight into a results file and compared between builds.
+
+  Build with "make decoder_benchmark", or with MSVC from this directory:
+      cl /O2 /EHsc /I..\includes DecoderBenchmark.cpp StbImageAug.c
+
+  Usage: decoder_benchmark [--cold] [--iterations N] [--threads N] [--check-threads] [file or directory ...]
+      --cold        drop each file from the OS file cache and flush the CPU caches
+                    before every decode, and time reading the file back in
+      --iterations  timed decodes per decoder and file (default 20)
+      --threads     stb_image JPEG decoding threads, 0 for one per core (default 0)
+      --check-threads  instead of timing, decode every JPEG with stb_image on 2 to 16
+                    threads and every channel count, and exit with failure unless
+                    each image matches the single threaded decode byte for byte;
+                    "make decoder_check" runs this over the textures and the baseline
+                    and restart interval JPEGs in resources/tests/jpeg
+  Without files, the textures in resources/textures are used. The formats
+  covered are baseline and progressive JPEG, 8 and 16-bit PNG, TGA, BMP and HDR.
+*/
+
+#include <iostream>         // cout, cerr
+#include <algorithm>        // max, sort
+#include <atomic>
+#include <cctype>           // tolower
+#include <chrono>
+#include <cstdio>           // fopen, fread
+#include <cstdlib>          // malloc, EXIT_FAILURE
+#include <cstring>          // memcmp
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "StbImageAug.h" // stb_image_aug behind prefixed entry points, and the counting allocator
+
+// stb_image is compiled static here so its public names stay clear of stb_image_aug's,
+// and with the same JPEG threading as the application
+#define STBI_JPEG_THREADS
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_MALLOC(size) UCountedMalloc(size)
+#define STBI_REALLOC(block, size) UCountedRealloc(block, size)
+#define STBI_FREE(block) UCountedFree(block)
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function" // The parts of the API this program does not call
+#endif
+#include <stb_image.h>
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+using namespace std; // Standard namespace
+
+// Unnamed namespace
+namespace
+{
+    const char* const TEXTURE_DIRECTORY = "../resources/textures/";
+    const char* const TEXTURE_FILES[] = { "Milk.jpg", "bandana.png", "smiley.png" };
+    const char* const CORPUS_FORMATS[] = { "jpeg_baseline", "jpeg_progressive", "png8", "png16", "tga", "bmp", "hdr" };
+
+    const int DEFAULT_ITERATIONS = 20;
+    const int JPEG_CHECK_MAX_THREADS = 16;
+    const int JPEG_CHECK_REPEATS = 8;   // Threaded decodes per thread and channel count, since races depend on timing
+    const size_t CACHE_FLUSH_BYTES = 64 * 1024 * 1024; // Larger than any last level cache we run on
+
+    // Every block handed out by UCountedMalloc starts with its size, padded to keep the block aligned
+    const size_t ALLOCATION_HEADER_BYTES = 16;
+
+    // Heap use of the decoders. Atomic because stb_image decodes JPEGs on several threads
+    atomic<size_t> gAllocations(0);     // malloc and realloc calls
+    atomic<size_t> gHeapBytes(0);       // Bytes currently allocated
+    atomic<size_t> gPeakHeapBytes(0);   // Most bytes allocated at once since the last reset
+
+    // One decoder under test
+    struct Decoder
+    {
+        const char* name;
+        unsigned char* (*load)(const unsigned char* buffer, int length, int* width, int* height, int* channels, int requiredChannels);
+        float* (*loadf)(const unsigned char* buffer, int length, int* width, int* height, int* channels, int requiredChannels);
+        void (*imageFree)(void* image);
+        const char* (*failureReason)();
+    };
+
+    // Timings and heap use of one decoder over one file, or summed over all files of a format
+    struct DecodeResult
+    {
+        string decoder;
+        string format;
+        string file;
+        int width;
+        int height;
+        int channels;
+        size_t inputBytes;          // Size of the encoded file
+        double pixels;              // Decoded pixels per iteration
+        double readMilliseconds;    // Reading the file, per iteration (cold cache only)
+        double decodeMilliseconds;  // Decoding, per iteration
+        size_t allocations;         // Heap allocations per decode
+        size_t peakHeapBytes;       // Most heap the decoder held at once
+        string status;              // "ok", or why the decoder failed
+    };
+
+    bool gColdCache = false;
+    bool gCheckThreads = false;
+    int gIterations = DEFAULT_ITERATIONS;
+    int gThreads = 0;
+}
+
+/* Benchmark function prototypes */
+void UResetHeapPeak();
+bool UReadFile(const string& filename, vector<unsigned char>& contents);
+void UEvictFileCache(const string& filename);
+void UFlushCpuCaches();
+void UListFiles(const string& path, vector<string>& files);
+string UImageFormat(const string& filename, const vector<unsigned char>& contents);
+DecodeResult UBenchmarkDecoder(const Decoder& decoder, const string& filename, const string& format, vector<unsigned char>& contents);
+void UPrintResult(const char* scope, const DecodeResult& result);
+int UCheckJpegThreads(const vector<string>& files);
+
+
+extern "C" void* UCountedMalloc(size_t size)
+{
+    unsigned char* block = (unsigned char*)malloc(ALLOCATION_HEADER_BYTES + size);
+    if (!block)
+        return nullptr;
+
+    *(size_t*)block = size;
+    ++gAllocations;
+    size_t heapBytes = gHeapBytes += size;
+    size_t peak = gPeakHeapBytes.load();
+    while (heapBytes > peak && !gPeakHeapBytes.compare_exchange_weak(peak, heapBytes)) {}
+
+    return block + ALLOCATION_HEADER_BYTES;
+}
+
+extern "C" void* UCountedRealloc(void* block, size_t size)
+{
+    if (!block)
+        return UCountedMalloc(size);
+
+    unsigned char* header = (unsigned char*)block - ALLOCATION_HEADER_BYTES;
+    size_t oldSize = *(size_t*)header;
+    header = (unsigned char*)realloc(header, ALLOCATION_HEADER_BYTES + size);
+    if (!header)
+        return nullptr;
+
+    *(size_t*)header = size;
+    ++gAllocations;
+    size_t heapBytes = gHeapBytes += size - oldSize;
+    size_t peak = gPeakHeapBytes.load();
+    while (heapBytes > peak && !gPeakHeapBytes.compare_exchange_weak(peak, heapBytes)) {}
+
+    return header + ALLOCATION_HEADER_BYTES;
+}
+
+extern "C" void UCountedFree(void* block)
+{
+    if (!block)
+        return;
+
+    unsigned char* header = (unsigned char*)block - ALLOCATION_HEADER_BYTES;
+    gHeapBytes -= *(size_t*)header;
+    free(header);
+}
+
+
+int main(int argc, char* argv[])
+{
+    vector<string> files;
+    bool hasCorpus = false;
+
+    for (int i = 1; i < argc; ++i) {
+        string argument = argv[i];
+        if (argument == "--cold")
+            gColdCache = true;
+        else if (argument == "--iterations" && i + 1 < argc)
+            gIterations = max(1, atoi(argv[++i]));
+        else if (argument == "--threads" && i + 1 < argc)
+            gThreads = max(0, atoi(argv[++i]));
+        else if (argument == "--check-threads")
+            gCheckThreads = true;
+        else if (argument.compare(0, 2, "--") == 0) {
+            cerr << "Unknown option " << argument << endl;
+            cerr << "Usage: decoder_benchmark [--cold] [--iterations N] [--threads N] [--check-threads] [file or directory ...]" << endl;
+            return EXIT_FAILURE;
+        }
+        else {
+            UListFiles(argument, files);
+            hasCorpus = true;
+        }
+    }
+
+    if (!hasCorpus) {
+        for (const char* name : TEXTURE_FILES)
+            files.push_back(string(TEXTURE_DIRECTORY) + name);
+    }
+
+    if (gCheckThreads)
+        return UCheckJpegThreads(files) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    stbi_set_jpeg_thread_count(gThreads);
+
+    const Decoder decoders[] = {
+        { "stb_image", stbi_load_from_memory, stbi_loadf_from_memory, stbi_image_free, stbi_failure_reason },
+        { "stb_image_aug", UAugLoadFromMemory, UAugLoadfFromMemory, UAugImageFree, UAugFailureReason },
+    };
+
+    cerr << "Decoder benchmark: " << gIterations << " iterations per file, " << (gColdCache ? "cold" : "warm")
+         << " cache, " << gThreads << " JPEG threads (0 is one per core)" << endl;
+
+    // Totals per decoder and format, in the order formats are first seen
+    vector<DecodeResult> formatTotals;
+    vector<string> formatsSeen;
+
+    cout << "scope, decoder, format, file, width, height, channels, input bytes, iterations, cache, "
+            "read ms, decode ms, input MB/s, megapixels/s, allocations, peak heap bytes, status" << endl;
+
+    for (const string& filename : files) {
+        vector<unsigned char> contents;
+        if (!UReadFile(filename, contents)) {
+            cerr << filename << ": failed to read" << endl;
+            continue;
+        }
+
+        string format = UImageFormat(filename, contents);
+        if (find(formatsSeen.begin(), formatsSeen.end(), format) == formatsSeen.end())
+            formatsSeen.push_back(format);
+
+        for (const Decoder& decoder : decoders) {
+            DecodeResult result = UBenchmarkDecoder(decoder, filename, format, contents);
+            UPrintResult("file", result);
+
+            // Failed decodes have no rate to add, and would count their bytes and pixels against the others' time
+            if (result.status != "ok")
+                continue;
+
+            // Fold the file into its format's totals; allocations add up, peak heap is the largest of any file
+            auto total = find_if(formatTotals.begin(), formatTotals.end(),
+                [&](const DecodeResult& t) { return t.decoder == result.decoder && t.format == result.format; });
+            if (total == formatTotals.end()) {
+                DecodeResult first = result;
+                first.file = "*";
+                first.width = first.height = first.channels = 0;
+                formatTotals.push_back(first);
+                continue;
+            }
+            total->inputBytes += result.inputBytes;
+            total->pixels += result.pixels;
+            total->readMilliseconds += result.readMilliseconds;
+            total->decodeMilliseconds += result.decodeMilliseconds;
+            total->allocations += result.allocations;
+            total->peakHeapBytes = max(total->peakHeapBytes, result.peakHeapBytes);
+        }
+    }
+
+    for (const string& format : formatsSeen) {
+        for (const DecodeResult& total : formatTotals) {
+            if (total.format == format)
+                UPrintResult("format", total);
+        }
+    }
+
+    // Name what the corpus lacks, so a short run is not mistaken for full coverage
+    for (const char* format : CORPUS_FORMATS) {
+        if (find(formatsSeen.begin(), formatsSeen.end(), format) == formatsSeen.end())
+            cerr << "No " << format << " files in the corpus" << endl;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+// Starts a new peak heap measurement from what is allocated now
+void UResetHeapPeak()
+{
+    gPeakHeapBytes = gHeapBytes.load();
+}
+
+
+bool UReadFile(const string& filename, vector<unsigned char>& contents)
+{
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (!file)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(file);
+        return false;
+    }
+
+    contents.resize((size_t)size);
+    bool isRead = fread(contents.data(), 1, contents.size(), file) == contents.size();
+    fclose(file);
+    return isRead;
+}
+
+
+// Asks the OS to drop the file's pages from its cache, so the next read goes to the disk
+void UEvictFileCache(const string& filename)
+{
+#ifdef _WIN32
+    // Opening a file unbuffered discards its cached pages
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+#else
+    int file = open(filename.c_str(), O_RDONLY);
+    if (file < 0)
+        return;
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    close(file);
+#endif
+}
+
+
+// Streams through a buffer larger than the CPU caches, so the decoder starts with none of its data or tables cached
+void UFlushCpuCaches()
+{
+    static vector<unsigned char> scratch(CACHE_FLUSH_BYTES);
+    static unsigned char pass = 0;
+
+    ++pass;
+    for (size_t i = 0; i < scratch.size(); i += 64)
+        scratch[i] = (unsigned char)(scratch[i] + pass);
+}
+
+
+// Adds a file, or every file in a directory (not recursing), to the corpus
+void UListFiles(const string& path, vector<string>& files)
+{
+    vector<string> entries;
+
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE search = FindFirstFileA((path + "\\*").c_str(), &entry);
+    if (search == INVALID_HANDLE_VALUE) {
+        files.push_back(path);
+        return;
+    }
+    do {
+        if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            entries.push_back(path + "\\" + entry.cFileName);
+    } while (FindNextFileA(search, &entry));
+    FindClose(search);
+#else
+    DIR* directory = opendir(path.c_str());
+    if (!directory) {
+        files.push_back(path);
+        return;
+    }
+    while (dirent* entry = readdir(directory)) {
+        string name = path + "/" + entry->d_name;
+        struct stat info;
+        if (stat(name.c_str(), &info) == 0 && S_ISREG(info.st_mode))
+            entries.push_back(name);
+    }
+    closedir(directory);
+#endif
+
+    // Directory order is arbitrary; sort so runs line up row for row
+    sort(entries.begin(), entries.end());
+    files.insert(files.end(), entries.begin(), entries.end());
+}
+
+
+// Names the image format from the file's signature (TGA has none, so its extension is used).
+// JPEGs are split by their frame type and PNGs by their bit depth
+string UImageFormat(const string& filename, const vector<unsigned char>& contents)
+{
+    const unsigned char* data = contents.data();
+    size_t size = contents.size();
+
+    if (size >= 4 && data[0] == 0xFF && data[1] == 0xD8) {
+        // Walk the marker segments up to the start of frame
+        size_t at = 2;
+        while (at + 4 <= size && data[at] == 0xFF) {
+            unsigned char marker = data[at + 1];
+            if (marker == 0xC0 || marker == 0xC1)
+                return "jpeg_baseline";
+            if (marker == 0xC2)
+                return "jpeg_progressive";
+            if (marker == 0xFF) {
+                ++at;
+                continue;
+            }
+            at += 2 + ((size_t)data[at + 2] << 8 | data[at + 3]);
+        }
+        return "jpeg_other";
+    }
+
+    const unsigned char PNG_SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (size >= 25 && memcmp(data, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) == 0)
+        return data[24] == 16 ? "png16" : "png8"; // Bit depth field of IHDR
+
+    if (size >= 2 && data[0] == 'B' && data[1] == 'M')
+        return "bmp";
+    if ((size >= 10 && memcmp(data, "#?RADIANCE", 10) == 0) || (size >= 6 && memcmp(data, "#?RGBE", 6) == 0))
+        return "hdr";
+    if (size >= 4 && memcmp(data, "8BPS", 4) == 0)
+        return "psd";
+    if (size >= 4 && memcmp(data, "GIF8", 4) == 0)
+        return "gif";
+
+    string extension = filename.size() >= 4 ? filename.substr(filename.size() - 4) : "";
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (extension == ".tga")
+        return "tga";
+
+    return "unknown";
+}
+
+
+// Decodes the file gIterations times with one decoder. In a warm run one untimed decode comes first; in a
+// cold run every iteration reads the file back from disk after the caches are flushed
+DecodeResult UBenchmarkDecoder(const Decoder& decoder, const string& filename, const string& format, vector<unsigned char>& contents)
+{
+    typedef chrono::high_resolution_clock Clock;
+    auto milliseconds = [](Clock::duration d) { return chrono::duration<double, milli>(d).count(); };
+
+    DecodeResult result = { decoder.name, format, filename, 0, 0, 0, contents.size(), 0.0, 0.0, 0.0, 0, 0, "ok" };
+    bool isHdr = format == "hdr";
+
+    // Returns the decoded image, recording its size and the heap it took on the way
+    auto decode = [&]() -> void* {
+        size_t allocationsBefore = gAllocations.load();
+        size_t heapBefore = gHeapBytes.load();
+        UResetHeapPeak();
+
+        void* image = isHdr
+            ? (void*)decoder.loadf(contents.data(), (int)contents.size(), &result.width, &result.height, &result.channels, 0)
+            : (void*)decoder.load(contents.data(), (int)contents.size(), &result.width, &result.height, &result.channels, 0);
+
+        result.allocations = gAllocations.load() - allocationsBefore;
+        result.peakHeapBytes = gPeakHeapBytes.load() - heapBefore;
+        return image;
+    };
+
+    if (!gColdCache) {
+        void* image = decode();
+        if (!image) {
+            const char* reason = decoder.failureReason();
+            result.status = string("failed: ") + (reason ? reason : "unknown");
+            replace(result.status.begin(), result.status.end(), ',', ';'); // Keep the row's column count
+            return result;
+        }
+        decoder.imageFree(image);
+    }
+
+    for (int i = 0; i < gIterations; ++i) {
+        if (gColdCache) {
+            UEvictFileCache(filename);
+            UFlushCpuCaches();
+
+            Clock::time_point start = Clock::now();
+            UReadFile(filename, contents);
+            result.readMilliseconds += milliseconds(Clock::now() - start);
+        }
+
+        Clock::time_point start = Clock::now();
+        void* image = decode();
+        result.decodeMilliseconds += milliseconds(Clock::now() - start);
+
+        if (!image) {
+            const char* reason = decoder.failureReason();
+            result.status = string("failed: ") + (reason ? reason : "unknown");
+            replace(result.status.begin(), result.status.end(), ',', ';'); // Keep the row's column count
+            return result;
+        }
+        decoder.imageFree(image);
+    }
+
+    result.pixels = (double)result.width * result.height;
+    result.readMilliseconds /= gIterations;
+    result.decodeMilliseconds /= gIterations;
+    return result;
+}
+
+
+// Prints one CSV row. Throughput is in encoded input bytes, so formats compare by what is read from disk.
+// A failed decode leaves the timing and throughput columns empty: its time is one aborted attempt, not a rate
+void UPrintResult(const char* scope, const DecodeResult& result)
+{
+    cout << scope << ", " << result.decoder << ", " << result.format << ", " << result.file << ", "
+         << result.width << ", " << result.height << ", " << result.channels << ", " << result.inputBytes << ", "
+         << gIterations << ", " << (gColdCache ? "cold" : "warm") << ", ";
+
+    if (result.status == "ok") {
+        double seconds = result.decodeMilliseconds / 1000.0;
+        double megabytesPerSecond = seconds > 0.0 ? result.inputBytes / (1024.0 * 1024.0) / seconds : 0.0;
+        double megapixelsPerSecond = seconds > 0.0 ? result.pixels / 1.0e6 / seconds : 0.0;
+        cout << result.readMilliseconds << ", " << result.decodeMilliseconds << ", "
+             << megabytesPerSecond << ", " << megapixelsPerSecond << ", ";
+    }
+    else {
+        cout << ", , , , ";
+    }
+
+    cout << result.allocations << ", " << result.peakHeapBytes << ", " << result.status << endl;
+}
+
+
+// Decodes every JPEG with stb_image on one thread, then on each thread count up to JPEG_CHECK_MAX_THREADS,
+// for every requested channel count, and reports the first differing byte of each mismatch. Returns the
+// number of mismatching decodes
+int UCheckJpegThreads(const vector<string>& files)
+{
+    int mismatches = 0;
+    int checkedFiles = 0;
+
+    for (const string& filename : files) {
+        vector<unsigned char> contents;
+        if (!UReadFile(filename, contents) || UImageFormat(filename, contents).compare(0, 4, "jpeg") != 0)
+            continue;
+        ++checkedFiles;
+
+        for (int requiredChannels = 0; requiredChannels <= 4; ++requiredChannels) {
+            int width, height, channels;
+            stbi_set_jpeg_thread_count(1);
+            unsigned char* serial = stbi_load_from_memory(contents.data(), (int)contents.size(), &width, &height, &channels, requiredChannels);
+            if (!serial) {
+                cerr << filename << ": failed to decode: " << stbi_failure_reason() << endl;
+                ++mismatches;
+                break;
+            }
+            int outputChannels = requiredChannels ? requiredChannels : channels;
+            size_t rowBytes = (size_t)width * outputChannels;
+
+            for (int threads = 2; threads <= JPEG_CHECK_MAX_THREADS; ++threads) {
+                stbi_set_jpeg_thread_count(threads);
+                for (int repeat = 0; repeat < JPEG_CHECK_REPEATS; ++repeat) {
+                    unsigned char* threaded = stbi_load_from_memory(contents.data(), (int)contents.size(), &width, &height, &channels, requiredChannels);
+                    size_t differs = rowBytes * height;
+                    for (size_t i = 0; threaded && i < rowBytes * height; ++i) {
+                        if (threaded[i] != serial[i]) {
+                            differs = i;
+                            break;
+                        }
+                    }
+
+                    if (!threaded || differs < rowBytes * height) {
+                        cerr << filename << ": " << outputChannels << " channels on " << threads << " threads: ";
+                        if (threaded)
+                            cerr << "row " << differs / rowBytes << " byte " << differs % rowBytes << ": serial "
+                                 << (int)serial[differs] << ", threaded " << (int)threaded[differs] << endl;
+                        else
+                            cerr << "failed to decode: " << stbi_failure_reason() << endl;
+                        ++mismatches;
+                        stbi_image_free(threaded);
+                        break;
+                    }
+                    stbi_image_free(threaded);
+                }
+            }
+            stbi_image_free(serial);
+        }
+    }
+
+    cerr << "JPEG thread check: " << checkedFiles << " files, " << mismatches << " mismatches" << endl;
+    return mismatches;
+}
@@ -6,6 +6,8 @@
 */
 
 #include <iostream>         // cout, cerr
+#include <chrono>           // Image loading and decoder kernel benchmark timing
+#include <cstring>          // memcmp, memset
 #include <random>
 #include <vector>
 #include <cstdlib>          // EXIT_FAILURE
@@ -13,12 +15,26 @@
 #include <GLFW/glfw3.h>     // GLFW library
 #include <learnOpengl/camera.h> // Camera class
 #include <math.h>
+#define STBI_JPEG_THREADS // Decode large JPEGs on every core
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h> // Image loading Utility functions
+#include "ImagePostDecode.h" // Flip, channel expansion and premultiplication after decoding
+#include "MipGeneration.h" // Gamma-correct CPU mip chains
+#include "BlockCompression.h" // BC1/BC3/BC7 encoding at load time
+#include "MappedFile.h" // Memory-mapped image files for stbi_load_from_memory
+#include "VirtualTexture.h" // Tiled page files and tile streaming for virtual textures
+#include "ScenePicking.h" // Bounding volume hierarchy for picking scene objects with the mouse
+#include "StaticTransform.h" // Compile-time model matrices for static scenery
+#include "SimulationClock.h" // Fixed-timestep simulation on a 64-bit tick counter
+#include "FramePacing.h" // Swap interval, frame rate limiting and queued frame throttling
+#include "AsyncLog.h" // Lock-free logging written by a background thread, for the frame loop
+#include "InputEvents.h" // Queued GLFW input events dispatched to actions through a binding table
+#include "RenderThread.h" // Render thread owning the GL context, fed by the event thread
 
 // GLM Math Header inclusions
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
+#include <glm/gtx/fast_trigonometry.hpp> // Batched sin and cos for procedural geometry
 #include <glm/gtc/type_ptr.hpp>
 
 using namespace std; // Standard namespace
@@ -44,6 +60,8 @@ namespace
         GLuint vao;         // Handle for the vertex array object
         GLuint vbos[2];     // Handles for the vertex buffer objects
         GLuint nIndices;    // Number of indices of the mesh
+        GLuint depthVao;    // Handle for the position-only vertex array used by depth passes
+        GLuint depthVbo;    // Handle for the tightly packed position buffer
     };
 
     // Main GLFW window
@@ -58,10 +76,53 @@ namespace
     GLuint gProgramId;
     GLuint gLampProgramId;
 
-    // Texture
-    GLuint gTextureId;
+    // Textures
     glm::vec2 gUVScale(1.0f, 1.0f);
     GLint gTexWrapMode = GL_REPEAT;
+    const MipFilter TEXTURE_MIP_FILTER = MIP_FILTER_KAISER; // Filter for the CPU generated mip chains
+    const float TEXTURE_MAX_ANISOTROPY = 8.0f;               // Clamped to what the driver supports
+    const bool TEXTURE_COMPRESSION = true;                   // Encode textures to BCn when the driver supports it
+    const BcQuality TEXTURE_BC_QUALITY = BC_QUALITY_BALANCED;
+    const bool TEXTURE_PREFER_BC7 = false;                   // BC7 (mode 6 only) over BC1/BC3; worse than BC3 on alpha, see BlockCompression.h
+    const bool TEXTURE_FORCE_RGBA = true;                    // Expand RGB to RGBA so opaque and transparent textures share arrays
+    const int TEXTURE_MIN_BUCKET = 64;                       // Textures are resized to a power of two size bucket
+    const int TEXTURE_MAX_BUCKET = 2048;
+    const char* const TEXTURE_DIRECTORY = "C:/Users/ar274/Desktop/Final/Module Four Milestone/resources/textures/";
+    const char* const TEXTURE_FILES[] = { "Milk.jpg", "bandana.png", "smiley.png" }; // Also the image loading benchmark corpus
+    const int LOADING_BENCHMARK_ITERATIONS = 20;
+    const int KERNEL_BENCHMARK_ITERATIONS = 5000;            // Calls per decoder kernel variant
+    const int PICKING_BENCHMARK_OBJECTS = 100000;            // Cartons scattered through the picking benchmark
+    const int PICKING_BENCHMARK_RAYS = 10000;
+
+    // Same-size, same-format textures packed as the layers of one GL_TEXTURE_2D_ARRAY
+    struct TextureArray
+    {
+        GLuint id;              // 0 until UBuildTextureArrays allocates the storage
+        int size;               // Width and height of every layer
+        GLenum internalFormat;  // Sized or compressed format shared by every layer
+        GLenum format;          // Pixel format for uncompressed uploads
+        bool isCompressed;
+        int layerCount;
+    };
+    vector<TextureArray> gTextureArrays;
+
+    // Where a texture lives in the arrays
+    struct TextureLayer
+    {
+        int array;  // Index into gTextureArrays
+        int layer;  // Layer within that array
+    };
+    TextureLayer gMilkTexture;
+    TextureLayer gBandanaTexture;
+    TextureLayer gSmileyTexture;
+
+    // Decoded, resized and mip-mapped layer waiting for its array's storage
+    struct PendingTextureLayer
+    {
+        TextureLayer target;
+        vector<MipLevel> levels;    // Base level first; pixels hold BCn blocks when compressed
+    };
+    vector<PendingTextureLayer> gPendingTextureLayers;
 
     // camera
     Camera gCamera(glm::vec3(-1.0f, 2.4f, 3.0f));
@@ -71,9 +132,92 @@ namespace
     float gLastY = WINDOW_HEIGHT / 2.0f;
     bool gFirstMouse = true;
 
-    // timing
-    float gDeltaTime = 0.0f; // time between current frame and last frame
-    float gLastFrame = 0.0f;
+    // Everything the keys and mouse buttons can do
+    enum SceneAction
+    {
+        ACTION_NONE,
+        ACTION_QUIT,
+        ACTION_MOVE_FORWARD,
+        ACTION_MOVE_BACKWARD,
+        ACTION_MOVE_LEFT,
+        ACTION_MOVE_RIGHT,
+        ACTION_MOVE_UP,
+        ACTION_MOVE_DOWN,
+        ACTION_SPEED_DOWN,
+        ACTION_SPEED_UP,
+        ACTION_SPEED_RESET,
+        ACTION_CAMERA_PERSPECTIVE,
+        ACTION_CAMERA_ORTHO,
+        ACTION_WRAP_REPEAT,
+        ACTION_WRAP_MIRRORED_REPEAT,
+        ACTION_WRAP_CLAMP_TO_EDGE,
+        ACTION_WRAP_CLAMP_TO_BORDER,
+        ACTION_UV_SCALE_UP,
+        ACTION_UV_SCALE_DOWN,
+        ACTION_LAMP_RESUME,
+        ACTION_LAMP_PAUSE,
+        ACTION_TOGGLE_SHADOWS,
+        ACTION_TOGGLE_DIR_LIGHT,
+        ACTION_TOGGLE_DEPTH_PREPASS,
+        ACTION_TOGGLE_OVERDRAW,
+        ACTION_TOGGLE_VIRTUAL_TEXTURE,
+        ACTION_CYCLE_FRAME_PACING,
+        ACTION_PICK
+    };
+
+    const InputBinding INPUT_BINDINGS[] = {
+        { INPUT_EVENT_KEY, GLFW_KEY_ESCAPE, ACTION_QUIT },
+        { INPUT_EVENT_KEY, GLFW_KEY_W, ACTION_MOVE_FORWARD },
+        { INPUT_EVENT_KEY, GLFW_KEY_S, ACTION_MOVE_BACKWARD },
+        { INPUT_EVENT_KEY, GLFW_KEY_A, ACTION_MOVE_LEFT },
+        { INPUT_EVENT_KEY, GLFW_KEY_D, ACTION_MOVE_RIGHT },
+        { INPUT_EVENT_KEY, GLFW_KEY_Q, ACTION_MOVE_UP },
+        { INPUT_EVENT_KEY, GLFW_KEY_E, ACTION_MOVE_DOWN },
+        { INPUT_EVENT_KEY, GLFW_KEY_Z, ACTION_SPEED_DOWN },
+        { INPUT_EVENT_KEY, GLFW_KEY_C, ACTION_SPEED_UP },
+        { INPUT_EVENT_KEY, GLFW_KEY_X, ACTION_SPEED_RESET },
+        { INPUT_EVENT_KEY, GLFW_KEY_P, ACTION_CAMERA_PERSPECTIVE },
+        { INPUT_EVENT_KEY, GLFW_KEY_O, ACTION_CAMERA_ORTHO },
+        { INPUT_EVENT_KEY, GLFW_KEY_1, ACTION_WRAP_REPEAT },
+        { INPUT_EVENT_KEY, GLFW_KEY_2, ACTION_WRAP_MIRRORED_REPEAT },
+        { INPUT_EVENT_KEY, GLFW_KEY_3, ACTION_WRAP_CLAMP_TO_EDGE },
+        { INPUT_EVENT_KEY, GLFW_KEY_4, ACTION_WRAP_CLAMP_TO_BORDER },
+        { INPUT_EVENT_KEY, GLFW_KEY_RIGHT_BRACKET, ACTION_UV_SCALE_UP },
+        { INPUT_EVENT_KEY, GLFW_KEY_LEFT_BRACKET, ACTION_UV_SCALE_DOWN },
+        { INPUT_EVENT_KEY, GLFW_KEY_L, ACTION_LAMP_RESUME },
+        { INPUT_EVENT_KEY, GLFW_KEY_K, ACTION_LAMP_PAUSE },
+        { INPUT_EVENT_KEY, GLFW_KEY_F1, ACTION_TOGGLE_SHADOWS },
+        { INPUT_EVENT_KEY, GLFW_KEY_F2, ACTION_TOGGLE_DIR_LIGHT },
+        { INPUT_EVENT_KEY, GLFW_KEY_F3, ACTION_TOGGLE_DEPTH_PREPASS },
+        { INPUT_EVENT_KEY, GLFW_KEY_F4, ACTION_TOGGLE_OVERDRAW },
+        { INPUT_EVENT_KEY, GLFW_KEY_F5, ACTION_TOGGLE_VIRTUAL_TEXTURE },
+        { INPUT_EVENT_KEY, GLFW_KEY_F6, ACTION_CYCLE_FRAME_PACING },
+        { INPUT_EVENT_MOUSE_BUTTON, GLFW_MOUSE_BUTTON_LEFT, ACTION_PICK },
+    };
+
+    // Rates for the actions that repeat while held, matching the old per-frame steps at 60 frames per second
+    const float CAMERA_SPEED_CHANGE = 0.6f;    // Movement speed units per second
+    const float UV_SCALE_CHANGE = 6.0f;        // Texture coordinate scale per second
+
+    // Filled by the GLFW callbacks, drained by UProcessInput
+    InputQueue gInputQueue;
+    InputMap gInputMap;
+
+    // The main thread handles window events while the render thread draws
+    RenderThread gRenderThread;
+    int gFramebufferWidth = WINDOW_WIDTH;   // Render thread's copy of the framebuffer size
+    int gFramebufferHeight = WINDOW_HEIGHT;
+
+    // Simulation advances in fixed steps, at most SIMULATION_MAX_STEPS_PER_FRAME per frame
+    const int SIMULATION_STEPS_PER_SECOND = 120;
+    const int SIMULATION_MAX_STEPS_PER_FRAME = 8;
+    SimulationClock gSimulationClock;
+
+    // Frame pacing: chosen with --frame-pacing vsync|adaptive|uncapped|<fps> and cycled with F6
+    const FramePacingMode FRAME_PACING_DEFAULT_MODE = FRAME_PACING_VSYNC;
+    const double FRAME_PACING_DEFAULT_FPS = 60.0;
+    const int FRAME_PACING_QUEUED_FRAMES = 1;   // The GPU may draw one frame while the next is built; 0 serializes them
+    FramePacer gFramePacer;
 
     // Subject position and scale
     glm::vec3 gCubePosition(0.0f, 0.0f, 0.0f);
@@ -84,11 +228,156 @@ namespace
     glm::vec3 gLightColor(1.0f, 1.0f, 1.0f);
 
     //Light position and scale
-    glm::vec3 gLightPosition(1.5f, 0.5f, 3.0f);
+    const glm::vec3 LAMP_ORBIT_START(1.5f, 0.5f, 3.0f);
+    glm::vec3 gLightPosition = LAMP_ORBIT_START; // Interpolated between simulation steps each frame
     glm::vec3 gLightScale(0.3f);
 
-    // Lamp animation
+    // Lamp animation: its angle around the y axis at the previous and current simulation steps
     bool gIsLampOrbiting = true;
+    const double LAMP_ANGULAR_VELOCITY = glm::radians(45.0);
+    double gLampAngle = 0.0;
+    double gPreviousLampAngle = 0.0;
+
+    // Cap animation: it spins about the vertical through its center, so its shadow is drawn as a dynamic caster
+    bool gIsCapSpinning = true;
+    const double CAP_ANGULAR_VELOCITY = glm::radians(30.0);
+    double gCapAngle = 0.0;
+    double gPreviousCapAngle = 0.0;
+    int gCapObject = -1;            // Index of the cap in gSceneObjects
+    glm::mat4 gCapPlacement;        // The cap's translation; the spin is applied between it and gCapShape
+    glm::mat4 gCapShape;            // The cap's rotation and scale
+
+    // A single draw in the scene with its model matrix
+    struct SceneObject
+    {
+        GLuint vao;         // Handle for the vertex array object bound for the draw
+        GLuint depthVao;    // Position-only vertex array bound for depth passes
+        GLsizei nIndices;   // Number of indices drawn
+        glm::mat4 model;    // Model matrix
+        bool isStatic;      // Static casters are cached in the static shadow maps
+        TextureLayer texture;
+        bool hasVirtualTexture; // Samples the virtual texture instead of its layer while that is enabled
+        int pickMesh;       // Index into gPickMeshes of the triangles picking tests
+    };
+
+    // Objects drawn by the main pass and the shadow passes
+    vector<SceneObject> gSceneObjects;
+
+    // Triangles of every mesh picking tests, and the hierarchy over the scene objects' world space boxes
+    vector<PickMesh> gPickMeshes;
+    PickBvh gPickBvh;
+
+    // Per-instance texture layer of each scene object, fetched with the object's index as base instance
+    GLuint gInstanceLayerVbo = 0;
+
+    // Shadow settings
+    const int POINT_SHADOW_SIZE = 1024;
+    const int CASCADE_SHADOW_SIZE = 1024;
+    const int CASCADE_COUNT = 3;
+    const float POINT_SHADOW_FAR = 25.0f;
+    const float SHADOW_NEAR = 0.1f;
+    const float SHADOW_FAR = 100.0f;
+    const float LIGHT_MOVE_THRESHOLD = 0.05f; // World units the lamp may travel before the static map is re-rendered
+
+    // Cube shadow map for the orbiting lamp
+    struct PointShadowMap
+    {
+        GLuint fbo;             // Framebuffer the faces are attached to
+        GLuint staticCube;      // Depth of static casters, only re-rendered when the light moves past the threshold
+        GLuint cube;            // Static depth with dynamic casters composited on top, rebuilt every frame
+        glm::vec3 lightPos;     // Light position the cached maps were rendered from
+        bool isValid;           // False until the static map has been rendered once
+    };
+
+    // Cascaded shadow map for the directional light, one layer per cascade
+    struct CascadeShadowMap
+    {
+        GLuint fbo;
+        GLuint staticArray;                         // Depth of static casters per cascade
+        GLuint array;                               // Static depth with dynamic casters composited on top
+        glm::mat4 lightSpace[CASCADE_COUNT];        // Light view-projection each cached layer was rendered with
+        float splits[CASCADE_COUNT];                // View space far distance of each cascade
+        bool isValid[CASCADE_COUNT];
+    };
+
+    GLuint gShadowProgramId;
+    PointShadowMap gPointShadow;
+    CascadeShadowMap gCascadeShadow;
+    bool gShadowsEnabled = true;
+
+    // Directional light (off by default, toggled with F2)
+    bool gDirLightEnabled = false;
+    glm::vec3 gDirLightDirection(-0.4f, -1.0f, -0.3f);
+    glm::vec3 gDirLightColor(0.6f, 0.6f, 0.5f);
+
+    // Depth pre-pass (toggled with F3): lays down depth first so the main pass shades each pixel once
+    GLuint gDepthProgramId;
+    bool gDepthPrepassEnabled = false;
+
+    // Overdraw debug view (toggled with F4): per-pixel fragment invocation counts shown as a heatmap
+    struct OverdrawView
+    {
+        GLuint countProgramId;      // Counts fragment invocations into the counter image
+        GLuint heatmapProgramId;    // Maps the counts to colors over the whole screen
+        GLuint counterTexture;      // GL_R32UI image, one counter per pixel
+        int width;                  // Size the counter image was allocated with
+        int height;
+        int framesSinceReport;      // Statistics are read back once per OVERDRAW_REPORT_FRAMES
+    };
+    OverdrawView gOverdraw = {};
+    bool gOverdrawEnabled = false;
+    const int OVERDRAW_REPORT_FRAMES = 60;
+
+    // Virtual texture (toggled with F5): the carton label streamed from a tiled page file through a
+    // fixed-size tile cache, so its source image is bounded by disk rather than VRAM or GL_MAX_TEXTURE_SIZE
+    struct VirtualTextureView
+    {
+        GLuint feedbackProgramId;   // Writes the tile id each pixel needs
+        GLuint feedbackFbo;
+        GLuint feedbackTexture;     // GL_R32UI tile ids, VT_NO_TILE where nothing is virtual textured
+        GLuint feedbackDepth;
+        GLuint feedbackPbos[2];     // Read back one frame late so glReadPixels never stalls
+        int feedbackWidth;          // Size the feedback buffer was allocated with
+        int feedbackHeight;
+        unsigned int feedbackFrame;
+        GLuint cacheTexture;        // Physical tiles, VT_CACHE_SLOTS x VT_CACHE_SLOTS of VT_TILE_SIZE texels
+        GLuint indirectionTexture;  // GL_RGBA8UI cache slot and resident mip for every virtual tile
+    };
+    VirtualTexture gVirtualTexture;
+    VirtualTextureView gVirtualTextureView = {};
+    bool gVirtualTextureEnabled = false;
+    bool gVirtualTextureLoaded = false;
+    const char* const VT_SOURCE_FILE = "Milk.jpg";  // In TEXTURE_DIRECTORY; the page file is written next to it
+    const int VT_CACHE_SLOTS = 16;                  // 2048 x 2048 RGBA8 cache: a fixed 16 MB budget
+    const int VT_FEEDBACK_DIVISOR = 8;              // Feedback buffer is 1/8 of the framebuffer on each side
+    const int VT_UPLOADS_PER_FRAME = 16;            // Tiles copied into the cache per frame
+
+    // A render configuration measured by the benchmark harness
+    struct BenchmarkCase
+    {
+        const char* name;
+        void (*apply)();    // Sets the render state measured by this case
+    };
+
+    // Cases are run in order, each for warm-up frames followed by measured frames
+    const vector<BenchmarkCase> gBenchmarkCases = {
+        { "Forward shading", []() { gDepthPrepassEnabled = false; } },
+        { "Depth pre-pass + GL_EQUAL", []() { gDepthPrepassEnabled = true; } },
+    };
+    const int BENCHMARK_WARMUP_FRAMES = 60;
+    const int BENCHMARK_MEASURED_FRAMES = 500;
+
+    // Benchmark harness state, enabled with the --benchmark command line argument
+    struct BenchmarkRun
+    {
+        bool isEnabled;
+        size_t caseIndex;           // Index into gBenchmarkCases
+        int frame;                  // Frame number within the current case
+        GLuint timerQuery;          // GL_TIME_ELAPSED query wrapped around each frame
+        double gpuMilliseconds;     // GPU time accumulated over the measured frames
+        double caseStartTime;       // glfwGetTime() at the first measured frame
+    };
+    BenchmarkRun gBenchmark = {};
 }
 
 /* User-defined Function prototypes to:
@@ -98,18 +387,47 @@ namespace
  */
 bool UInitialize(int, char* [], GLFWwindow** window);
 void UResizeWindow(GLFWwindow* window, int width, int height);
-void UProcessInput(GLFWwindow* window);
+void UProcessInput();
+void UHandleAction(int action);
+void UHandleHeldAction(int action, float seconds);
+void ULookAround(double xpos, double ypos);
+void UKeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos);
 void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 void UMouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 void UCreateCartonMesh(GLMesh& mesh, vector<GLfloat>& verts, vector<GLushort>& indices);
 void UCreateMesh(GLMesh& mesh);
 void UDestroyMesh(GLMesh& mesh);
+void USimulateStep(double seconds);
 void URender();
+void URenderFrames(FramePacingMode pacingMode, double targetFps);
 bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
 void UDestroyShaderProgram(GLuint programId);
-bool UCreateTexture(const char* filename, GLuint& textureId);
-void UDestroyTexture(GLuint textureId);
+bool UAddTextureToArray(const char* filename, TextureLayer& texture);
+void UBuildTextureArrays();
+void UDestroyTextureArrays();
+void USetTextureWrapMode(GLint wrapMode);
+void UCreateScene();
+void UUpdatePickBvh();
+void UPickSceneObject();
+void UUploadInstanceLayers();
+void UDrawSceneObjects(GLint modelLoc, bool staticObjects, bool dynamicObjects, bool positionOnly);
+void URenderDepthPrepass(const glm::mat4& view, const glm::mat4& projection);
+void URenderOverdraw(const glm::mat4& view, const glm::mat4& projection);
+void UReportOverdraw();
+void UBeginBenchmarkFrame();
+void UEndBenchmarkFrame();
+void UBenchmarkImageLoading();
+void UBenchmarkImageKernels();
+void UBenchmarkPicking();
+bool UCreateShadowMaps();
+void UDestroyShadowMaps();
+void URenderShadowMaps(const glm::mat4& view);
+glm::mat4 UComputeCascadeMatrix(const glm::mat4& view, float nearSplit, float farSplit);
+bool UCreateVirtualTexture();
+void UDestroyVirtualTexture();
+void URenderVirtualTextureFeedback(const glm::mat4& view, const glm::mat4& projection);
+void UUpdateVirtualTexture();
 
 vector <GLfloat> GenCylinderVerts(float radius, float zPos);
 vector <GLushort> GenCylinderIndices();
@@ -120,10 +438,16 @@ const GLchar * vertexShaderSource = GLSL(440,
     layout(location = 0) in vec3 position;// Vertex data Vertex Attrib Pointer 0
     layout(location = 1) in vec3 normal;
     layout(location = 2) in vec2 textureCoordinate;  // Color data from Vertex Attrib Pointer 1
+    layout(location = 3) in float textureLayer;      // Per-instance layer in the bound texture array
 
     out vec3 vertexNormal;
     out vec3 vertexFragmentPos;
-    out vec2 vertexTextureCoordinate; 
+    out vec2 vertexTextureCoordinate;
+    out float vertexViewDepth; // Used to select the shadow cascade
+    flat out float vertexTextureLayer;
+
+    // Must match the depth pre-pass bit for bit so GL_EQUAL passes
+    invariant gl_Position;
 
     //Global variables for the  transform matrices
     uniform mat4 model;
@@ -132,13 +456,16 @@ const GLchar * vertexShaderSource = GLSL(440,
 
     void main()
     {
-        gl_Position = projection * view * model * vec4(position, 1.0f); // transforms vertices to clip coordinates
+        vec4 viewPos = view * model * vec4(position, 1.0f);
+        gl_Position = projection * viewPos; // transforms vertices to clip coordinates
 
         vertexFragmentPos = vec3(model * vec4(position, 1.0f));
+        vertexViewDepth = -viewPos.z;
 
         vertexNormal = mat3(transpose(inverse(model))) * normal;
 
         vertexTextureCoordinate = textureCoordinate; // references incoming color data
+        vertexTextureLayer = textureLayer;
     }
 );
 
@@ -148,6 +475,8 @@ const GLchar* fragmentShaderSource = GLSL(440,
     in vec3 vertexNormal;
     in vec3 vertexFragmentPos;
     in vec2 vertexTextureCoordinate; // Variable to hold incoming color data from vertex shader
+    in float vertexViewDepth;
+    flat in float vertexTextureLayer;
 
     out vec4 fragmentColor;
 
@@ -155,9 +484,102 @@ const GLchar* fragmentShaderSource = GLSL(440,
     uniform vec3 lightColor;
     uniform vec3 lightPos;
     uniform vec3 viewPosition;
-    uniform sampler2D uTexture;
+    uniform sampler2DArray uTexture;
     uniform vec2 uvScale;
 
+    // Virtual texture uniforms
+    uniform sampler2D vtCache;
+    uniform usampler2D vtIndirection;
+    uniform vec2 vtSize;                // Base level size in texels
+    uniform int vtMipCount;
+    uniform int vtMipRowOffset[16];     // First indirection row of each mip
+    uniform float vtTileSize;           // Tile side in the cache, borders included
+    uniform float vtTileBorder;
+    uniform float vtCacheSize;          // Cache side in texels
+
+    // Shadow uniforms
+    uniform bool shadowsEnabled;
+    uniform samplerCube pointShadowMap;     // Linear distance to the lamp divided by pointShadowFar
+    uniform vec3 pointShadowLightPos;       // Lamp position the cached cube map was rendered from
+    uniform float pointShadowFar;
+    uniform bool dirLightEnabled;
+    uniform vec3 dirLightDirection;
+    uniform vec3 dirLightColor;
+    uniform sampler2DArrayShadow cascadeShadowMap;
+    uniform mat4 cascadeMatrices[3];
+    uniform float cascadeSplits[3];
+
+    // Samples the virtual texture through the indirection table, falling back to the closest resident mip
+    vec4 VirtualTextureColor(vec2 uv)
+    {
+        float payload = vtTileSize - 2.0 * vtTileBorder;
+        vec2 texel = uv * vtSize;
+        float lod = log2(max(length(dFdx(texel)), length(dFdy(texel))));
+        int mip = clamp(int(lod), 0, vtMipCount - 1);
+
+        vec2 levelSize = max(floor(vtSize / exp2(float(mip))), vec2(1.0));
+        vec2 wrapped = fract(uv);
+        ivec2 tile = ivec2(clamp(floor(wrapped * levelSize / payload), vec2(0.0), ceil(levelSize / payload) - 1.0));
+
+        uvec4 entry = texelFetch(vtIndirection, ivec2(tile.x, vtMipRowOffset[mip] + tile.y), 0);
+        if (entry.a == 0u)
+            return vec4(0.5, 0.5, 0.5, 1.0); // Nothing streamed in yet
+
+        // Position within the resident tile, which may belong to a coarser mip than requested
+        vec2 residentSize = max(floor(vtSize / exp2(float(entry.b))), vec2(1.0));
+        vec2 residentTexel = wrapped * residentSize;
+        vec2 within = residentTexel - floor(residentTexel / payload) * payload;
+        vec2 cacheTexel = vec2(entry.rg) * vtTileSize + vtTileBorder + within;
+        return textureLod(vtCache, cacheTexel / vtCacheSize, 0.0);
+    }
+
+    // Returns 1.0 when the fragment is lit by the lamp, 0.0 when fully shadowed
+    float PointShadow(vec3 norm)
+    {
+        vec3 toFragment = vertexFragmentPos - pointShadowLightPos;
+        float currentDepth = length(toFragment);
+        float bias = 0.05 + 0.05 * (1.0 - abs(dot(norm, normalize(toFragment))));
+        float diskRadius = 0.01 * (1.0 + currentDepth / pointShadowFar);
+
+        // Small PCF kernel along the axes around the lookup direction
+        float lit = 0.0;
+        vec3 offsets[5] = vec3[](vec3(0.0), vec3(1.0, 0.0, 0.0), vec3(-1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, 0.0, 1.0));
+        for (int i = 0; i < 5; ++i) {
+            float closestDepth = texture(pointShadowMap, toFragment + offsets[i] * diskRadius * currentDepth).r * pointShadowFar;
+            lit += currentDepth - bias > closestDepth ? 0.0 : 1.0;
+        }
+        return lit / 5.0;
+    }
+
+    // Returns 1.0 when the fragment is lit by the directional light, 0.0 when fully shadowed
+    float CascadeShadow(vec3 norm)
+    {
+        int cascade = 2;
+        for (int i = 0; i < 3; ++i) {
+            if (vertexViewDepth < cascadeSplits[i]) {
+                cascade = i;
+                break;
+            }
+        }
+
+        vec4 lightSpacePos = cascadeMatrices[cascade] * vec4(vertexFragmentPos, 1.0);
+        vec3 projCoords = lightSpacePos.xyz / lightSpacePos.w * 0.5 + 0.5;
+        if (projCoords.z > 1.0)
+            return 1.0;
+
+        float bias = max(0.002 * (1.0 - dot(norm, -normalize(dirLightDirection))), 0.0005);
+        vec2 texelSize = 1.0 / vec2(textureSize(cascadeShadowMap, 0).xy);
+
+        // 3x3 PCF using hardware depth comparison
+        float lit = 0.0;
+        for (int x = -1; x <= 1; ++x) {
+            for (int y = -1; y <= 1; ++y) {
+                lit += texture(cascadeShadowMap, vec4(projCoords.xy + vec2(x, y) * texelSize, float(cascade), projCoords.z - bias));
+            }
+        }
+        return lit / 9.0;
+    }
+
     void main()
     {
         // Phong lighting model calculations to generate ambient, diffuse, and specular components
@@ -185,10 +607,22 @@ const GLchar* fragmentShaderSource = GLSL(440,
         vec3 specular = specularIntensity * specularComponent * lightColor;
 
         // Texture holds the color to be used for all three components
-        vec4 textureColor = texture(uTexture, vertexTextureCoordinate * uvScale);
+        // A negative layer selects the virtual texture
+        vec4 textureColor = vertexTextureLayer < 0.0 ? VirtualTextureColor(vertexTextureCoordinate * uvScale)
+                                                     : texture(uTexture, vec3(vertexTextureCoordinate * uvScale, vertexTextureLayer));
+
+        // Shadowing only attenuates the diffuse and specular terms of each light
+        float pointLit = shadowsEnabled ? PointShadow(norm) : 1.0;
+
+        vec3 directional = vec3(0.0);
+        if (dirLightEnabled) {
+            float dirImpact = max(dot(norm, -normalize(dirLightDirection)), 0.0);
+            float dirLit = shadowsEnabled ? CascadeShadow(norm) : 1.0;
+            directional = dirImpact * dirLit * dirLightColor;
+        }
 
         // Calculate phong result
-        vec3 phong = (ambient + diffuse + specular) * textureColor.xyz;
+        vec3 phong = (ambient + pointLit * (diffuse + specular) + directional) * textureColor.xyz;
 
         fragmentColor = vec4(phong, 1.0); // Send lighting results to GPU
         
@@ -220,6 +654,153 @@ const GLchar* lampFragmentShaderSource = GLSL(440,
     }
 );
 
+/* Depth pre-pass Vertex Shader Source Code*/
+const GLchar* depthVertexShaderSource = GLSL(440,
+
+    layout(location = 0) in vec3 position; // Position-only stream
+
+    invariant gl_Position;
+
+    uniform mat4 model;
+    uniform mat4 view;
+    uniform mat4 projection;
+
+    void main() {
+
+        // Same expression as the main vertex shader so depth values are identical
+        vec4 viewPos = view * model * vec4(position, 1.0f);
+        gl_Position = projection * viewPos;
+    }
+);
+
+/* Depth pre-pass Fragment Shader Source Code*/
+const GLchar* depthFragmentShaderSource = GLSL(440,
+
+    void main() {
+    }
+);
+
+/* Overdraw counting Fragment Shader Source Code*/
+const GLchar* overdrawFragmentShaderSource = GLSL(440,
+
+    // Keep the depth test ahead of the shader so only fragments that would be shaded are counted
+    layout(early_fragment_tests) in;
+
+    layout(r32ui, binding = 0) uniform uimage2D fragmentCounts;
+
+    void main() {
+
+        imageAtomicAdd(fragmentCounts, ivec2(gl_FragCoord.xy), 1u);
+    }
+);
+
+/* Overdraw heatmap Vertex Shader Source Code*/
+const GLchar* heatmapVertexShaderSource = GLSL(440,
+
+    void main() {
+
+        // Full screen triangle generated from the vertex index, no vertex buffer needed
+        vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+    }
+);
+
+/* Overdraw heatmap Fragment Shader Source Code*/
+const GLchar* heatmapFragmentShaderSource = GLSL(440,
+
+    layout(r32ui, binding = 0) uniform readonly uimage2D fragmentCounts;
+
+    uniform float maxCount; // Count shown at the hot end of the ramp
+
+    out vec4 fragmentColor;
+
+    void main() {
+
+        uint count = imageLoad(fragmentCounts, ivec2(gl_FragCoord.xy)).r;
+        if (count == 0u) {
+            fragmentColor = vec4(0.0, 0.0, 0.0, 1.0);
+            return;
+        }
+
+        // Blue for a single invocation through green and yellow to red at maxCount
+        float t = clamp((float(count) - 1.0) / (maxCount - 1.0), 0.0, 1.0);
+        vec3 cold = mix(vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 0.0), clamp(t * 2.0, 0.0, 1.0));
+        vec3 hot = mix(vec3(1.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), clamp(t * 2.0 - 1.0, 0.0, 1.0));
+        fragmentColor = vec4(t < 0.5 ? cold : hot, 1.0);
+    }
+);
+
+/* Virtual texture feedback: the tile (and mip) each pixel of the virtual textured objects needs */
+const GLchar* feedbackFragmentShaderSource = GLSL(440,
+    in vec2 vertexTextureCoordinate;
+    flat in float vertexTextureLayer;
+
+    out uint feedback;
+
+    uniform vec2 uvScale;
+    uniform vec2 vtSize;
+    uniform int vtMipCount;
+    uniform float vtTileSize;
+    uniform float vtTileBorder;
+    uniform float vtLodBias;    // The buffer is smaller than the screen, so derivatives are larger than in the main pass
+
+    void main()
+    {
+        if (vertexTextureLayer >= 0.0) {
+            feedback = 0xFFFFFFFFu;
+            return;
+        }
+
+        float payload = vtTileSize - 2.0 * vtTileBorder;
+        vec2 uv = vertexTextureCoordinate * uvScale;
+        vec2 texel = uv * vtSize;
+        float lod = log2(max(length(dFdx(texel)), length(dFdy(texel)))) + vtLodBias;
+        int mip = clamp(int(lod), 0, vtMipCount - 1);
+
+        vec2 levelSize = max(floor(vtSize / exp2(float(mip))), vec2(1.0));
+        uvec2 tile = uvec2(clamp(floor(fract(uv) * levelSize / payload), vec2(0.0), ceil(levelSize / payload) - 1.0));
+
+        // Same packing as UVirtualTileId
+        feedback = (uint(mip) << 28) | (tile.y << 14) | tile.x;
+    }
+);
+
+/* Shadow depth Vertex Shader Source Code*/
+const GLchar* shadowVertexShaderSource = GLSL(440,
+
+    layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
+
+    out vec3 vertexFragmentPos;
+
+    uniform mat4 model;
+    uniform mat4 lightSpace; // Light view-projection for the face or cascade being rendered
+
+    void main() {
+
+        vec4 worldPos = model * vec4(position, 1.0f);
+        vertexFragmentPos = worldPos.xyz;
+        gl_Position = lightSpace * worldPos;
+    }
+);
+
+/* Shadow depth Fragment Shader Source Code*/
+const GLchar* shadowFragmentShaderSource = GLSL(440,
+
+    in vec3 vertexFragmentPos;
+
+    uniform bool linearDepth;   // Point light faces store distance to the light instead of projected depth
+    uniform vec3 lightPos;
+    uniform float farPlane;
+
+    void main() {
+
+        if (linearDepth)
+            gl_FragDepth = length(vertexFragmentPos - lightPos) / farPlane;
+        else
+            gl_FragDepth = gl_FragCoord.z;
+    }
+);
+
 /* Vectors to hold shape vertices and indices */
 vector <GLfloat> cartonVerts = {
     // Vertex positions // Colors (r,g,b,a)
@@ -287,9 +868,14 @@ vector <GLfloat> GenCylinderVerts(float radius, float zPos) {
     //initialize x and y
     float initX = 0;
     float initY = -radius;
-    float angle;
     vector <GLfloat> cylinderVerts;
 
+    // Sector angles around the circle, shared by both caps, with their sines and cosines in one batch
+    GLfloat angles[SECTOR_COUNT], sines[SECTOR_COUNT], cosines[SECTOR_COUNT];
+    for (int i = 0; i < SECTOR_COUNT; ++i)
+        angles[i] = glm::two_pi<float>() * i / SECTOR_COUNT;
+    glm::fastSinCos(angles, sines, cosines, SECTOR_COUNT);
+
     for (int i = 0; i < 2; ++i) {
         float h = -zPos / 2.0f + i * zPos; // Height -> h / 2 or -h / 2
         float red = RandomFloat();
@@ -318,9 +904,8 @@ vector <GLfloat> GenCylinderVerts(float radius, float zPos) {
 
         // Calculate new x and y for each sector
         for (int i = 0; i < SECTOR_COUNT; ++i) {
-            angle = 3.1415926 * 2.0f * i / SECTOR_COUNT;
-            float newX = radius * sin(angle);
-            float newY = -radius * cos(angle);
+            float newX = radius * sines[i];
+            float newY = -radius * cosines[i];
 
             cylinderVerts.push_back(newX);
             cylinderVerts.push_back(newY);
@@ -396,24 +981,24 @@ float RandomFloat() {
     return distr(eng);
 }
 
-// Images are loaded with Y axis going down, but OpenGL's Y axis goes up, so let's flip it
-void flipImageVertically(unsigned char* image, int width, int height, int channels)
+int main(int argc, char* argv[])
 {
-    for (int j = 0; j < height / 2; ++j) {
-        int index1 = j * width * channels;
-        int index2 = (height - 1 - j) * width * channels;
-        for (int i = width * channels; i > 0; --i) {
-            unsigned char tmp = image[index1];
-            image[index1] = image[index2];
-            image[index2] = tmp;
-            ++index1;
-            ++index2;
+    // Image loading and picking benchmarks run on the CPU only and need no window
+    for (int i = 1; i < argc; ++i) {
+        if (string(argv[i]) == "--benchmark-loading") {
+            UBenchmarkImageLoading();
+            return EXIT_SUCCESS;
+        }
+        if (string(argv[i]) == "--benchmark-kernels") {
+            UBenchmarkImageKernels();
+            return EXIT_SUCCESS;
+        }
+        if (string(argv[i]) == "--benchmark-picking") {
+            UBenchmarkPicking();
+            return EXIT_SUCCESS;
         }
     }
-}
 
-int main(int argc, char* argv[])
-{
     if (!UInitialize(argc, argv, &gWindow))
         return EXIT_FAILURE;
 
@@ -429,265 +1014,721 @@ int main(int argc, char* argv[])
     if (!UCreateShaderProgram(lampVertexShaderSource, lampFragmentShaderSource, gLampProgramId))
         return EXIT_FAILURE;
 
-    // Load texture
-    const char* texFilename = "C:/Users/ar274/Desktop/Final/Module Four Milestone/resources/textures/Milk.jpg";
+    if (!UCreateShaderProgram(shadowVertexShaderSource, shadowFragmentShaderSource, gShadowProgramId))
+        return EXIT_FAILURE;
+
+    if (!UCreateShaderProgram(depthVertexShaderSource, depthFragmentShaderSource, gDepthProgramId))
+        return EXIT_FAILURE;
+
+    if (!UCreateShaderProgram(depthVertexShaderSource, overdrawFragmentShaderSource, gOverdraw.countProgramId))
+        return EXIT_FAILURE;
+
+    if (!UCreateShaderProgram(heatmapVertexShaderSource, heatmapFragmentShaderSource, gOverdraw.heatmapProgramId))
+        return EXIT_FAILURE;
+
+    // Load textures into layers of the size bucket arrays, then allocate and upload every array at once
+    TextureLayer* textureTargets[] = { &gMilkTexture, &gBandanaTexture, &gSmileyTexture };
+
+    for (int i = 0; i < 3; ++i) {
+        string texFilename = string(TEXTURE_DIRECTORY) + TEXTURE_FILES[i];
+        if (!UAddTextureToArray(texFilename.c_str(), *textureTargets[i])) {
+            cout << "Failed to load texture " << texFilename << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    UBuildTextureArrays();
 
-    if (!UCreateTexture(texFilename, gTextureId)) {
-        cout << "Failed to load texture " << texFilename << endl;
+    // Place the scene objects and allocate the shadow maps they are cast into
+    UCreateScene();
+
+    if (!UCreateShadowMaps()) {
+        cout << "Failed to create shadow map framebuffers" << endl;
         return EXIT_FAILURE;
     }
 
     glUseProgram(gProgramId); // tell opengl for each sampler to which texture unit it belongs to
     
     glUniform1i(glGetUniformLocation(gProgramId, "uTexture"), 0); // We set the texture as texture unit 0
+    glUniform1i(glGetUniformLocation(gProgramId, "pointShadowMap"), 1); // Lamp cube shadow map on texture unit 1
+    glUniform1i(glGetUniformLocation(gProgramId, "cascadeShadowMap"), 2); // Directional cascades on texture unit 2
 
     // Sets the background color of the window to black (it will be implicitely used by glClear)
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
-    // render loop
-    // -----------
-    while (!glfwWindowShouldClose(gWindow))
-    {
-        // per-frame timing
-        // --------------------
-        float currentFrame = glfwGetTime();
-        gDeltaTime = currentFrame - gLastFrame;
-        gLastFrame = currentFrame;
-
-        // input
-        // -----
-        UProcessInput(gWindow);
-
-        // Render this frame
-        URender();
-
-        glfwPollEvents();
+    // Presentation starts in the default mode, overridden by --frame-pacing
+    FramePacingMode pacingMode = FRAME_PACING_DEFAULT_MODE;
+    double targetFps = FRAME_PACING_DEFAULT_FPS;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (string(argv[i]) == "--frame-pacing") {
+            string value = argv[i + 1];
+            if (value == "vsync")
+                pacingMode = FRAME_PACING_VSYNC;
+            else if (value == "adaptive")
+                pacingMode = FRAME_PACING_ADAPTIVE_VSYNC;
+            else if (value == "uncapped")
+                pacingMode = FRAME_PACING_UNCAPPED;
+            else if (atof(value.c_str()) > 0.0) {
+                pacingMode = FRAME_PACING_TARGET_FPS;
+                targetFps = atof(value.c_str());
+            }
+            else
+                cout << "Unknown frame pacing mode " << value << ", using " << UFramePacingModeName(pacingMode) << endl;
+        }
+    }
+    // Benchmark mode renders a fixed view without vsync and exits once every case has been measured
+    for (int i = 1; i < argc; ++i) {
+        if (string(argv[i]) == "--benchmark") {
+            gBenchmark.isEnabled = true;
+            gIsLampOrbiting = false;
+            gIsCapSpinning = false;     // Still drawn as a dynamic caster, so its shadow pass is measured
+            pacingMode = FRAME_PACING_UNCAPPED;
+            glGenQueries(1, &gBenchmark.timerQuery);
+            gBenchmarkCases[0].apply();
+            cout << "Benchmark: " << gBenchmarkCases.size() << " cases, " << BENCHMARK_MEASURED_FRAMES << " frames each" << endl;
+        }
     }
 
+    // From here this thread only handles window and input events; the render thread draws until the window closes
+    UStartRenderThread(gRenderThread, gWindow, [pacingMode, targetFps]() { URenderFrames(pacingMode, targetFps); });
+    URunEventLoop(gRenderThread, gWindow);
+
     // Release mesh data
     UDestroyMesh(cartonMesh);
     UDestroyMesh(cartonCapMesh);
     UDestroyMesh(gMesh);
 
-    // Release texture
-    UDestroyTexture(gTextureId);
+    // Release textures
+    UDestroyTextureArrays();
+    glDeleteBuffers(1, &gInstanceLayerVbo);
+
+    // Release shadow maps
+    UDestroyShadowMaps();
+
+    // Stop streaming and release the virtual texture
+    UDestroyVirtualTexture();
 
     // Release shader program
     UDestroyShaderProgram(gProgramId);
     UDestroyShaderProgram(gLampProgramId);
+    UDestroyShaderProgram(gShadowProgramId);
+    UDestroyShaderProgram(gDepthProgramId);
+    UDestroyShaderProgram(gOverdraw.countProgramId);
+    UDestroyShaderProgram(gOverdraw.heatmapProgramId);
+    glDeleteTextures(1, &gOverdraw.counterTexture);
 
     exit(EXIT_SUCCESS); // Terminates the program successfully
 }
 
-// Initialize GLFW, GLEW, and create a window
-bool UInitialize(int argc, char* argv[], GLFWwindow** window)
+// Render thread: draws frames with the window's context until the event thread stops it
+void URenderFrames(FramePacingMode pacingMode, double targetFps)
 {
-    // GLFW: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // The swap interval belongs to the context, so presentation is set up on the thread that owns it
+    pacingMode = UStartFramePacer(gFramePacer, pacingMode, targetFps, FRAME_PACING_QUEUED_FRAMES);
+    LOG_INFO("Frame Pacing: {}", UFramePacingModeName(pacingMode));
 
-    // GLFW: window creation
-    // ---------------------
-    * window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE, NULL, NULL);
-    if (*window == NULL)
+    UStartSimulationClock(gSimulationClock, glfwGetTimerValue(), glfwGetTimerFrequency(), SIMULATION_STEPS_PER_SECOND, SIMULATION_MAX_STEPS_PER_FRAME);
+
+    // render loop
+    // -----------
+    while (URenderThreadRunning(gRenderThread))
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return false;
-    }
-    glfwMakeContextCurrent(*window);
-    glfwSetFramebufferSizeCallback(*window, UResizeWindow);
-    glfwSetCursorPosCallback(*window, UMousePositionCallback);
-    glfwSetScrollCallback(*window, UMouseScrollCallback);
-    glfwSetMouseButtonCallback(*window, UMouseButtonCallback);
+        // Wait for the frame's start time before reading input, so input is as recent as possible when drawn
+        UWaitForNextFrame(gFramePacer);
 
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(*window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        // per-frame timing
+        // --------------------
+        uint64_t currentFrameTime = glfwGetTimerValue();
 
-    // GLEW: initialize
-    // ----------------
-    // Note: if using GLEW version 1.13 or earlier
-    glewExperimental = GL_TRUE;
-    GLenum GlewInitResult = glewInit();
+        // Follow the window's framebuffer if the event thread saw it resized
+        if (UTakeFramebufferSize(gRenderThread, gFramebufferWidth, gFramebufferHeight))
+            glViewport(0, 0, gFramebufferWidth, gFramebufferHeight);
 
-    if (GLEW_OK != GlewInitResult)
-    {
-        std::cerr << glewGetErrorString(GlewInitResult) << std::endl;
-        return false;
+        // simulation
+        // ----------
+        // Benchmark frames take exactly one step each, so every run renders the same states
+        if (gBenchmark.isEnabled)
+            currentFrameTime = gSimulationClock.lastTime + gSimulationClock.stepTicks;
+        int steps = UAdvanceSimulationClock(gSimulationClock, currentFrameTime);
+        for (int i = 0; i < steps; ++i)
+            USimulateStep(USimulationStepSeconds(gSimulationClock));
+
+        // input
+        // -----
+        // Drained last, so the camera is as recent as possible when URender reads it
+        if (!gBenchmark.isEnabled)
+            UProcessInput();
+        UMarkFrameInput(gFramePacer);
+
+        // Render this frame
+        UBeginBenchmarkFrame();
+        URender();
+        UEndBenchmarkFrame();
+
+        // Keep the driver from queueing frames ahead of the GPU
+        UEndFramePacing(gFramePacer);
     }
 
-    // Displays GPU OpenGL version
-    cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << endl;
+    UStopFramePacer(gFramePacer);
+}
 
-    return true;
+// Starts the GPU timer for a measured benchmark frame
+void UBeginBenchmarkFrame()
+{
+    if (!gBenchmark.isEnabled)
+        return;
+
+    if (gBenchmark.frame == BENCHMARK_WARMUP_FRAMES)
+        gBenchmark.caseStartTime = glfwGetTime();
+
+    if (gBenchmark.frame >= BENCHMARK_WARMUP_FRAMES)
+        glBeginQuery(GL_TIME_ELAPSED, gBenchmark.timerQuery);
 }
 
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
-void UProcessInput(GLFWwindow* window)
+// Accumulates the frame's GPU time and advances to the next case once enough frames were measured
+void UEndBenchmarkFrame()
 {
-    // Camera Speed    
-    static float cameraSpeed = 2.5f * gDeltaTime;
+    if (!gBenchmark.isEnabled)
+        return;
 
-    // Escape Key Pressed - Escape the window
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-        glfwSetWindowShouldClose(window, true);
-    }
+    if (gBenchmark.frame >= BENCHMARK_WARMUP_FRAMES) {
+        glEndQuery(GL_TIME_ELAPSED);
 
-    // Escape Key Pressed - Move camera forward
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-        gCamera.ProcessKeyboard(FORWARD, gDeltaTime);
-        cout << "W key pressed" << endl;
+        // Waiting on the result serializes CPU and GPU, which is acceptable while benchmarking
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(gBenchmark.timerQuery, GL_QUERY_RESULT, &elapsed);
+        gBenchmark.gpuMilliseconds += elapsed / 1.0e6;
     }
 
-    // S Key Pressed - Move camera backward
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-        gCamera.ProcessKeyboard(BACKWARD, gDeltaTime);
-        cout << "S key pressed" << endl;
-    }
+    if (++gBenchmark.frame < BENCHMARK_WARMUP_FRAMES + BENCHMARK_MEASURED_FRAMES)
+        return;
 
-    // A Key Pressed - Move camera left
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-        gCamera.ProcessKeyboard(LEFT, gDeltaTime);
-        cout << "A key pressed" << endl;
-    }
+    double cpuMilliseconds = (glfwGetTime() - gBenchmark.caseStartTime) * 1000.0;
+    cout << "Benchmark [" << gBenchmarkCases[gBenchmark.caseIndex].name << "]: "
+         << gBenchmark.gpuMilliseconds / BENCHMARK_MEASURED_FRAMES << " ms GPU, "
+         << cpuMilliseconds / BENCHMARK_MEASURED_FRAMES << " ms frame" << endl;
 
-    // D Key Pressed - Move camera right
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-        gCamera.ProcessKeyboard(RIGHT, gDeltaTime);
-        cout << "D key pressed" << endl;
-    }
+    gBenchmark.frame = 0;
+    gBenchmark.gpuMilliseconds = 0.0;
 
-    // S Key Pressed - Move camera backward
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
-        gCamera.ProcessKeyboard(UP, gDeltaTime);
-        cout << "Q key pressed" << endl;
+    if (++gBenchmark.caseIndex < gBenchmarkCases.size()) {
+        gBenchmarkCases[gBenchmark.caseIndex].apply();
     }
-
-    // S Key Pressed - Move camera backward
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
-        gCamera.ProcessKeyboard(DOWN, gDeltaTime);
-        cout << "E key pressed" << endl;
+    else {
+        glDeleteQueries(1, &gBenchmark.timerQuery);
+        URequestClose(gRenderThread);
     }
+}
+
+// Compares decoding the texture corpus through stdio (stbi_load) against memory-mapped files
+// (stbi_load_from_memory), and times the header-only probe, printing one line per file
+void UBenchmarkImageLoading()
+{
+    typedef chrono::high_resolution_clock Clock;
+    auto milliseconds = [](Clock::duration d) { return chrono::duration<double, milli>(d).count(); };
+
+    cout << "Image loading benchmark: " << LOADING_BENCHMARK_ITERATIONS << " iterations per file" << endl;
+    cout << "file, bytes, stdio ms, mmap ms, probe ms, stdio MB/s, mmap MB/s" << endl;
 
-    // Z Key Pressed - Lower camera speed
-    if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS) {
-        if (gCamera.MovementSpeed > 0.01f) {
-            gCamera.MovementSpeed -= 0.01f;
-            cout << "Camera Speed: " << gCamera.MovementSpeed << endl;
+    for (const char* name : TEXTURE_FILES) {
+        string filename = string(TEXTURE_DIRECTORY) + name;
+
+        MappedFile file;
+        if (!UMapFile(filename.c_str(), file)) {
+            cout << name << ": failed to open" << endl;
+            continue;
         }
-        else {
-            gCamera.MovementSpeed = 0.01f;
+        size_t bytes = file.size;
+        UUnmapFile(file);
+
+        double stdioTime = 0.0, mmapTime = 0.0, probeTime = 0.0;
+        int width, height, channels;
+        bool isMapped = true;
+
+        for (int i = 0; i < LOADING_BENCHMARK_ITERATIONS; ++i) {
+            Clock::time_point start = Clock::now();
+            unsigned char* image = stbi_load(filename.c_str(), &width, &height, &channels, 0);
+            stdioTime += milliseconds(Clock::now() - start);
+            stbi_image_free(image);
+
+            start = Clock::now();
+            isMapped = UMapFile(filename.c_str(), file);
+            if (!isMapped)
+                break;
+            image = stbi_load_from_memory(file.data, (int)file.size, &width, &height, &channels, 0);
+            UUnmapFile(file);
+            mmapTime += milliseconds(Clock::now() - start);
+            stbi_image_free(image);
+
+            start = Clock::now();
+            isMapped = UMapFile(filename.c_str(), file);
+            if (!isMapped)
+                break;
+            stbi_info_from_memory(file.data, (int)file.size, &width, &height, &channels);
+            UUnmapFile(file);
+            probeTime += milliseconds(Clock::now() - start);
         }
-    }
 
-    // C Key Pressed - Higher camera speed
-    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
-        if (gCamera.MovementSpeed < 10.0f) {
-            gCamera.MovementSpeed += 0.01f;
-            cout << "Camera Speed: " << gCamera.MovementSpeed << endl;
-        }
-        else {
-            gCamera.MovementSpeed = 10.0f;
+        // A failed map would time decoding an empty buffer, so the file gets no row rather than a wrong one
+        if (!isMapped) {
+            cout << name << ": failed to map" << endl;
+            continue;
         }
+
+        stdioTime /= LOADING_BENCHMARK_ITERATIONS;
+        mmapTime /= LOADING_BENCHMARK_ITERATIONS;
+        probeTime /= LOADING_BENCHMARK_ITERATIONS;
+
+        // Throughput in decoded megabytes per second
+        double decodedMegabytes = (double)width * height * channels / (1024.0 * 1024.0);
+        cout << name << ", " << bytes << ", " << stdioTime << ", " << mmapTime << ", " << probeTime << ", "
+             << decodedMegabytes / (stdioTime / 1000.0) << ", " << decodedMegabytes / (mmapTime / 1000.0) << endl;
     }
+}
 
-    // X Key Pressed - Reset camera speed
-    if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS) {
-        gCamera.MovementSpeed = 2.5f;
-        cout << "Camera Speed Reset: " << gCamera.MovementSpeed << endl;
+// Times building, casting rays through and refitting the picking hierarchy over
+// PICKING_BENCHMARK_OBJECTS randomly placed cartons, and checks a sample of the picks
+// against testing every carton
+void UBenchmarkPicking()
+{
+    typedef chrono::high_resolution_clock Clock;
+    auto milliseconds = [](Clock::duration d) { return chrono::duration<double, milli>(d).count(); };
+
+    default_random_engine random(44);
+    uniform_real_distribution<float> position(-100.0f, 100.0f);
+    uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+    uniform_real_distribution<float> size(0.5f, 2.0f);
+
+    PickMesh carton = UMakePickMesh(&cartonVerts[0], 7, &cartonIndices[0], (int)cartonIndices.size());
+    vector<glm::mat4> models(PICKING_BENCHMARK_OBJECTS);
+    vector<PickBox> boxes(PICKING_BENCHMARK_OBJECTS);
+    for (int i = 0; i < PICKING_BENCHMARK_OBJECTS; ++i) {
+        glm::vec3 axis = glm::normalize(glm::vec3(position(random), position(random), position(random)));
+        models[i] = glm::translate(glm::vec3(position(random), position(random), position(random))) * glm::rotate(angle(random), axis) * glm::scale(glm::vec3(size(random)));
+        boxes[i] = UTransformPickBox(carton.bounds, models[i]);
     }
+    auto test = [&](int object, const PickRay& ray, float maxDistance, float& distance) {
+        return UIntersectPickMesh(carton, models[object], ray, maxDistance, distance);
+    };
 
-    // X Key Pressed - Reset camera speed
-    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
-        // Reset camera  
-        gCamera = cameraPerspective;
-    }   
+    PickBvh bvh;
+    Clock::time_point start = Clock::now();
+    UBuildPickBvh(bvh, boxes);
+    double buildTime = milliseconds(Clock::now() - start);
 
-    // X Key Pressed - Reset camera speed
-    if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS) {
-        // Reset camera  
-        gCamera = cameraOrtho;
+    // Rays from inside and around the scattered cartons in random directions
+    vector<PickRay> rays;
+    for (int i = 0; i < PICKING_BENCHMARK_RAYS; ++i) {
+        glm::vec3 origin = glm::vec3(position(random), position(random), position(random)) * 1.5f;
+        rays.push_back(UMakePickRay(origin, glm::normalize(glm::vec3(position(random), position(random), position(random)))));
     }
 
-    if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS && gTexWrapMode != GL_REPEAT)
-    {
-        glBindTexture(GL_TEXTURE_2D, gTextureId);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glBindTexture(GL_TEXTURE_2D, 0);
+    double totalTime = 0.0, worstTime = 0.0;
+    int hits = 0;
+    vector<PickHit> picks;
+    for (const PickRay& ray : rays) {
+        start = Clock::now();
+        PickHit hit = UCastPickRay(bvh, ray, test);
+        double time = milliseconds(Clock::now() - start);
+        totalTime += time;
+        worstTime = max(worstTime, time);
+        hits += hit.object >= 0 ? 1 : 0;
+        picks.push_back(hit);
+    }
 
-        gTexWrapMode = GL_REPEAT;
+    // Testing every carton is slow, so only the first few rays are checked
+    int mismatches = 0;
+    for (int r = 0; r < 20; ++r) {
+        PickHit expected = { -1, FLT_MAX };
+        float distance;
+        for (int i = 0; i < PICKING_BENCHMARK_OBJECTS; ++i) {
+            if (test(i, rays[r], expected.distance, distance) && distance < expected.distance)
+                expected = { i, distance };
+        }
+        mismatches += expected.object != picks[r].object ? 1 : 0;
+    }
 
-        cout << "Current Texture Wrapping Mode: REPEAT" << endl;
+    // Move a tenth of the cartons a short way, as a frame of animation would
+    start = Clock::now();
+    int moved = PICKING_BENCHMARK_OBJECTS / 10;
+    for (int i = 0; i < moved; ++i) {
+        int object = i * 10;
+        models[object] = glm::translate(glm::vec3(position(random), position(random), position(random)) * 0.01f) * models[object];
+        URefitPickBvh(bvh, object, UTransformPickBox(carton.bounds, models[object]));
     }
-    else if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS && gTexWrapMode != GL_MIRRORED_REPEAT)
-    {
-        glBindTexture(GL_TEXTURE_2D, gTextureId);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
-        glBindTexture(GL_TEXTURE_2D, 0);
+    double refitTime = milliseconds(Clock::now() - start);
 
-        gTexWrapMode = GL_MIRRORED_REPEAT;
+    cout << "Picking benchmark: " << PICKING_BENCHMARK_OBJECTS << " objects, " << PICKING_BENCHMARK_RAYS << " rays" << endl;
+    cout << "nodes, build ms, pick avg ms, pick max ms, hits, mismatches, refit ms per 10%, needs rebuild" << endl;
+    cout << bvh.nodes.size() << ", " << buildTime << ", " << totalTime / PICKING_BENCHMARK_RAYS << ", " << worstTime << ", "
+         << hits << ", " << mismatches << ", " << refitTime << ", " << (UPickBvhNeedsRebuild(bvh) ? "yes" : "no") << endl;
+}
 
-        cout << "Current Texture Wrapping Mode: MIRRORED REPEAT" << endl;
-    }
-    else if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS && gTexWrapMode != GL_CLAMP_TO_EDGE)
+// Times stb_image's decoder kernels (C, SSE2 and AVX2 where the CPU has them) on synthetic
+// data, and checks every SIMD variant writes exactly what the C version does
+void UBenchmarkImageKernels()
+{
+    typedef chrono::high_resolution_clock Clock;
+
+    // Inputs and output of one kernel call. Row kernels work on 1024 pixel rows, the
+    // IDCT on the 64 blocks of a 64x64 tile
+    struct KernelBuffers
     {
-        glBindTexture(GL_TEXTURE_2D, gTextureId);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        STBI_SIMD_ALIGN(short, coefficients[64 * 64]);
+        stbi_uc y[1024], cb[1024], cr[1024];   // Also the near/far rows for upsampling
+        stbi_uc raw[4096], prior[4 + 4096];    // PNG scanline and the one above it, with its left neighbour
+        stbi_uc out[4 + 4096];                 // 4 leading bytes are the PNG left neighbour
+    };
+
+    struct KernelVariant
+    {
+        const char* kernel;
+        const char* variant;
+        bool isAvailable;
+        size_t outputBytes;
+        void (*run)(KernelBuffers& b);
+    };
 
-        gTexWrapMode = GL_CLAMP_TO_EDGE;
+    const KernelVariant variants[] = {
+        { "idct", "c", true, 4096, [](KernelBuffers& b) { for (int i = 0; i < 64; ++i) stbi__idct_block(b.out + (i / 8) * 512 + (i % 8) * 8, 64, b.coefficients + i * 64); } },
+#ifdef STBI_SSE2
+        { "idct", "sse2", stbi__sse2_available() != 0, 4096, [](KernelBuffers& b) { for (int i = 0; i < 64; ++i) stbi__idct_simd(b.out + (i / 8) * 512 + (i % 8) * 8, 64, b.coefficients + i * 64); } },
+#endif
+#ifdef STBI_AVX2
+        { "idct", "avx2", stbi__avx2_available() != 0, 4096, [](KernelBuffers& b) { for (int i = 0; i < 64; ++i) stbi__idct_avx2(b.out + (i / 8) * 512 + (i % 8) * 8, 64, b.coefficients + i * 64); } },
+#endif
+        { "ycbcr_to_rgba", "c", true, 4096, [](KernelBuffers& b) { stbi__YCbCr_to_RGB_row(b.out, b.y, b.cb, b.cr, 1024, 4); } },
+#ifdef STBI_SSE2
+        { "ycbcr_to_rgba", "sse2", stbi__sse2_available() != 0, 4096, [](KernelBuffers& b) { stbi__YCbCr_to_RGB_simd(b.out, b.y, b.cb, b.cr, 1024, 4); } },
+#endif
+#ifdef STBI_AVX2
+        { "ycbcr_to_rgba", "avx2", stbi__avx2_available() != 0, 4096, [](KernelBuffers& b) { stbi__YCbCr_to_RGB_avx2(b.out, b.y, b.cb, b.cr, 1024, 4); } },
+#endif
+        { "resample_hv_2", "c", true, 2048, [](KernelBuffers& b) { stbi__resample_row_hv_2(b.out, b.y, b.cb, 1023, 2); } },
+#ifdef STBI_SSE2
+        { "resample_hv_2", "sse2", stbi__sse2_available() != 0, 2048, [](KernelBuffers& b) { stbi__resample_row_hv_2_simd(b.out, b.y, b.cb, 1023, 2); } },
+#endif
+#ifdef STBI_AVX2
+        { "resample_hv_2", "avx2", stbi__avx2_available() != 0, 2048, [](KernelBuffers& b) { stbi__resample_row_hv_2_avx2(b.out, b.y, b.cb, 1023, 2); } },
+#endif
+        { "png_up", "c", true, 4096, [](KernelBuffers& b) { stbi__png_unfilter_row(b.out + 4, b.raw, b.prior + 4, 4092, STBI__F_up, 4); } },
+#ifdef STBI_SSE2
+        { "png_up", "sse2", stbi__sse2_available() != 0, 4096, [](KernelBuffers& b) { stbi__png_unfilter_row_simd(b.out + 4, b.raw, b.prior + 4, 4092, STBI__F_up, 4); } },
+#endif
+#ifdef STBI_AVX2
+        { "png_up", "avx2", stbi__avx2_available() != 0, 4096, [](KernelBuffers& b) { stbi__png_unfilter_row_avx2(b.out + 4, b.raw, b.prior + 4, 4092, STBI__F_up, 4); } },
+#endif
+        { "png_sub_rgba", "c", true, 4096, [](KernelBuffers& b) { stbi__png_unfilter_row(b.out + 4, b.raw, b.prior + 4, 4092, STBI__F_sub, 4); } },
+#ifdef STBI_AVX2
+        { "png_sub_rgba", "avx2", stbi__avx2_available() != 0, 4096, [](KernelBuffers& b) { stbi__png_unfilter_row_avx2(b.out + 4, b.raw, b.prior + 4, 4092, STBI__F_sub, 4); } },
+#endif
+        { "png_avg_rgba", "c", true, 4096, [](KernelBuffers& b) { stbi__png_unfilter_row(b.out + 4, b.raw, b.prior + 4, 4092, STBI__F_avg, 4); } },
+#ifdef STBI_SSE2
+        { "png_avg_rgba", "sse2", stbi__sse2_available() != 0, 4096, [](KernelBuffers& b) { stbi__png_unfilter_row_simd(b.out + 4, b.raw, b.prior + 4, 4092, STBI__F_avg, 4); } },
+#endif
+        { "png_paeth_rgba", "c", true, 4096, [](KernelBuffers& b) { stbi__png_unfilter_row(b.out + 4, b.raw, b.prior + 4, 4092, STBI__F_paeth, 4); } },
+#ifdef STBI_SSE2
+        { "png_paeth_rgba", "sse2", stbi__sse2_available() != 0, 4096, [](KernelBuffers& b) { stbi__png_unfilter_row_simd(b.out + 4, b.raw, b.prior + 4, 4092, STBI__F_paeth, 4); } },
+#endif
+        { "png_paeth_rgb", "c", true, 4096, [](KernelBuffers& b) { stbi__png_unfilter_row(b.out + 4, b.raw, b.prior + 4, 4092, STBI__F_paeth, 3); } },
+#ifdef STBI_SSE2
+        { "png_paeth_rgb", "sse2", stbi__sse2_available() != 0, 4096, [](KernelBuffers& b) { stbi__png_unfilter_row_simd(b.out + 4, b.raw, b.prior + 4, 4092, STBI__F_paeth, 3); } },
+#endif
+    };
 
-        cout << "Current Texture Wrapping Mode: CLAMP TO EDGE" << endl;
+    static KernelBuffers buffers;
+    default_random_engine eng(1234);
+    uniform_int_distribution<int> byteDistr(0, 255), coefficientDistr(-256, 255);
+    for (short& c : buffers.coefficients) c = (short)coefficientDistr(eng);
+    for (int i = 0; i < 1024; ++i) {
+        buffers.y[i] = (stbi_uc)byteDistr(eng);
+        buffers.cb[i] = (stbi_uc)byteDistr(eng);
+        buffers.cr[i] = (stbi_uc)byteDistr(eng);
     }
-    else if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS && gTexWrapMode != GL_CLAMP_TO_BORDER)
-    {
-        float color[] = { 1.0f, 0.0f, 1.0f, 1.0f };
-        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, color);
+    for (int i = 0; i < 4096; ++i) {
+        buffers.raw[i] = (stbi_uc)byteDistr(eng);
+        buffers.prior[i] = (stbi_uc)byteDistr(eng);
+    }
+    for (int i = 4096; i < 4 + 4096; ++i)
+        buffers.prior[i] = (stbi_uc)byteDistr(eng);
 
-        glBindTexture(GL_TEXTURE_2D, gTextureId);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-        glBindTexture(GL_TEXTURE_2D, 0);
+    cout << "Decoder kernel benchmark: " << KERNEL_BENCHMARK_ITERATIONS << " calls per variant" << endl;
+    cout << "kernel, variant, ns per call, output MB/s, matches c" << endl;
 
-        gTexWrapMode = GL_CLAMP_TO_BORDER;
+    // Output of the C variant of the current kernel, which the SIMD variants are checked against
+    stbi_uc reference[sizeof(buffers.out)];
+
+    for (const KernelVariant& v : variants) {
+        if (!v.isAvailable) {
+            cout << v.kernel << ", " << v.variant << ", unsupported" << endl;
+            continue;
+        }
 
-        cout << "Current Texture Wrapping Mode: CLAMP TO BORDER" << endl;
+        memset(buffers.out, 0, sizeof(buffers.out));
+        v.run(buffers);
+        bool isReference = string(v.variant) == "c";
+        if (isReference)
+            memcpy(reference, buffers.out, sizeof(reference));
+        bool matches = memcmp(reference, buffers.out, sizeof(reference)) == 0;
+
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < KERNEL_BENCHMARK_ITERATIONS; ++i)
+            v.run(buffers);
+        double nanoseconds = chrono::duration<double, nano>(Clock::now() - start).count() / KERNEL_BENCHMARK_ITERATIONS;
+
+        cout << v.kernel << ", " << v.variant << ", " << nanoseconds << ", "
+             << v.outputBytes / (1024.0 * 1024.0) / (nanoseconds * 1e-9) << ", " << (matches ? "yes" : "no") << endl;
     }
+}
+
+// Initialize GLFW, GLEW, and create a window
+bool UInitialize(int argc, char* argv[], GLFWwindow** window)
+{
+    // GLFW: initialize and configure
+    // ------------------------------
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS)
+    // GLFW: window creation
+    // ---------------------
+    * window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE, NULL, NULL);
+    if (*window == NULL)
     {
-        gUVScale += 0.1f;
-        cout << "Current scale (" << gUVScale[0] << ", " << gUVScale[1] << ")" << endl;
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return false;
     }
-    else if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS)
+    glfwMakeContextCurrent(*window);
+    glfwSetFramebufferSizeCallback(*window, UResizeWindow);
+    glfwSetCursorPosCallback(*window, UMousePositionCallback);
+    glfwSetScrollCallback(*window, UMouseScrollCallback);
+    glfwSetMouseButtonCallback(*window, UMouseButtonCallback);
+    glfwSetKeyCallback(*window, UKeyCallback);
+    UResetInputQueue(gInputQueue);
+    UCreateInputMap(gInputMap, INPUT_BINDINGS, sizeof(INPUT_BINDINGS) / sizeof(INPUT_BINDINGS[0]));
+
+    // tell GLFW to capture our mouse
+    glfwSetInputMode(*window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+    // GLEW: initialize
+    // ----------------
+    // Note: if using GLEW version 1.13 or earlier
+    glewExperimental = GL_TRUE;
+    GLenum GlewInitResult = glewInit();
+
+    if (GLEW_OK != GlewInitResult)
     {
-        gUVScale -= 0.1f;
-        cout << "Current scale (" << gUVScale[0] << ", " << gUVScale[1] << ")" << endl;
+        std::cerr << glewGetErrorString(GlewInitResult) << std::endl;
+        return false;
     }
 
-    // Pause and resume lamp orbiting
-    static bool isLKeyDown = false;
-    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && !gIsLampOrbiting)
+    // Displays GPU OpenGL version
+    cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << endl;
+
+    return true;
+}
+
+// process all input: dispatch the events queued since the last frame, then act on the keys held during it
+void UProcessInput()
+{
+    UDispatchInputEvents(gInputQueue, gInputMap, glfwGetTimerValue(),
+        [](int action, bool isPressed, const InputEvent&) {
+            if (isPressed)
+                UHandleAction(action);
+        },
+        [](double xpos, double ypos) { ULookAround(xpos, ypos); },
+        [](double, double yoffset) { gCamera.ProcessMouseScroll((float)yoffset); });
+
+    // Only the actions held at some point this frame are visited
+    for (int i = 0; i < gInputMap.heldCount; ++i) {
+        int action = gInputMap.heldActions[i];
+        float seconds = (float)UInputHeldSeconds(gInputMap, action);
+        if (seconds > 0.0f)
+            UHandleHeldAction(action, seconds);
+    }
+}
+
+// Actions that happen once, when their key or button is pressed
+void UHandleAction(int action)
+{
+    switch (action) {
+    // Escape Key Pressed - Escape the window
+    case ACTION_QUIT:
+        URequestClose(gRenderThread);
+        break;
+
+    // X Key Pressed - Reset camera speed
+    case ACTION_SPEED_RESET:
+        gCamera.MovementSpeed = 2.5f;
+        LOG_INFO("Camera Speed Reset: {}", gCamera.MovementSpeed);
+        break;
+
+    // P and O Keys Pressed - Reset camera
+    case ACTION_CAMERA_PERSPECTIVE:
+        gCamera = cameraPerspective;
+        break;
+    case ACTION_CAMERA_ORTHO:
+        gCamera = cameraOrtho;
+        break;
+
+    // 1 to 4 Keys Pressed - Texture wrapping modes
+    case ACTION_WRAP_REPEAT:
+        USetTextureWrapMode(GL_REPEAT);
+        LOG_INFO("Current Texture Wrapping Mode: REPEAT");
+        break;
+    case ACTION_WRAP_MIRRORED_REPEAT:
+        USetTextureWrapMode(GL_MIRRORED_REPEAT);
+        LOG_INFO("Current Texture Wrapping Mode: MIRRORED REPEAT");
+        break;
+    case ACTION_WRAP_CLAMP_TO_EDGE:
+        USetTextureWrapMode(GL_CLAMP_TO_EDGE);
+        LOG_INFO("Current Texture Wrapping Mode: CLAMP TO EDGE");
+        break;
+    case ACTION_WRAP_CLAMP_TO_BORDER:
+        USetTextureWrapMode(GL_CLAMP_TO_BORDER);
+        LOG_INFO("Current Texture Wrapping Mode: CLAMP TO BORDER");
+        break;
+
+    // L and K Keys Pressed - Resume and pause lamp orbiting
+    case ACTION_LAMP_RESUME:
         gIsLampOrbiting = true;
-    else if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS && gIsLampOrbiting)
+        break;
+    case ACTION_LAMP_PAUSE:
         gIsLampOrbiting = false;
+        break;
+
+    // F1 Key Pressed - Toggle shadows
+    case ACTION_TOGGLE_SHADOWS:
+        gShadowsEnabled = !gShadowsEnabled;
+        LOG_INFO("Shadows: {}", gShadowsEnabled ? "ON" : "OFF");
+        break;
+
+    // F2 Key Pressed - Toggle the directional light and its cascaded shadows
+    case ACTION_TOGGLE_DIR_LIGHT:
+        gDirLightEnabled = !gDirLightEnabled;
+        LOG_INFO("Directional Light: {}", gDirLightEnabled ? "ON" : "OFF");
+        break;
+
+    // F3 Key Pressed - Toggle the depth pre-pass
+    case ACTION_TOGGLE_DEPTH_PREPASS:
+        gDepthPrepassEnabled = !gDepthPrepassEnabled;
+        LOG_INFO("Depth Pre-pass: {}", gDepthPrepassEnabled ? "ON" : "OFF");
+        break;
+
+    // F4 Key Pressed - Toggle the overdraw heatmap
+    case ACTION_TOGGLE_OVERDRAW:
+        gOverdrawEnabled = !gOverdrawEnabled;
+        gOverdraw.framesSinceReport = 0;
+        LOG_INFO("Overdraw View: {}", gOverdrawEnabled ? "ON" : "OFF");
+        break;
+
+    // F5 Key Pressed - Toggle the virtual textured carton label; the page file is built on first use
+    case ACTION_TOGGLE_VIRTUAL_TEXTURE:
+        if (!gVirtualTextureLoaded)
+            gVirtualTextureLoaded = UCreateVirtualTexture();
+
+        if (gVirtualTextureLoaded) {
+            gVirtualTextureEnabled = !gVirtualTextureEnabled;
+            UUploadInstanceLayers();
+            LOG_INFO("Virtual Texture: {}", gVirtualTextureEnabled ? "ON" : "OFF");
+        }
+        else {
+            LOG_ERROR("Failed to create the virtual texture");
+        }
+        break;
+
+    // F6 Key Pressed - Cycle the frame pacing modes, reporting the latency of the one being left
+    case ACTION_CYCLE_FRAME_PACING: {
+        double averageLatency, worstLatency;
+        if (UReportFrameLatency(gFramePacer, averageLatency, worstLatency))
+            LOG_INFO("Input to present latency: {} ms average, {} ms worst", averageLatency, worstLatency);
+
+        FramePacingMode previous = gFramePacer.mode;
+        FramePacingMode mode = USetFramePacingMode(gFramePacer, (FramePacingMode)((previous + 1) % FRAME_PACING_MODE_COUNT));
+        if (mode == previous) // Adaptive vsync is not supported and fell back to the vsync being left
+            mode = USetFramePacingMode(gFramePacer, (FramePacingMode)((mode + 2) % FRAME_PACING_MODE_COUNT));
+        if (mode == FRAME_PACING_TARGET_FPS)
+            LOG_INFO("Frame Pacing: {} {}", UFramePacingModeName(mode), gFramePacer.targetFps);
+        else
+            LOG_INFO("Frame Pacing: {}", UFramePacingModeName(mode));
+        break;
+    }
+
+    // Left Mouse Button Pressed - Pick the object under the cursor
+    case ACTION_PICK:
+        UPickSceneObject();
+        break;
+
+    default:
+        break;
+    }
+}
+
+// Actions that continue while their key is held, for the part of the frame it was held
+void UHandleHeldAction(int action, float seconds)
+{
+    switch (action) {
+    // W, S, A, D, Q and E Keys Held - Move the camera
+    case ACTION_MOVE_FORWARD:
+        gCamera.ProcessKeyboard(FORWARD, seconds);
+        LOG_DEBUG_THROTTLED("Moving forward");
+        break;
+    case ACTION_MOVE_BACKWARD:
+        gCamera.ProcessKeyboard(BACKWARD, seconds);
+        LOG_DEBUG_THROTTLED("Moving backward");
+        break;
+    case ACTION_MOVE_LEFT:
+        gCamera.ProcessKeyboard(LEFT, seconds);
+        LOG_DEBUG_THROTTLED("Moving left");
+        break;
+    case ACTION_MOVE_RIGHT:
+        gCamera.ProcessKeyboard(RIGHT, seconds);
+        LOG_DEBUG_THROTTLED("Moving right");
+        break;
+    case ACTION_MOVE_UP:
+        gCamera.ProcessKeyboard(UP, seconds);
+        LOG_DEBUG_THROTTLED("Moving up");
+        break;
+    case ACTION_MOVE_DOWN:
+        gCamera.ProcessKeyboard(DOWN, seconds);
+        LOG_DEBUG_THROTTLED("Moving down");
+        break;
+
+    // Z and C Keys Held - Lower and raise camera speed
+    case ACTION_SPEED_DOWN:
+        gCamera.MovementSpeed = max(0.01f, gCamera.MovementSpeed - CAMERA_SPEED_CHANGE * seconds);
+        LOG_INFO_THROTTLED("Camera Speed: {}", gCamera.MovementSpeed);
+        break;
+    case ACTION_SPEED_UP:
+        gCamera.MovementSpeed = min(10.0f, gCamera.MovementSpeed + CAMERA_SPEED_CHANGE * seconds);
+        LOG_INFO_THROTTLED("Camera Speed: {}", gCamera.MovementSpeed);
+        break;
+
+    // ] and [ Keys Held - Scale texture coordinates
+    case ACTION_UV_SCALE_UP:
+        gUVScale += UV_SCALE_CHANGE * seconds;
+        LOG_INFO_THROTTLED("Current scale ({}, {})", gUVScale[0], gUVScale[1]);
+        break;
+    case ACTION_UV_SCALE_DOWN:
+        gUVScale -= UV_SCALE_CHANGE * seconds;
+        LOG_INFO_THROTTLED("Current scale ({}, {})", gUVScale[0], gUVScale[1]);
+        break;
+
+    default:
+        break;
+    }
 }
 
-// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes.
+// It runs on the event thread, so the render thread applies the new viewport at its next frame.
 void UResizeWindow(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    UPostFramebufferSize(gRenderThread, width, height);
 }
 
-// glfw: whenever the mouse moves, this callback is called
-// -------------------------------------------------------
-void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos)
+// Turns the camera by the cursor's movement since its last position
+void ULookAround(double xpos, double ypos)
 {
     if (gFirstMouse)
     {
@@ -705,63 +1746,240 @@ void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos)
     gCamera.ProcessMouseMovement(xoffset, yoffset);
 }
 
-// glfw: whenever the mouse scroll wheel scrolls, this callback is called
-// ----------------------------------------------------------------------
+// glfw: the input callbacks only queue their events for UProcessInput
+// --------------------------------------------------------------------
+void UKeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    UPushInputEvent(gInputQueue, INPUT_EVENT_KEY, key, action, 0.0, 0.0);
+}
+
+void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos)
+{
+    UPushInputEvent(gInputQueue, INPUT_EVENT_CURSOR, 0, 0, xpos, ypos);
+}
+
 void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
 {
-    gCamera.ProcessMouseScroll(yoffset);
+    UPushInputEvent(gInputQueue, INPUT_EVENT_SCROLL, 0, 0, xoffset, yoffset);
 }
 
-// glfw: handle mouse button events
-// --------------------------------
 void UMouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
 {
-    switch (button) {
-    case GLFW_MOUSE_BUTTON_LEFT: {
-        if (action == GLFW_PRESS) {
-            cout << "Left mouse button pressed" << endl;
-        }
-        else {
-            cout << "Left mouse button released" << endl;
-        }
-        break;
+    UPushInputEvent(gInputQueue, INPUT_EVENT_MOUSE_BUTTON, button, action, 0.0, 0.0);
+}
+
+// Places the scenery; the static model matrices never change so they are composed at compile time,
+// and the cap's is recomposed every frame from the parts kept in gCapPlacement and gCapShape
+void UCreateScene()
+{
+    // Scale, rotation, and translation for carton model matrix
+    // 1. Scales the object by 2
+    static constexpr StaticTransform cartonScale = UStaticScale(0.7f, 0.7f, 0.7f);
+    // 2. Rotates shape by 40 degrees in the x axis
+    static constexpr StaticTransform cartonRotation = UStaticRotate(15.2f, 0.0f, 1.0f, 0.0f);
+    // 3. Place object at the origin
+    static constexpr StaticTransform cartonTranslation = UStaticTranslate(0.5f, 3.0f, -4.0f);
+
+    // Scale, rotation, and translation for cap model matrix
+    // 1. Scales the object
+    static constexpr StaticTransform cartonCapScale = UStaticScale(0.4f, 0.4f, 0.4f);
+    // 2. Rotates shape
+    static constexpr StaticTransform cartonCapRotation = UStaticRotate(15.26f, 0.1f, 1.0f, -0.6f);
+    // 3. Place object at the origin
+    static constexpr StaticTransform cartonCapTranslation = UStaticTranslate(0.21f, 2.75f, -3.5f);
+    
+    // Scale, rotation, and translation for table triangle 1 model matrix
+    // 1. Scales the object by 2
+    static constexpr StaticTransform tableScale = UStaticScale(575.5f, 35.4f, 20.2f);
+    // 2. Rotates shape
+    static constexpr StaticTransform tableRotation = UStaticRotate(1.57f, 1.0f, 0.0f, 0.0f);
+    // 3. Place object
+    static constexpr StaticTransform tableTranslation = UStaticTranslate(-2.7f, -0.77f, -0.75f);
+
+    // Scale, rotation, and translation for table triangle 2 model matrix
+    // 1. Scales the object
+    static constexpr StaticTransform tableScale2 = UStaticScale(575.5f, 35.4f, 20.2f);
+    // 2. Rotates shapes
+    static constexpr StaticTransform tableRotation2 = UStaticRotate(-1.57f, 1.0f, 0.0f, 0.0f);
+    // 3. Place object
+    static constexpr StaticTransform tableTranslation2 = UStaticTranslate(-2.7f, 3.25f, -7.9f);
+
+    // Model matrix: transformations are applied right-to-left order; the products are read-only data
+    static constexpr StaticTransform cartonModel = cartonTranslation * cartonRotation * cartonScale;
+    static constexpr StaticTransform cartonCapModel = cartonCapTranslation * cartonCapRotation * cartonCapScale;
+    static constexpr StaticTransform tableModel = tableTranslation * tableRotation * tableScale;
+    static constexpr StaticTransform tableModel2 = tableTranslation2 * tableRotation2 * tableScale2;
+
+    // The tables are drawn with the cap's vertex array, as they always have been. Every loaded texture is
+    // sampled by some object: the milk and smiley layers share the 1024 array, the bandana has the 512 one
+    gSceneObjects.clear();
+    gSceneObjects.push_back({ cartonMesh.vao, cartonMesh.depthVao, (GLsizei)cartonIndices.size(), UToMat4(cartonModel), true, gMilkTexture, true, 0 });
+    gSceneObjects.push_back({ cartonCapMesh.vao, cartonCapMesh.depthVao, (GLsizei)cartonCapIndices.size(), UToMat4(cartonCapModel), false, gBandanaTexture, false, 1 });
+    gSceneObjects.push_back({ cartonCapMesh.vao, cartonCapMesh.depthVao, (GLsizei)gMesh.nIndices, UToMat4(tableModel), true, gSmileyTexture, false, 2 });
+    gSceneObjects.push_back({ cartonCapMesh.vao, cartonCapMesh.depthVao, (GLsizei)gMesh.nIndices, UToMat4(tableModel2), true, gSmileyTexture, false, 2 });
+
+    gCapObject = 1;
+    gCapPlacement = UToMat4(cartonCapTranslation);
+    gCapShape = UToMat4(cartonCapRotation * cartonCapScale);
+
+    // Picking tests the same vertices and indices each object is drawn with
+    const int floatsPerVertex = 7;
+    gPickMeshes.clear();
+    gPickMeshes.push_back(UMakePickMesh(&cartonVerts[0], floatsPerVertex, &cartonIndices[0], (int)cartonIndices.size()));
+    gPickMeshes.push_back(UMakePickMesh(&cartonCapVerts[0], floatsPerVertex, &cartonCapIndices[0], (int)cartonCapIndices.size()));
+    gPickMeshes.push_back(UMakePickMesh(&cartonCapVerts[0], floatsPerVertex, &cartonCapIndices[0], min((int)gMesh.nIndices, (int)cartonCapIndices.size())));
+
+    vector<PickBox> pickBoxes;
+    for (const SceneObject& object : gSceneObjects)
+        pickBoxes.push_back(UTransformPickBox(gPickMeshes[object.pickMesh].bounds, object.model));
+    UBuildPickBvh(gPickBvh, pickBoxes);
+
+    // One texture layer per object; the object's index is passed as base instance so a divisor 1
+    // attribute fetches its layer, and instanced or multi-draw batches can span textures
+    glDeleteBuffers(1, &gInstanceLayerVbo);
+    glGenBuffers(1, &gInstanceLayerVbo);
+    UUploadInstanceLayers();
+
+    glBindBuffer(GL_ARRAY_BUFFER, gInstanceLayerVbo);
+    for (const SceneObject& object : gSceneObjects) {
+        glBindVertexArray(object.vao);
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 0, 0);
+        glVertexAttribDivisor(3, 1);
+        glEnableVertexAttribArray(3);
     }
-    case GLFW_MOUSE_BUTTON_MIDDLE: {
-        if (action == GLFW_PRESS) {
-            cout << "Middle mouse button pressed" << endl;
-        }
-        else {
-            cout << "Middle mouse button released" << endl;
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Refits the picking hierarchy to the objects that can move, and rebuilds it once refits have degraded it
+void UUpdatePickBvh()
+{
+    bool isRefit = false;
+    for (size_t i = 0; i < gSceneObjects.size(); ++i) {
+        const SceneObject& object = gSceneObjects[i];
+        if (!object.isStatic) {
+            URefitPickBvh(gPickBvh, (int)i, UTransformPickBox(gPickMeshes[object.pickMesh].bounds, object.model));
+            isRefit = true;
         }
-        break;
     }
-    case GLFW_MOUSE_BUTTON_RIGHT: {
-        if (action == GLFW_PRESS) {
-            cout << "Right mouse button pressed" << endl;
+
+    if (isRefit && UPickBvhNeedsRebuild(gPickBvh)) {
+        vector<PickBox> pickBoxes = gPickBvh.objectBoxes;
+        UBuildPickBvh(gPickBvh, pickBoxes);
+    }
+}
+
+// Casts a ray through the center of the window and reports the closest scene object it hits. The
+// cursor stays captured for the camera, so the center is where the camera looks.
+void UPickSceneObject()
+{
+    double x = WINDOW_WIDTH / 2.0;
+    double y = WINDOW_HEIGHT / 2.0;
+
+    // Same projection as the main pass
+    glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
+    PickRay ray = UCursorPickRay(x, y, WINDOW_WIDTH, WINDOW_HEIGHT, gCamera.GetViewMatrix(), projection);
+
+    PickHit hit = UCastPickRay(gPickBvh, ray, [](int object, const PickRay& ray, float maxDistance, float& distance) {
+        const SceneObject& sceneObject = gSceneObjects[object];
+        return UIntersectPickMesh(gPickMeshes[sceneObject.pickMesh], sceneObject.model, ray, maxDistance, distance);
+    });
+
+    if (hit.object >= 0)
+        LOG_INFO("Picked scene object {} at distance {}", hit.object, hit.distance);
+    else
+        LOG_INFO("Nothing picked");
+}
+
+// Writes each scene object's texture layer into the per-instance buffer; -1 selects the virtual texture
+void UUploadInstanceLayers()
+{
+    vector<GLfloat> layers;
+    for (const SceneObject& object : gSceneObjects)
+        layers.push_back(gVirtualTextureEnabled && object.hasVirtualTexture ? -1.0f : (GLfloat)object.texture.layer);
+
+    glBindBuffer(GL_ARRAY_BUFFER, gInstanceLayerVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * layers.size(), &layers[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Draws the static and/or dynamic scene objects with the currently bound program.
+// Depth-only passes use the position-only stream to fetch a third of the vertex data.
+// Shaded passes bind each object's texture array on unit 0, only when it changes.
+void UDrawSceneObjects(GLint modelLoc, bool staticObjects, bool dynamicObjects, bool positionOnly)
+{
+    GLuint boundVao = 0;
+    int boundArray = -1;
+
+    for (size_t i = 0; i < gSceneObjects.size(); ++i) {
+        const SceneObject& object = gSceneObjects[i];
+        if ((object.isStatic && !staticObjects) || (!object.isStatic && !dynamicObjects))
+            continue;
+
+        // Activate the VBOs contained within the mesh's VAO
+        GLuint vao = positionOnly ? object.depthVao : object.vao;
+        if (vao != boundVao) {
+            glBindVertexArray(vao);
+            boundVao = vao;
         }
-        else {
-            cout << "Right mouse button released" << endl;
+
+        if (!positionOnly && object.texture.array != boundArray) {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, gTextureArrays[object.texture.array].id);
+            boundArray = object.texture.array;
         }
-        break;
+
+        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(object.model));
+
+        // Base instance selects the object's entry in the per-instance layer buffer
+        glDrawElementsInstancedBaseInstance(GL_TRIANGLES, object.nIndices, GL_UNSIGNED_SHORT, NULL, 1, (GLuint)i);
     }
+}
 
-    default:
-        cout << "Unhandled mouse button event" << endl;
-        break;
+// Advances everything that animates by one fixed simulation step
+void USimulateStep(double seconds)
+{
+    // Lamp orbits around the origin
+    gPreviousLampAngle = gLampAngle;
+    if (gIsLampOrbiting)
+        gLampAngle += LAMP_ANGULAR_VELOCITY * seconds;
+
+    // Wrap both angles together, so the angle stays small and interpolation between them is unchanged
+    if (gLampAngle >= glm::two_pi<double>()) {
+        gLampAngle -= glm::two_pi<double>();
+        gPreviousLampAngle -= glm::two_pi<double>();
+    }
+
+    // Cap spins in place
+    gPreviousCapAngle = gCapAngle;
+    if (gIsCapSpinning)
+        gCapAngle += CAP_ANGULAR_VELOCITY * seconds;
+
+    if (gCapAngle >= glm::two_pi<double>()) {
+        gCapAngle -= glm::two_pi<double>();
+        gPreviousCapAngle -= glm::two_pi<double>();
     }
 }
 
 // Functioned called to render a frame
 void URender()
 {
-    // Lamp orbits around the origin
-    const float angularVelocity = glm::radians(45.0f);
-    if (gIsLampOrbiting) {
-        glm::vec4 newPosition = glm::rotate(angularVelocity * gDeltaTime, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::vec4(gLightPosition, 1.0f);
-        gLightPosition.x = newPosition.x;
-        gLightPosition.y = newPosition.y;
-        gLightPosition.z = newPosition.z;
-    }
+    // Lamp is drawn between its last two simulated positions
+    float lampAngle = (float)glm::mix(gPreviousLampAngle, gLampAngle, USimulationAlpha(gSimulationClock));
+    gLightPosition = glm::vec3(glm::rotate(lampAngle, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::vec4(LAMP_ORBIT_START, 1.0f));
+
+    // So is the cap
+    float capAngle = (float)glm::mix(gPreviousCapAngle, gCapAngle, USimulationAlpha(gSimulationClock));
+    gSceneObjects[gCapObject].model = gCapPlacement * glm::rotate(capAngle, glm::vec3(0.0f, 1.0f, 0.0f)) * gCapShape;
+
+    glm::mat4 view = gCamera.GetViewMatrix();
+
+    // Keep picking in step with objects that moved this frame
+    UUpdatePickBvh();
+
+    // Update the shadow maps before the main pass samples them
+    if (gShadowsEnabled)
+        URenderShadowMaps(view);
 
    // Enable z-depth
     glEnable(GL_DEPTH_TEST);
@@ -775,59 +1993,36 @@ void URender()
     // Set the shader to be used
     glUseProgram(gProgramId);
 
-    // Scale, rotation, and translation for carton model matrix
-    // 1. Scales the object by 2
-    glm::mat4 cartonScale = glm::scale(glm::vec3(0.7f, 0.7f, 0.7f));
-    // 2. Rotates shape by 40 degrees in the x axis
-    glm::mat4 cartonRotation = glm::rotate(15.2f, glm::vec3(0.0, 1.0f, 0.0f));
-    // 3. Place object at the origin
-    glm::mat4 cartonTranslation = glm::translate(glm::vec3(0.5f, 3.0f, -4.0f));
-
-    // Scale, rotation, and translation for cap model matrix
-    // 1. Scales the object
-    glm::mat4 cartonCapScale = glm::scale(glm::vec3(0.4f, 0.4f, 0.4f));
-    // 2. Rotates shape
-    glm::mat4 cartonCapRotation = glm::rotate(15.26f, glm::vec3(0.1f, 1.0f, -0.6f));
-    // 3. Place object at the origin
-    glm::mat4 cartonCapTranslation = glm::translate(glm::vec3(0.21f, 2.75f, -3.5f));
-    
-    // Scale, rotation, and translation for table triangle 1 model matrix
-    // 1. Scales the object by 2
-    glm::mat4 tableScale = glm::scale(glm::vec3(575.5f, 35.4f, 20.2f));
-    // 2. Rotates shape
-    glm::mat4 tableRotation = glm::rotate(1.57f, glm::vec3(1.0, 0.0f, 0.0f));
-    // 3. Place object
-    glm::mat4 tableTranslation = glm::translate(glm::vec3(-2.7f, -0.77f, -0.75f));
-
-    // Scale, rotation, and translation for table triangle 2 model matrix
-    // 1. Scales the object
-    glm::mat4 tableScale2 = glm::scale(glm::vec3(575.5f, 35.4f, 20.2f));
-    // 2. Rotates shapes
-    glm::mat4 tableRotation2 = glm::rotate(-1.57f, glm::vec3(1.0, 0.0f, 0.0f));
-    // 3. Place object
-    glm::mat4 tableTranslation2 = glm::translate(glm::vec3(-2.7f, 3.25f, -7.9f));
-
-    // Model matrix: transformations are applied right-to-left order
-    glm::mat4 cartonModel = cartonTranslation * cartonRotation * cartonScale;
-    glm::mat4 cartonCapModel = cartonCapTranslation * cartonCapRotation * cartonCapScale;
-    glm::mat4 tableModel = tableTranslation * tableRotation * tableScale;
-    glm::mat4 tableModel2 = tableTranslation2 * tableRotation2 * tableScale2;
-
     // Model matrix: transformations are applied right-to-left order
     glm::mat4 model = glm::translate(gCubePosition) * glm::scale(gCubeScale);
 
-    glm::mat4 view = gCamera.GetViewMatrix();
-
     // Create a perspective projection
     glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
 
+    // Request the virtual texture tiles this view needs and copy in the ones that have streamed in
+    if (gVirtualTextureEnabled) {
+        URenderVirtualTextureFeedback(view, projection);
+        UUpdateVirtualTexture();
+        glUseProgram(gProgramId);
+    }
+
+    // Debug view replaces the shaded scene with a fragment count heatmap
+    if (gOverdrawEnabled) {
+        URenderOverdraw(view, projection);
+        glfwSwapBuffers(gWindow);
+        return;
+    }
+
+    if (gDepthPrepassEnabled) {
+        URenderDepthPrepass(view, projection);
+        glUseProgram(gProgramId);
+    }
+
     // Retrieves and passes transform matrices to the Shader program
     GLint modelLoc = glGetUniformLocation(gProgramId, "model");
     GLint viewLoc = glGetUniformLocation(gProgramId, "view");
     GLint projLoc = glGetUniformLocation(gProgramId, "projection");
 
-    // Draws the carton
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(cartonModel));
     glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
     glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection)); 
 
@@ -850,32 +2045,47 @@ void URender()
 
     glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gUVScale));
 
-    // bind textures on corresponding texture units
-    glActiveTexture(GL_TEXTURE0);
-
-    glBindTexture(GL_TEXTURE_2D, gTextureId);
-
-    // Activate the VBOs contained within the mesh's VAO
-    glBindVertexArray(cartonMesh.vao);
-
-    glDrawElements(GL_TRIANGLES, cartonIndices.size(), GL_UNSIGNED_SHORT, NULL); // Draws the triangle
-
-    // Activate the VBOs contained within the mesh's VAO
-    glBindVertexArray(cartonCapMesh.vao);
-
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(cartonCapModel));
+    // Pass the shadow maps and the matrices they were rendered with
+    bool hasDynamicCasters = false;
+    for (const SceneObject& object : gSceneObjects)
+        hasDynamicCasters = hasDynamicCasters || !object.isStatic;
+
+    glUniform1i(glGetUniformLocation(gProgramId, "shadowsEnabled"), gShadowsEnabled);
+    glUniform1i(glGetUniformLocation(gProgramId, "dirLightEnabled"), gDirLightEnabled);
+    glUniform3fv(glGetUniformLocation(gProgramId, "dirLightDirection"), 1, glm::value_ptr(gDirLightDirection));
+    glUniform3fv(glGetUniformLocation(gProgramId, "dirLightColor"), 1, glm::value_ptr(gDirLightColor));
+    glUniform3fv(glGetUniformLocation(gProgramId, "pointShadowLightPos"), 1, glm::value_ptr(gPointShadow.lightPos));
+    glUniform1f(glGetUniformLocation(gProgramId, "pointShadowFar"), POINT_SHADOW_FAR);
+    glUniformMatrix4fv(glGetUniformLocation(gProgramId, "cascadeMatrices"), CASCADE_COUNT, GL_FALSE, glm::value_ptr(gCascadeShadow.lightSpace[0]));
+    glUniform1fv(glGetUniformLocation(gProgramId, "cascadeSplits"), CASCADE_COUNT, gCascadeShadow.splits);
+
+    // Sample the composited maps only when dynamic casters were drawn into them
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, hasDynamicCasters ? gPointShadow.cube : gPointShadow.staticCube);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, hasDynamicCasters ? gCascadeShadow.array : gCascadeShadow.staticArray);
+
+    if (gVirtualTextureEnabled) {
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, gVirtualTextureView.cacheTexture);
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_2D, gVirtualTextureView.indirectionTexture);
+    }
 
-    glDrawElements(GL_TRIANGLES, cartonCapIndices.size(), GL_UNSIGNED_SHORT, NULL); // Draws the triangle
-    
-    // Draws the table 1
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(tableModel));
+    // Texture arrays are bound on unit 0 by UDrawSceneObjects
+    glActiveTexture(GL_TEXTURE0);
 
-    glDrawElements(GL_TRIANGLES, gMesh.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle
+    // With depth already laid down, only the visible surface passes GL_EQUAL and gets shaded
+    if (gDepthPrepassEnabled) {
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
 
-     // Draws the table 2
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(tableModel2));
+    // Draws the carton, cap and tables
+    UDrawSceneObjects(modelLoc, true, true, false);
 
-    glDrawElements(GL_TRIANGLES, gMesh.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle   
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
 
     // Set the shader to be used
     glUseProgram(gLampProgramId);
@@ -903,6 +2113,542 @@ void URender()
     glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
 }
 
+// Depth-only pass over the scene: position-only vertex stream, empty fragment shader, no color writes
+void URenderDepthPrepass(const glm::mat4& view, const glm::mat4& projection)
+{
+    glUseProgram(gDepthProgramId);
+
+    glUniformMatrix4fv(glGetUniformLocation(gDepthProgramId, "view"), 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(glGetUniformLocation(gDepthProgramId, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthFunc(GL_LESS);
+
+    UDrawSceneObjects(glGetUniformLocation(gDepthProgramId, "model"), true, true, true);
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+// Renders the scene with the same depth state as the main pass, counting every fragment shader
+// invocation per pixel, then draws the counts as a heatmap
+void URenderOverdraw(const glm::mat4& view, const glm::mat4& projection)
+{
+    int width = gFramebufferWidth;
+    int height = gFramebufferHeight;
+
+    // A minimized window has a 0x0 framebuffer: there is nothing to count, and no image can be that size
+    if (width <= 0 || height <= 0)
+        return;
+
+    // (Re)allocate the counter image to match the framebuffer
+    if (gOverdraw.counterTexture == 0 || gOverdraw.width != width || gOverdraw.height != height) {
+        glDeleteTextures(1, &gOverdraw.counterTexture);
+        glGenTextures(1, &gOverdraw.counterTexture);
+        glBindTexture(GL_TEXTURE_2D, gOverdraw.counterTexture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32UI, width, height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        gOverdraw.width = width;
+        gOverdraw.height = height;
+    }
+
+    GLuint zero = 0;
+    glClearTexImage(gOverdraw.counterTexture, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    glBindImageTexture(0, gOverdraw.counterTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+
+    // Mirror the main pass: with the pre-pass only fragments matching the stored depth run
+    if (gDepthPrepassEnabled) {
+        URenderDepthPrepass(view, projection);
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
+    glUseProgram(gOverdraw.countProgramId);
+    glUniformMatrix4fv(glGetUniformLocation(gOverdraw.countProgramId, "view"), 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(glGetUniformLocation(gOverdraw.countProgramId, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    UDrawSceneObjects(glGetUniformLocation(gOverdraw.countProgramId, "model"), true, true, true);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+
+    // Make the atomic counts visible to the heatmap pass
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(gOverdraw.heatmapProgramId);
+    glUniform1f(glGetUniformLocation(gOverdraw.heatmapProgramId, "maxCount"), 8.0f);
+    glBindVertexArray(gMesh.vao); // Core profile needs a vertex array bound even without attributes
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glEnable(GL_DEPTH_TEST);
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    if (++gOverdraw.framesSinceReport >= OVERDRAW_REPORT_FRAMES) {
+        UReportOverdraw();
+        gOverdraw.framesSinceReport = 0;
+    }
+}
+
+// Reads the counter image back and prints total fragments shaded against pixels covered
+void UReportOverdraw()
+{
+    vector<GLuint> counts((size_t)gOverdraw.width * gOverdraw.height);
+
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    glBindTexture(GL_TEXTURE_2D, gOverdraw.counterTexture);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &counts[0]);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    unsigned long long fragments = 0;
+    unsigned long long covered = 0;
+    GLuint maxCount = 0;
+    for (GLuint count : counts) {
+        fragments += count;
+        covered += count > 0;
+        maxCount = max(maxCount, count);
+    }
+
+    LOG_INFO("Overdraw: {} fragments shaded, {} pixels covered ({}x average, {} max)",
+             fragments, covered, covered ? (double)fragments / covered : 0.0, maxCount);
+}
+
+// Opens the carton label's page file, building it from the source image first if it is missing or
+// unreadable, and creates the fixed-size tile cache and the indirection table
+bool UCreateVirtualTexture()
+{
+    string sourceFilename = string(TEXTURE_DIRECTORY) + VT_SOURCE_FILE;
+    string pageFilename = sourceFilename + ".vtpages";
+
+    if (!UOpenVirtualTexture(gVirtualTexture, pageFilename.c_str(), VT_CACHE_SLOTS)) {
+        MappedFile file;
+        if (!UMapFile(sourceFilename.c_str(), file))
+            return false;
+
+        int width, height, channels;
+        unsigned char* image = stbi_load_from_memory(file.data, (int)file.size, &width, &height, &channels, 4);
+        UUnmapFile(file);
+        if (!image)
+            return false;
+
+        UPostDecodeImage(image, width, height, 4, image, UDefaultPostDecodeOptions(4));
+
+        LOG_INFO("Building virtual texture page file {}", pageFilename);
+        bool isBuilt = UBuildVirtualTexturePageFile(image, width, height, pageFilename.c_str());
+        stbi_image_free(image);
+
+        if (!isBuilt || !UOpenVirtualTexture(gVirtualTexture, pageFilename.c_str(), VT_CACHE_SLOTS))
+            return false;
+    }
+
+    const VirtualTexture& vt = gVirtualTexture;
+    const int cacheSize = VT_CACHE_SLOTS * VT_TILE_SIZE;
+
+    // Tiles carry their own borders, so bilinear filtering inside a tile never needs its neighbours
+    glGenTextures(1, &gVirtualTextureView.cacheTexture);
+    glBindTexture(GL_TEXTURE_2D, gVirtualTextureView.cacheTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, cacheSize, cacheSize);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenTextures(1, &gVirtualTextureView.indirectionTexture);
+    glBindTexture(GL_TEXTURE_2D, gVirtualTextureView.indirectionTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8UI, vt.indirectionWidth, vt.indirectionHeight);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenBuffers(2, gVirtualTextureView.feedbackPbos);
+
+    if (!UCreateShaderProgram(vertexShaderSource, feedbackFragmentShaderSource, gVirtualTextureView.feedbackProgramId))
+        return false;
+
+    // Page file constants are shared by the main and feedback programs
+    GLuint programs[] = { gProgramId, gVirtualTextureView.feedbackProgramId };
+    for (GLuint program : programs) {
+        glUseProgram(program);
+        glUniform2f(glGetUniformLocation(program, "vtSize"), (GLfloat)vt.header.width, (GLfloat)vt.header.height);
+        glUniform1i(glGetUniformLocation(program, "vtMipCount"), (GLint)vt.header.mipCount);
+        glUniform1f(glGetUniformLocation(program, "vtTileSize"), (GLfloat)VT_TILE_SIZE);
+        glUniform1f(glGetUniformLocation(program, "vtTileBorder"), (GLfloat)VT_TILE_BORDER);
+    }
+
+    glUseProgram(gVirtualTextureView.feedbackProgramId);
+    glUniform1f(glGetUniformLocation(gVirtualTextureView.feedbackProgramId, "vtLodBias"), -log2f((float)VT_FEEDBACK_DIVISOR));
+
+    glUseProgram(gProgramId);
+    glUniform1iv(glGetUniformLocation(gProgramId, "vtMipRowOffset"), (GLsizei)vt.header.mipCount, vt.mipRowOffset);
+    glUniform1f(glGetUniformLocation(gProgramId, "vtCacheSize"), (GLfloat)cacheSize);
+    glUniform1i(glGetUniformLocation(gProgramId, "vtCache"), 3); // Tile cache on texture unit 3
+    glUniform1i(glGetUniformLocation(gProgramId, "vtIndirection"), 4); // Indirection table on texture unit 4
+    glUseProgram(0);
+
+    return true;
+}
+
+void UDestroyVirtualTexture()
+{
+    if (!gVirtualTextureLoaded)
+        return;
+
+    UCloseVirtualTexture(gVirtualTexture);
+
+    glDeleteTextures(1, &gVirtualTextureView.cacheTexture);
+    glDeleteTextures(1, &gVirtualTextureView.indirectionTexture);
+    glDeleteTextures(1, &gVirtualTextureView.feedbackTexture);
+    glDeleteRenderbuffers(1, &gVirtualTextureView.feedbackDepth);
+    glDeleteFramebuffers(1, &gVirtualTextureView.feedbackFbo);
+    glDeleteBuffers(2, gVirtualTextureView.feedbackPbos);
+    UDestroyShaderProgram(gVirtualTextureView.feedbackProgramId);
+
+    gVirtualTextureLoaded = false;
+}
+
+// Renders the tile ids the view needs into a small buffer and reads them back through a pair of PBOs:
+// this frame's ids are copied asynchronously while last frame's are mapped and turned into requests
+void URenderVirtualTextureFeedback(const glm::mat4& view, const glm::mat4& projection)
+{
+    VirtualTextureView& vtView = gVirtualTextureView;
+
+    int width = max(1, gFramebufferWidth / VT_FEEDBACK_DIVISOR);
+    int height = max(1, gFramebufferHeight / VT_FEEDBACK_DIVISOR);
+
+    // (Re)allocate the feedback buffer to follow the framebuffer
+    if (vtView.feedbackFbo == 0 || vtView.feedbackWidth != width || vtView.feedbackHeight != height) {
+        glDeleteTextures(1, &vtView.feedbackTexture);
+        glDeleteRenderbuffers(1, &vtView.feedbackDepth);
+        glDeleteFramebuffers(1, &vtView.feedbackFbo);
+
+        glGenTextures(1, &vtView.feedbackTexture);
+        glBindTexture(GL_TEXTURE_2D, vtView.feedbackTexture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32UI, width, height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenRenderbuffers(1, &vtView.feedbackDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, vtView.feedbackDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &vtView.feedbackFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, vtView.feedbackFbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, vtView.feedbackTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, vtView.feedbackDepth);
+
+        for (GLuint pbo : vtView.feedbackPbos) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+            glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(GLuint) * width * height, nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        vtView.feedbackWidth = width;
+        vtView.feedbackHeight = height;
+        vtView.feedbackFrame = 0;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, vtView.feedbackFbo);
+    glViewport(0, 0, width, height);
+
+    const GLuint noTile[] = { VT_NO_TILE, 0, 0, 0 };
+    glClearBufferuiv(GL_COLOR, 0, noTile);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    glUseProgram(vtView.feedbackProgramId);
+    glUniformMatrix4fv(glGetUniformLocation(vtView.feedbackProgramId, "view"), 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(glGetUniformLocation(vtView.feedbackProgramId, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    glUniform2fv(glGetUniformLocation(vtView.feedbackProgramId, "uvScale"), 1, glm::value_ptr(gUVScale));
+
+    UDrawSceneObjects(glGetUniformLocation(vtView.feedbackProgramId, "model"), true, true, false);
+
+    // Start this frame's copy, then consume the previous frame's, which has had a frame to complete
+    GLuint writePbo = vtView.feedbackPbos[vtView.feedbackFrame % 2];
+    GLuint readPbo = vtView.feedbackPbos[(vtView.feedbackFrame + 1) % 2];
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, writePbo);
+    glReadPixels(0, 0, width, height, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+
+    if (vtView.feedbackFrame > 0) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readPbo);
+        const GLuint* ids = (const GLuint*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+        if (ids) {
+            vector<unsigned int> tiles(ids, ids + (size_t)width * height);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            URequestVirtualTiles(gVirtualTexture, tiles);
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    ++vtView.feedbackFrame;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, gFramebufferWidth, gFramebufferHeight);
+}
+
+// Copies streamed tiles into their cache slots and uploads the indirection table when residency changed
+void UUpdateVirtualTexture()
+{
+    glBindTexture(GL_TEXTURE_2D, gVirtualTextureView.cacheTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    UResolveVirtualTiles(gVirtualTexture, VT_UPLOADS_PER_FRAME, [](int slot, const unsigned char* pixels) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % VT_CACHE_SLOTS) * VT_TILE_SIZE, (slot / VT_CACHE_SLOTS) * VT_TILE_SIZE,
+                        VT_TILE_SIZE, VT_TILE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    });
+
+    if (gVirtualTexture.isIndirectionDirty) {
+        glBindTexture(GL_TEXTURE_2D, gVirtualTextureView.indirectionTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, gVirtualTexture.indirectionWidth, gVirtualTexture.indirectionHeight,
+                        GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, &gVirtualTexture.indirection[0]);
+        gVirtualTexture.isIndirectionDirty = false;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Allocates the lamp cube maps, the directional cascade arrays and the framebuffer each is rendered through
+bool UCreateShadowMaps()
+{
+    // Lamp: one cube map for the cached static casters and one for the per-frame composite
+    GLuint cubes[2];
+    glGenTextures(2, cubes);
+    for (GLuint cube : cubes) {
+        glBindTexture(GL_TEXTURE_CUBE_MAP, cube);
+        glTexStorage2D(GL_TEXTURE_CUBE_MAP, 1, GL_DEPTH_COMPONENT24, POINT_SHADOW_SIZE, POINT_SHADOW_SIZE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+    gPointShadow.staticCube = cubes[0];
+    gPointShadow.cube = cubes[1];
+    gPointShadow.isValid = false;
+
+    // Directional light: one layer per cascade, sampled with hardware depth comparison
+    GLuint arrays[2];
+    glGenTextures(2, arrays);
+    for (GLuint array : arrays) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT24, CASCADE_SHADOW_SIZE, CASCADE_SHADOW_SIZE, CASCADE_COUNT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+        float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f }; // Outside the cascade counts as lit
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+    }
+    gCascadeShadow.staticArray = arrays[0];
+    gCascadeShadow.array = arrays[1];
+    for (int i = 0; i < CASCADE_COUNT; ++i) {
+        gCascadeShadow.lightSpace[i] = glm::mat4(1.0f);
+        gCascadeShadow.splits[i] = SHADOW_FAR;
+        gCascadeShadow.isValid[i] = false;
+    }
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // Depth-only framebuffers; the attachment is switched per face or layer while rendering
+    glGenFramebuffers(1, &gPointShadow.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, gPointShadow.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X, gPointShadow.staticCube, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    bool isComplete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glGenFramebuffers(1, &gCascadeShadow.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, gCascadeShadow.fbo);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, gCascadeShadow.staticArray, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    isComplete = isComplete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return isComplete;
+}
+
+void UDestroyShadowMaps()
+{
+    glDeleteFramebuffers(1, &gPointShadow.fbo);
+    glDeleteFramebuffers(1, &gCascadeShadow.fbo);
+    glDeleteTextures(1, &gPointShadow.staticCube);
+    glDeleteTextures(1, &gPointShadow.cube);
+    glDeleteTextures(1, &gCascadeShadow.staticArray);
+    glDeleteTextures(1, &gCascadeShadow.array);
+}
+
+// Computes a light view-projection that encloses one slice of the camera frustum.
+// The bounds are a sphere snapped to the shadow map texel grid, so the matrix only
+// changes when the camera moves by at least a texel; that keeps cached layers valid.
+glm::mat4 UComputeCascadeMatrix(const glm::mat4& view, float nearSplit, float farSplit)
+{
+    glm::mat4 sliceProjection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, nearSplit, farSplit);
+    glm::mat4 inverseViewProj = glm::inverse(sliceProjection * view);
+
+    // Frustum slice corners in world space
+    glm::vec3 corners[8];
+    glm::vec3 center(0.0f);
+    for (int i = 0; i < 8; ++i) {
+        glm::vec4 ndc((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f, 1.0f);
+        glm::vec4 world = inverseViewProj * ndc;
+        corners[i] = glm::vec3(world) / world.w;
+        center += corners[i] / 8.0f;
+    }
+
+    float radius = 0.0f;
+    for (int i = 0; i < 8; ++i)
+        radius = glm::max(radius, glm::length(corners[i] - center));
+    radius = ceil(radius * 16.0f) / 16.0f;
+
+    // Rotation-only light view so that the snapped bounds are the only thing that moves
+    glm::vec3 lightDir = glm::normalize(gDirLightDirection);
+    glm::vec3 up = abs(lightDir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), lightDir, up);
+
+    float texelSize = 2.0f * radius / CASCADE_SHADOW_SIZE;
+    glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+    lightCenter.x = floor(lightCenter.x / texelSize) * texelSize;
+    lightCenter.y = floor(lightCenter.y / texelSize) * texelSize;
+    lightCenter.z = floor(lightCenter.z / (radius * 0.25f)) * (radius * 0.25f);
+
+    // Extend the depth range toward the light so casters outside the slice still land in the map
+    const float casterExtent = 20.0f;
+    glm::mat4 lightProjection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius,
+                                           lightCenter.y - radius, lightCenter.y + radius,
+                                           -lightCenter.z - radius - casterExtent, -lightCenter.z + radius);
+
+    return lightProjection * lightView;
+}
+
+// Re-renders only the shadow map contents that changed this frame: the static maps when
+// the light moved past the threshold (or a cascade moved a texel), and the dynamic casters
+// composited on top of the cached static depth every frame.
+void URenderShadowMaps(const glm::mat4& view)
+{
+    bool hasDynamicCasters = false;
+    for (const SceneObject& object : gSceneObjects)
+        hasDynamicCasters = hasDynamicCasters || !object.isStatic;
+
+    glUseProgram(gShadowProgramId);
+
+    GLint modelLoc = glGetUniformLocation(gShadowProgramId, "model");
+    GLint lightSpaceLoc = glGetUniformLocation(gShadowProgramId, "lightSpace");
+    GLint linearDepthLoc = glGetUniformLocation(gShadowProgramId, "linearDepth");
+    GLint lightPosLoc = glGetUniformLocation(gShadowProgramId, "lightPos");
+    GLint farPlaneLoc = glGetUniformLocation(gShadowProgramId, "farPlane");
+
+    glEnable(GL_DEPTH_TEST);
+
+    // Lamp cube map
+    // -------------
+    bool lampMoved = !gPointShadow.isValid || glm::length(gLightPosition - gPointShadow.lightPos) > LIGHT_MOVE_THRESHOLD;
+    if (lampMoved || hasDynamicCasters) {
+        if (lampMoved)
+            gPointShadow.lightPos = gLightPosition;
+
+        // Face directions and up vectors in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+        const glm::vec3 faceDirections[6] = {
+            glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+            glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+            glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+        };
+        const glm::vec3 faceUps[6] = {
+            glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+            glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+            glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+        };
+        glm::mat4 faceProjection = glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_NEAR, POINT_SHADOW_FAR);
+
+        glUniform1i(linearDepthLoc, GL_TRUE);
+        glUniform3fv(lightPosLoc, 1, glm::value_ptr(gPointShadow.lightPos));
+        glUniform1f(farPlaneLoc, POINT_SHADOW_FAR);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, gPointShadow.fbo);
+        glViewport(0, 0, POINT_SHADOW_SIZE, POINT_SHADOW_SIZE);
+
+        // Cached static casters
+        if (lampMoved) {
+            for (int face = 0; face < 6; ++face) {
+                glm::mat4 faceView = glm::lookAt(gPointShadow.lightPos, gPointShadow.lightPos + faceDirections[face], faceUps[face]);
+                glUniformMatrix4fv(lightSpaceLoc, 1, GL_FALSE, glm::value_ptr(faceProjection * faceView));
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, gPointShadow.staticCube, 0);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                UDrawSceneObjects(modelLoc, true, false, true);
+            }
+            gPointShadow.isValid = true;
+        }
+
+        // Dynamic casters on top of a copy of the static depth
+        if (hasDynamicCasters) {
+            glCopyImageSubData(gPointShadow.staticCube, GL_TEXTURE_CUBE_MAP, 0, 0, 0, 0,
+                               gPointShadow.cube, GL_TEXTURE_CUBE_MAP, 0, 0, 0, 0,
+                               POINT_SHADOW_SIZE, POINT_SHADOW_SIZE, 6);
+            for (int face = 0; face < 6; ++face) {
+                glm::mat4 faceView = glm::lookAt(gPointShadow.lightPos, gPointShadow.lightPos + faceDirections[face], faceUps[face]);
+                glUniformMatrix4fv(lightSpaceLoc, 1, GL_FALSE, glm::value_ptr(faceProjection * faceView));
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, gPointShadow.cube, 0);
+                UDrawSceneObjects(modelLoc, false, true, true);
+            }
+        }
+    }
+
+    // Directional light cascades
+    // --------------------------
+    if (gDirLightEnabled) {
+        glUniform1i(linearDepthLoc, GL_FALSE);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, gCascadeShadow.fbo);
+        glViewport(0, 0, CASCADE_SHADOW_SIZE, CASCADE_SHADOW_SIZE);
+
+        // Practical split scheme: blend of logarithmic and uniform splits over the shadowed range
+        const float shadowDistance = 30.0f;
+        const float lambda = 0.75f;
+        float nearSplit = SHADOW_NEAR;
+
+        for (int i = 0; i < CASCADE_COUNT; ++i) {
+            float fraction = (i + 1) / (float)CASCADE_COUNT;
+            float logSplit = SHADOW_NEAR * pow(shadowDistance / SHADOW_NEAR, fraction);
+            float uniformSplit = SHADOW_NEAR + (shadowDistance - SHADOW_NEAR) * fraction;
+            float farSplit = lambda * logSplit + (1.0f - lambda) * uniformSplit;
+
+            glm::mat4 lightSpace = UComputeCascadeMatrix(view, nearSplit, farSplit);
+            gCascadeShadow.splits[i] = farSplit;
+
+            // Cached static casters, only when the snapped cascade bounds changed
+            if (!gCascadeShadow.isValid[i] || lightSpace != gCascadeShadow.lightSpace[i]) {
+                gCascadeShadow.lightSpace[i] = lightSpace;
+                glUniformMatrix4fv(lightSpaceLoc, 1, GL_FALSE, glm::value_ptr(lightSpace));
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, gCascadeShadow.staticArray, 0, i);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                UDrawSceneObjects(modelLoc, true, false, true);
+                gCascadeShadow.isValid[i] = true;
+            }
+
+            // Dynamic casters on top of a copy of the static layer
+            if (hasDynamicCasters) {
+                glCopyImageSubData(gCascadeShadow.staticArray, GL_TEXTURE_2D_ARRAY, 0, 0, 0, i,
+                                   gCascadeShadow.array, GL_TEXTURE_2D_ARRAY, 0, 0, 0, i,
+                                   CASCADE_SHADOW_SIZE, CASCADE_SHADOW_SIZE, 1);
+                glUniformMatrix4fv(lightSpaceLoc, 1, GL_FALSE, glm::value_ptr(gCascadeShadow.lightSpace[i]));
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, gCascadeShadow.array, 0, i);
+                UDrawSceneObjects(modelLoc, false, true, true);
+            }
+
+            nearSplit = farSplit;
+        }
+    }
+
+    // Restore the default framebuffer and viewport
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, gFramebufferWidth, gFramebufferHeight);
+}
+
 void UCreateMesh(GLMesh& mesh) {
     GLfloat verts[] = {
         0.6f, -0.5f, -1.1f,  1.0f, 0.0f, 0.0f, 1.0f, // Back side base vertex 0
@@ -969,58 +2715,234 @@ void UCreateCartonMesh(GLMesh& mesh, vector<GLfloat>& verts, vector <GLushort>&
 
     glVertexAttribPointer(1, floatsPerColor, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * floatsPerVertex));
     glEnableVertexAttribArray(1);
+
+    // Position-only stream for depth passes, sharing the index buffer
+    vector<GLfloat> positions;
+    positions.reserve(verts.size() / (floatsPerVertex + floatsPerColor) * floatsPerVertex);
+    for (size_t i = 0; i + floatsPerVertex <= verts.size(); i += floatsPerVertex + floatsPerColor)
+        positions.insert(positions.end(), verts.begin() + i, verts.begin() + i + floatsPerVertex);
+
+    glGenVertexArrays(1, &mesh.depthVao);
+    glBindVertexArray(mesh.depthVao);
+
+    glGenBuffers(1, &mesh.depthVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.depthVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * positions.size(), &positions[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]);
+
+    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
 }
 
 void UDestroyMesh(GLMesh& mesh)
 {
     glDeleteVertexArrays(1, &mesh.vao);
     glDeleteBuffers(2, mesh.vbos);
+    glDeleteVertexArrays(1, &mesh.depthVao);
+    glDeleteBuffers(1, &mesh.depthVbo);
 }
 
 //Generate and load the texture
-bool UCreateTexture(const char* filename, GLuint& textureId)
+// Smallest power of two bucket that holds the larger side of the image
+int UTextureBucketSize(int width, int height)
 {
+    GLint maxSize = TEXTURE_MAX_BUCKET;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    int limit = min(TEXTURE_MAX_BUCKET, (int)maxSize);
+
+    int bucket = TEXTURE_MIN_BUCKET;
+    while (bucket < max(width, height) && bucket < limit)
+        bucket *= 2;
+    return bucket;
+}
+
+// Decodes an image, resizes it to its size bucket, builds its mips and (where supported) block
+// compresses them, then reserves a layer in the array for that bucket and format. Storage is
+// allocated and the layers uploaded by UBuildTextureArrays.
+bool UAddTextureToArray(const char* filename, TextureLayer& texture)
+{
+    // Decode straight from the page cache rather than through stdio's buffered reads
+    MappedFile file;
+    if (!UMapFile(filename, file))
+        return false;
+
+    // Probe the header first so unusable images are rejected before paying for the decode
     int width, height, channels;
-    unsigned char* image = stbi_load(filename, &width, &height, &channels, 0);
+    if (!stbi_info_from_memory(file.data, (int)file.size, &width, &height, &channels) || width <= 0 || height <= 0) {
+        UUnmapFile(file);
+        return false;
+    }
 
-    if (image) {
-        flipImageVertically(image, width, height, channels);
-        glGenTextures(1, &textureId);
-        glBindTexture(GL_TEXTURE_2D, textureId);
+    unsigned char* image = stbi_load_from_memory(file.data, (int)file.size, &width, &height, &channels, 0);
+    UUnmapFile(file);
 
-        // set the texture wrapping parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    if (!image)
+        return false; // Error loading the image
+
+    // Flip for OpenGL and expand grey / grey-alpha images to RGB / RGBA in one pass
+    PostDecodeOptions options = UDefaultPostDecodeOptions(channels);
+    if (TEXTURE_FORCE_RGBA && options.outputChannels == 3) {
+        options.outputChannels = 4;
+        options.swizzle[3] = -1;
+    }
+
+    if (options.outputChannels != channels) {
+        unsigned char* expanded = (unsigned char*)malloc((size_t)width * height * options.outputChannels);
+        if (!expanded) {
+            stbi_image_free(image);
+            return false;
+        }
+        UPostDecodeImage(image, width, height, channels, expanded, options);
+        stbi_image_free(image);
+        image = expanded;
+        channels = options.outputChannels;
+    }
+    else {
+        UPostDecodeImage(image, width, height, channels, image, options);
+    }
 
-        // set texture filtering parameters
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (channels != 3 && channels != 4) {
+        cout << "Not implemented to handle image with " << channels << "channels" << endl;
+        stbi_image_free(image);
+        return false;
+    }
 
-        if (channels == 3) {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+    // Every layer of an array has the same size, so stretch the image to fill its bucket
+    int size = UTextureBucketSize(width, height);
+    PendingTextureLayer pending;
+    if (width == size && height == size) {
+        MipLevel base = { size, size, vector<unsigned char>(image, image + (size_t)size * size * channels) };
+        pending.levels.push_back(std::move(base));
+    }
+    else {
+        pending.levels.push_back(UResizeImage(image, width, height, channels, size, size, TEXTURE_MIP_FILTER, true));
+    }
+    stbi_image_free(image);
+
+    // Filter the mip chain on the CPU (in linear light)
+    vector<MipLevel> mips = UGenerateMipChain(&pending.levels[0].pixels[0], size, size, channels, TEXTURE_MIP_FILTER, true);
+    for (MipLevel& mip : mips)
+        pending.levels.push_back(std::move(mip));
+
+    // Pick a block compressed format the driver can sample; otherwise keep the uncompressed format
+    bool hasS3tc = GLEW_EXT_texture_compression_s3tc != GL_FALSE;
+    bool hasBptc = GLEW_ARB_texture_compression_bptc != GL_FALSE;
+    bool isCompressed = TEXTURE_COMPRESSION && (hasS3tc || hasBptc);
+    GLenum internalFormat = channels == 3 ? GL_RGB8 : GL_RGBA8;
+    GLenum format = channels == 3 ? GL_RGB : GL_RGBA;
+
+    if (isCompressed) {
+        BcFormat bcFormat;
+        if (hasBptc && (TEXTURE_PREFER_BC7 || !hasS3tc)) {
+            bcFormat = BC_FORMAT_BC7;
+            internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
         }
-        else if (channels == 4) {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+        else if (channels == 3) {
+            bcFormat = BC_FORMAT_BC1;
+            internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
         }
         else {
-            cout << "Not implemented to handle image with " << channels << "channels" << endl;
-            return false;
+            bcFormat = BC_FORMAT_BC3;
+            internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
         }
 
-        glGenerateMipmap(GL_TEXTURE_2D);
+        for (MipLevel& level : pending.levels)
+            level.pixels = UCompressImageBC(&level.pixels[0], level.width, level.height, channels, bcFormat, TEXTURE_BC_QUALITY);
+    }
 
-        stbi_image_free(image);
+    // Reserve the next layer of the array for this bucket and format, adding the array if needed
+    texture.array = -1;
+    for (size_t i = 0; i < gTextureArrays.size(); ++i) {
+        if (gTextureArrays[i].size == size && gTextureArrays[i].internalFormat == internalFormat)
+            texture.array = (int)i;
+    }
+
+    if (texture.array < 0) {
+        gTextureArrays.push_back({ 0, size, internalFormat, format, isCompressed, 0 });
+        texture.array = (int)gTextureArrays.size() - 1;
+    }
+
+    texture.layer = gTextureArrays[texture.array].layerCount++;
+    pending.target = texture;
+    gPendingTextureLayers.push_back(std::move(pending));
 
-        glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+    return true;
+}
+
+// Allocates immutable storage for every texture array and uploads the layers queued by UAddTextureToArray
+void UBuildTextureArrays()
+{
+    // Rows of RGB images are not 4-byte aligned in general
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-        return true;
+    for (TextureArray& textureArray : gTextureArrays) {
+        if (textureArray.id != 0)
+            continue;
+
+        glGenTextures(1, &textureArray.id);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray.id);
+
+        // set the texture wrapping parameters
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, gTexWrapMode);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, gTexWrapMode);
+
+        // set texture filtering parameters: trilinear, plus anisotropic where supported
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        if (GLEW_EXT_texture_filter_anisotropic) {
+            GLfloat maxAnisotropy = 1.0f;
+            glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+            glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, min(TEXTURE_MAX_ANISOTROPY, maxAnisotropy));
+        }
+
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, UMipLevelCount(textureArray.size, textureArray.size), textureArray.internalFormat,
+                       textureArray.size, textureArray.size, textureArray.layerCount);
+    }
+
+    for (const PendingTextureLayer& pending : gPendingTextureLayers) {
+        const TextureArray& textureArray = gTextureArrays[pending.target.array];
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray.id);
+
+        for (size_t level = 0; level < pending.levels.size(); ++level) {
+            const MipLevel& mip = pending.levels[level];
+            if (textureArray.isCompressed)
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, pending.target.layer, mip.width, mip.height, 1,
+                                          textureArray.internalFormat, (GLsizei)mip.pixels.size(), &mip.pixels[0]);
+            else
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, (GLint)level, 0, 0, pending.target.layer, mip.width, mip.height, 1,
+                                textureArray.format, GL_UNSIGNED_BYTE, &mip.pixels[0]);
+        }
     }
-    return false; // Error loading the image
+    gPendingTextureLayers.clear();
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0); // Unbind the texture
+}
+
+void UDestroyTextureArrays()
+{
+    for (TextureArray& textureArray : gTextureArrays)
+        glDeleteTextures(1, &textureArray.id);
+    gTextureArrays.clear();
 }
 
-void UDestroyTexture(GLuint textureId)
+// Applies a wrap mode to every texture array
+void USetTextureWrapMode(GLint wrapMode)
 {
-    glGenTextures(1, &textureId);
+    float color[] = { 1.0f, 0.0f, 1.0f, 1.0f };
+
+    for (const TextureArray& textureArray : gTextureArrays) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray.id);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrapMode);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrapMode);
+        if (wrapMode == GL_CLAMP_TO_BORDER)
+            glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, color);
+    }
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    gTexWrapMode = wrapMode;
 }
 
 // Implements the UCreateShaders function
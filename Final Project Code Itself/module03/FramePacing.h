@@ -0,0 +1,192 @@
+/*
+* FramePacing.h
+
+  Presentation timing for the render loop. The pacer selects the swap
+  interval for vsync, adaptive vsync (late frames tear instead of waiting a
+  whole refresh) or uncapped rendering, or paces frames to a target rate
+  itself. For a target rate it sleeps until shortly before the deadline and
+  spins the rest of the way. The spin margin is the longest recent 1 ms
+  sleep, so it adapts to the OS scheduler's granularity.
+
+  The driver may queue several frames ahead of the GPU, and every queued
+  frame adds to the delay between reading input and showing its result. A
+  fence is inserted after every swap, and the CPU waits on the one from
+  maxQueuedFrames frames back before starting the next frame, so with one
+  frame allowed the GPU draws a frame while the CPU builds the next; with
+  none every frame ends in glFinish. The time from a
+  frame's input being sampled to its fence being seen signaled is recorded
+  as its input-to-present latency.
+*/
+
+#ifndef FRAME_PACING_H
+#define FRAME_PACING_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+enum FramePacingMode
+{
+    FRAME_PACING_VSYNC,
+    FRAME_PACING_ADAPTIVE_VSYNC,    // Falls back to vsync without the swap_control_tear extension
+    FRAME_PACING_UNCAPPED,
+    FRAME_PACING_TARGET_FPS,
+    FRAME_PACING_MODE_COUNT
+};
+
+const int FRAME_PACING_MAX_QUEUED_FRAMES = 3;
+const GLuint64 FRAME_PACING_FENCE_TIMEOUT = 100000000;     // 100 ms in nanoseconds, in case a fence never signals
+
+struct FramePacer
+{
+    FramePacingMode mode;
+    double targetFps;               // Frame rate paced to in FRAME_PACING_TARGET_FPS mode
+    int maxQueuedFrames;            // Swapped frames the GPU may still be drawing when the next starts, 0 to FRAME_PACING_MAX_QUEUED_FRAMES
+    uint64_t frequency;             // glfwGetTimerValue() ticks per second
+    uint64_t nextFrameTime;         // Deadline for the next frame when pacing to targetFps
+    uint64_t sleepTicks;            // Longest recent 1 ms sleep; closer to the deadline than this, the wait spins
+
+    GLsync fences[FRAME_PACING_MAX_QUEUED_FRAMES + 1];     // The frames queued and the one just swapped
+    uint64_t fenceInputTimes[FRAME_PACING_MAX_QUEUED_FRAMES + 1];
+    int nextFence;
+    uint64_t inputTime;             // When this frame's input was sampled
+
+    double latencySum;              // Seconds, since the last report
+    double latencyWorst;
+    int latencyCount;
+};
+
+inline const char* UFramePacingModeName(FramePacingMode mode)
+{
+    switch (mode) {
+    case FRAME_PACING_VSYNC: return "vsync";
+    case FRAME_PACING_ADAPTIVE_VSYNC: return "adaptive vsync";
+    case FRAME_PACING_UNCAPPED: return "uncapped";
+    case FRAME_PACING_TARGET_FPS: return "target fps";
+    default: return "unknown";
+    }
+}
+
+// Sets the swap interval for mode on the current context and returns the mode actually in use
+inline FramePacingMode USetFramePacingMode(FramePacer& pacer, FramePacingMode mode)
+{
+    if (mode == FRAME_PACING_ADAPTIVE_VSYNC &&
+        !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+        mode = FRAME_PACING_VSYNC;
+
+    switch (mode) {
+    case FRAME_PACING_VSYNC: glfwSwapInterval(1); break;
+    case FRAME_PACING_ADAPTIVE_VSYNC: glfwSwapInterval(-1); break;
+    default: glfwSwapInterval(0); break;
+    }
+
+    pacer.mode = mode;
+    pacer.nextFrameTime = glfwGetTimerValue();
+    return mode;
+}
+
+inline FramePacingMode UStartFramePacer(FramePacer& pacer, FramePacingMode mode, double targetFps, int maxQueuedFrames)
+{
+    pacer = FramePacer();
+    pacer.targetFps = targetFps;
+    pacer.maxQueuedFrames = std::max(0, std::min(maxQueuedFrames, FRAME_PACING_MAX_QUEUED_FRAMES));
+    pacer.frequency = glfwGetTimerFrequency();
+    pacer.sleepTicks = pacer.frequency / 500;   // 2 ms until a sleep has been measured
+    pacer.inputTime = glfwGetTimerValue();
+    return USetFramePacingMode(pacer, mode);
+}
+
+inline void UStopFramePacer(FramePacer& pacer)
+{
+    for (GLsync& fence : pacer.fences) {
+        if (fence)
+            glDeleteSync(fence);
+        fence = 0;
+    }
+}
+
+// Waits for the next frame's deadline in target fps mode; returns at once in the others
+inline void UWaitForNextFrame(FramePacer& pacer)
+{
+    if (pacer.mode != FRAME_PACING_TARGET_FPS || pacer.targetFps <= 0.0)
+        return;
+
+    uint64_t period = (uint64_t)(pacer.frequency / pacer.targetFps);
+    uint64_t now = glfwGetTimerValue();
+
+    // More than a frame late: start again from now rather than rushing out frames to catch up
+    if (now > pacer.nextFrameTime + period)
+        pacer.nextFrameTime = now;
+
+    while (now + pacer.sleepTicks < pacer.nextFrameTime) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        uint64_t slept = glfwGetTimerValue() - now;
+        pacer.sleepTicks = std::max(slept, pacer.sleepTicks - pacer.sleepTicks / 64);
+        now += slept;
+    }
+
+    while (now < pacer.nextFrameTime) {
+        std::this_thread::yield();
+        now = glfwGetTimerValue();
+    }
+
+    pacer.nextFrameTime += period;
+}
+
+// Call once the frame's input has been read
+inline void UMarkFrameInput(FramePacer& pacer)
+{
+    pacer.inputTime = glfwGetTimerValue();
+}
+
+inline void URecordFrameLatency(FramePacer& pacer, uint64_t inputTime)
+{
+    double latency = (double)(glfwGetTimerValue() - inputTime) / (double)pacer.frequency;
+    pacer.latencySum += latency;
+    pacer.latencyWorst = std::max(pacer.latencyWorst, latency);
+    ++pacer.latencyCount;
+}
+
+// Call after the buffers are swapped: keeps at most maxQueuedFrames frames queued ahead of the GPU
+inline void UEndFramePacing(FramePacer& pacer)
+{
+    if (pacer.maxQueuedFrames == 0) {
+        glFinish();
+        URecordFrameLatency(pacer, pacer.inputTime);
+        return;
+    }
+
+    int slot = pacer.nextFence;
+    pacer.fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pacer.fenceInputTimes[slot] = pacer.inputTime;
+    pacer.nextFence = (slot + 1) % (pacer.maxQueuedFrames + 1);
+
+    // The ring holds maxQueuedFrames + 1 fences, so the next slot is the frame maxQueuedFrames back
+    GLsync& oldest = pacer.fences[pacer.nextFence];
+    if (oldest) {
+        glClientWaitSync(oldest, GL_SYNC_FLUSH_COMMANDS_BIT, FRAME_PACING_FENCE_TIMEOUT);
+        URecordFrameLatency(pacer, pacer.fenceInputTimes[pacer.nextFence]);
+        glDeleteSync(oldest);
+        oldest = 0;
+    }
+}
+
+// Average and worst latency in milliseconds since the last report; false when no frame has completed
+inline bool UReportFrameLatency(FramePacer& pacer, double& averageMilliseconds, double& worstMilliseconds)
+{
+    if (pacer.latencyCount == 0)
+        return false;
+
+    averageMilliseconds = pacer.latencySum / pacer.latencyCount * 1000.0;
+    worstMilliseconds = pacer.latencyWorst * 1000.0;
+    pacer.latencySum = 0.0;
+    pacer.latencyWorst = 0.0;
+    pacer.latencyCount = 0;
+    return true;
+}
+
+#endif
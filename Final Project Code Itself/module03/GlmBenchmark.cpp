@@ -0,0 +1,618 @@
+/*
+* GlmBenchmark.cpp
+
+  Standalone benchmark of the glm functions the renderer calls every frame:
+  lookAt, perspective, rotate, scale, translate, inverse and the mat4 products
+  that build the model-view-projection matrix. glm picks its code paths at
+  compile time, so this file is built once per configuration (GLM_FORCE_PURE,
+  GLM_FORCE_INTRINSICS, GLM_FORCE_DEFAULT_ALIGNED_GENTYPES, -march) and each
+  build prints one CSV row per function.
+
+  Every function runs over the same pseudo-random inputs in every build, and
+  its results are compared with the same function evaluated in double
+  precision. A row is "ok" when the largest relative error stays within the
+  tolerance, so a configuration that is faster but not equivalent shows up in
+  the table rather than going unnoticed.
+
+  Build and run every configuration with "make glm_benchmark", or one
+  configuration with MSVC from this directory, for example:
+      cl /O2 /EHsc /I..\includes /DGLM_FORCE_PURE GlmBenchmark.cpp
+      cl /O2 /EHsc /arch:AVX2 /I..\includes /DGLM_FORCE_INTRINSICS GlmBenchmark.cpp
+
+  Usage: glm_benchmark [--no-header] [--iterations N] [--check]
+      --no-header   leave out the CSV header, for appending to another run's table
+      --iterations  timed passes over the inputs per function (default 200)
+      --check       instead of timing, check the batched extensions against scalar
+                    glm at every count up to several SIMD widths, so the whole packs
+                    and the leftover elements are both covered, and fastSinCos against
+                    its documented error bounds; "make glm_check"
+                    runs this in the pure, SSE2, AVX2 and AVX2+FMA builds
+  GLM_BENCHMARK_CONFIG names the configuration in the table; without it the
+  name is made up from the instruction set glm was compiled for.
+
+  GLM_FORCE_DEFAULT_ALIGNED_GENTYPES only takes effect when glm also uses SIMD
+  (and, with GCC and Clang, only then are aligned types available at all), so
+  "aligned" in the table reports what glm actually did, not what was asked for.
+*/
+
+#include <iostream>         // cout, cerr
+#include <algorithm>        // max
+#include <chrono>
+#include <cmath>            // fabs
+#include <cstdlib>          // atoi, EXIT_FAILURE
+#include <cstring>          // strcmp
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/ext/matrix_batch.hpp>
+#include <glm/ext/quaternion_batch.hpp>
+#include <glm/gtc/quaternion.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/fast_trigonometry.hpp>
+
+using namespace std;
+
+namespace
+{
+    // Number of distinct inputs each function is run over per pass
+    const size_t INPUT_COUNT = 1024;
+    const int DEFAULT_ITERATIONS = 200;
+
+    // Largest relative error, against the double precision result, still counted as equivalent
+    const double TOLERANCE = 1e-5;
+
+    // Inputs for every function, generated in double precision and rounded to float. The double
+    // precision references are computed from the rounded values, so only glm's own error is measured
+    struct Inputs
+    {
+        vector<glm::vec3> eyes, centers, ups, axes, vectors;
+        vector<float> angles, fovs, aspects, nears, fars;
+        vector<glm::mat4> models, views, projections;
+    };
+
+    struct Result
+    {
+        const char* function;
+        double nsPerOp;
+        double maxError;
+    };
+
+    // Batch functions are checked at every count up to four AVX2 packs and three leftover elements, then
+    // at INPUT_COUNT. One float past each output array's end holds CHECK_GUARD, which must survive the call
+    const size_t CHECK_MAX_TAIL_COUNT = 4 * 8 + 3;
+    const float CHECK_GUARD = -12345.0f;
+
+    // fastSinCos is checked over SINCOS_CHECK_ANGLES angles spread evenly across [-SINCOS_CHECK_RANGE,
+    // SINCOS_CHECK_RANGE], against the largest absolute errors documented in fast_trigonometry.hpp
+    const size_t SINCOS_CHECK_ANGLES = 2 * 1024 * 1024 + 5;
+    const double SINCOS_CHECK_RANGE = 1e4;
+    const double SINCOS_BOUND_LOW = 3.3e-4;
+    const double SINCOS_BOUND_MEDIUM = 1.1e-6;
+    const double SINCOS_BOUND_HIGH = 1e-7;
+
+    struct CheckResult
+    {
+        const char* check;
+        size_t largestCount;    // Counts checked are 0 to CHECK_MAX_TAIL_COUNT and this
+        double maxError;        // Largest error over every count, as defined by the check
+        double bound;
+        bool isGuardIntact;
+    };
+
+    // Structure of arrays storage: one array per component, each with a guard element after the last
+    struct SoaArrays
+    {
+        vector<vector<float>> components;
+
+        SoaArrays(size_t componentCount, size_t count) : components(componentCount, vector<float>(count + 1, CHECK_GUARD)) {}
+        float* operator[](size_t component) { return components[component].data(); }
+
+        glm::soa_vec3 vec3() { return glm::soa_vec3{ (*this)[0], (*this)[1], (*this)[2] }; }
+
+        glm::soa_quat quat() { return glm::soa_quat{ (*this)[0], (*this)[1], (*this)[2], (*this)[3] }; }
+
+        glm::soa_mat3 mat3()
+        {
+            glm::soa_mat3 view;
+            for (size_t c = 0; c < 9; ++c)
+                view.m[c] = (*this)[c];
+            return view;
+        }
+
+        glm::soa_mat4 mat4()
+        {
+            glm::soa_mat4 view;
+            for (size_t c = 0; c < 16; ++c)
+                view.m[c] = (*this)[c];
+            return view;
+        }
+
+        bool isGuardIntact(size_t count) const
+        {
+            for (const vector<float>& component : components)
+                if (component[count] != CHECK_GUARD)
+                    return false;
+            return true;
+        }
+    };
+}
+
+/* Benchmark function prototypes */
+string UConfigName();
+const char* USimdName();
+bool UDefaultAligned();
+Inputs UMakeInputs();
+template <typename FloatCall, typename DoubleCall>
+Result UMeasure(const char* function, int iterations, FloatCall floatCall, DoubleCall doubleCall);
+double URelativeError(const glm::mat4& result, const glm::dmat4& reference);
+vector<Result> URunAll(const Inputs& in, int iterations);
+vector<size_t> UCheckCounts();
+template <int N>
+double URelativeError(const float (&result)[N], const float (&reference)[N]);
+void UCheckMatrixBatch(const Inputs& in, vector<CheckResult>& results);
+void UCheckFastSinCos(vector<CheckResult>& results);
+void UCheckQuaternionBatch(const Inputs& in, vector<CheckResult>& results);
+int UPrintChecks(const vector<CheckResult>& results, bool header);
+
+
+int main(int argc, char* argv[])
+{
+    bool header = true;
+    bool check = false;
+    int iterations = DEFAULT_ITERATIONS;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--no-header") == 0)
+            header = false;
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+            iterations = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--check") == 0)
+            check = true;
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--no-header] [--iterations N] [--check]" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (check)
+    {
+        vector<CheckResult> checks;
+        UCheckMatrixBatch(UMakeInputs(), checks);
+        UCheckFastSinCos(checks);
+        UCheckQuaternionBatch(UMakeInputs(), checks);
+        return UPrintChecks(checks, header);
+    }
+
+    vector<Result> results = URunAll(UMakeInputs(), iterations);
+
+    if (header)
+        cout << "config, glm simd, default aligned, function, ns/op, max relative error, status" << endl;
+
+    bool equivalent = true;
+    string config = UConfigName();
+    for (const Result& result : results)
+    {
+        bool ok = result.maxError <= TOLERANCE;
+        equivalent = equivalent && ok;
+        cout << config << ", " << USimdName() << ", " << (UDefaultAligned() ? "yes" : "no") << ", "
+             << result.function << ", " << result.nsPerOp << ", " << result.maxError << ", "
+             << (ok ? "ok" : "mismatch") << endl;
+    }
+
+    if (!equivalent)
+        cerr << config << ": results differ from double precision by more than " << TOLERANCE << endl;
+
+    return equivalent ? 0 : EXIT_FAILURE;
+}
+
+
+#define GLM_BENCHMARK_STRING(name) #name
+#define GLM_BENCHMARK_NAME(name) GLM_BENCHMARK_STRING(name)
+
+string UConfigName()
+{
+#ifdef GLM_BENCHMARK_CONFIG
+    return GLM_BENCHMARK_NAME(GLM_BENCHMARK_CONFIG);
+#else
+    return string(USimdName()) + (UDefaultAligned() ? "_aligned" : "");
+#endif
+}
+
+
+// The instruction set glm's SIMD code paths were compiled for, or "none" for the scalar code
+const char* USimdName()
+{
+#if GLM_CONFIG_SIMD == GLM_DISABLE
+    return "none";
+#elif GLM_ARCH & GLM_ARCH_AVX2_BIT
+#   if defined(__FMA__) || (GLM_COMPILER & GLM_COMPILER_VC)
+    return "avx2+fma";
+#   else
+    return "avx2";
+#   endif
+#elif GLM_ARCH & GLM_ARCH_AVX_BIT
+    return "avx";
+#elif GLM_ARCH & GLM_ARCH_SSE42_BIT
+    return "sse4.2";
+#elif GLM_ARCH & GLM_ARCH_SSE41_BIT
+    return "sse4.1";
+#elif GLM_ARCH & GLM_ARCH_SSSE3_BIT
+    return "ssse3";
+#elif GLM_ARCH & GLM_ARCH_SSE3_BIT
+    return "sse3";
+#elif GLM_ARCH & GLM_ARCH_SSE2_BIT
+    return "sse2";
+#elif GLM_ARCH & GLM_ARCH_NEON_BIT
+    return "neon";
+#else
+    return "none";
+#endif
+}
+
+
+// Whether glm::mat4 and glm::vec4 use the aligned qualifier, and so the SIMD specializations
+bool UDefaultAligned()
+{
+    return glm::detail::is_aligned<glm::defaultp>::value;
+}
+
+
+// Fixed-seed inputs in the ranges the scene uses, so every build sees the same values
+Inputs UMakeInputs()
+{
+    Inputs in;
+    unsigned int state = 0x2545F491u;
+    auto random = [&state](double low, double high)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return float(low + (high - low) * (state / 4294967295.0));
+    };
+    auto randomVector = [&random](double low, double high)
+    {
+        return glm::vec3(random(low, high), random(low, high), random(low, high));
+    };
+
+    for (size_t i = 0; i < INPUT_COUNT; ++i)
+    {
+        glm::vec3 eye = randomVector(-10.0, 10.0);
+        in.eyes.push_back(eye);
+        in.centers.push_back(eye + randomVector(-1.0, 1.0) + glm::vec3(0.0f, 0.0f, -2.0f));
+        in.ups.push_back(glm::normalize(glm::vec3(0.0f, 1.0f, 0.0f) + randomVector(-0.2, 0.2)));
+        in.axes.push_back(glm::normalize(randomVector(-1.0, 1.0) + glm::vec3(0.0f, 0.1f, 0.0f)));
+        in.vectors.push_back(randomVector(0.25, 4.0));
+        in.angles.push_back(random(-3.14159, 3.14159));
+        in.fovs.push_back(glm::radians(random(30.0, 90.0)));
+        in.aspects.push_back(random(0.5, 2.5));
+        in.nears.push_back(random(0.05, 1.0));
+        in.fars.push_back(random(50.0, 500.0));
+    }
+
+    // Translate, rotate and scale model matrices, camera views and projections, as the renderer builds them
+    for (size_t i = 0; i < INPUT_COUNT; ++i)
+    {
+        glm::dmat4 model = glm::translate(glm::dmat4(1.0), glm::dvec3(randomVector(-10.0, 10.0)));
+        model = glm::rotate(model, double(in.angles[i]), glm::dvec3(in.axes[i]));
+        in.models.push_back(glm::mat4(glm::scale(model, glm::dvec3(in.vectors[i]))));
+        in.views.push_back(glm::mat4(glm::lookAt(glm::dvec3(in.eyes[i]), glm::dvec3(in.centers[i]), glm::dvec3(in.ups[i]))));
+        in.projections.push_back(glm::mat4(glm::perspective(double(in.fovs[i]), double(in.aspects[i]), double(in.nears[i]), double(in.fars[i]))));
+    }
+
+    return in;
+}
+
+
+// Times floatCall over every input, then compares each of its results with doubleCall on the same input
+template <typename FloatCall, typename DoubleCall>
+Result UMeasure(const char* function, int iterations, FloatCall floatCall, DoubleCall doubleCall)
+{
+    vector<glm::mat4> out(INPUT_COUNT);
+    auto pass = [&]()
+    {
+        for (size_t i = 0; i < INPUT_COUNT; ++i)
+            out[i] = floatCall(i);
+    };
+
+    pass();     // warm up caches and the branch predictor
+
+    auto start = chrono::steady_clock::now();
+    for (int iteration = 0; iteration < iterations; ++iteration)
+        pass();
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+
+    Result result;
+    result.function = function;
+    result.nsPerOp = elapsed.count() / (double(iterations) * INPUT_COUNT);
+    result.maxError = 0.0;
+    for (size_t i = 0; i < INPUT_COUNT; ++i)
+        result.maxError = max(result.maxError, URelativeError(out[i], doubleCall(i)));
+    return result;
+}
+
+
+// Largest element difference, relative to the reference matrix's largest element
+double URelativeError(const glm::mat4& result, const glm::dmat4& reference)
+{
+    double scale = 0.0;
+    double error = 0.0;
+    for (int column = 0; column < 4; ++column)
+        for (int row = 0; row < 4; ++row)
+        {
+            scale = max(scale, fabs(reference[column][row]));
+            error = max(error, fabs(double(result[column][row]) - reference[column][row]));
+        }
+    return error / max(scale, 1e-30);
+}
+
+
+vector<Result> URunAll(const Inputs& in, int iterations)
+{
+    typedef glm::dvec3 D3;
+    typedef glm::dmat4 D4;
+    vector<Result> results;
+
+    results.push_back(UMeasure("lookAt", iterations,
+        [&](size_t i) { return glm::lookAt(in.eyes[i], in.centers[i], in.ups[i]); },
+        [&](size_t i) { return glm::lookAt(D3(in.eyes[i]), D3(in.centers[i]), D3(in.ups[i])); }));
+
+    results.push_back(UMeasure("perspective", iterations,
+        [&](size_t i) { return glm::perspective(in.fovs[i], in.aspects[i], in.nears[i], in.fars[i]); },
+        [&](size_t i) { return glm::perspective(double(in.fovs[i]), double(in.aspects[i]), double(in.nears[i]), double(in.fars[i])); }));
+
+    results.push_back(UMeasure("rotate", iterations,
+        [&](size_t i) { return glm::rotate(in.models[i], in.angles[i], in.axes[i]); },
+        [&](size_t i) { return glm::rotate(D4(in.models[i]), double(in.angles[i]), D3(in.axes[i])); }));
+
+    results.push_back(UMeasure("scale", iterations,
+        [&](size_t i) { return glm::scale(in.models[i], in.vectors[i]); },
+        [&](size_t i) { return glm::scale(D4(in.models[i]), D3(in.vectors[i])); }));
+
+    results.push_back(UMeasure("translate", iterations,
+        [&](size_t i) { return glm::translate(in.models[i], in.vectors[i]); },
+        [&](size_t i) { return glm::translate(D4(in.models[i]), D3(in.vectors[i])); }));
+
+    results.push_back(UMeasure("inverse", iterations,
+        [&](size_t i) { return glm::inverse(in.models[i]); },
+        [&](size_t i) { return glm::inverse(D4(in.models[i])); }));
+
+    results.push_back(UMeasure("projection * view * model", iterations,
+        [&](size_t i) { return in.projections[i] * in.views[i] * in.models[i]; },
+        [&](size_t i) { return D4(in.projections[i]) * D4(in.views[i]) * D4(in.models[i]); }));
+
+    return results;
+}
+
+
+// Every count from 0 to CHECK_MAX_TAIL_COUNT, then the whole input set
+vector<size_t> UCheckCounts()
+{
+    vector<size_t> counts;
+    for (size_t count = 0; count <= CHECK_MAX_TAIL_COUNT; ++count)
+        counts.push_back(count);
+    counts.push_back(INPUT_COUNT);
+    return counts;
+}
+
+
+// Largest element difference, relative to the reference's largest element (or 1, for small references)
+template <int N>
+double URelativeError(const float (&result)[N], const float (&reference)[N])
+{
+    double scale = 1.0;
+    double error = 0.0;
+    for (int i = 0; i < N; ++i)
+    {
+        scale = max(scale, fabs(double(reference[i])));
+        error = max(error, fabs(double(result[i]) - double(reference[i])));
+    }
+    return error / scale;
+}
+
+
+// GLM_EXT_matrix_batch against the scalar mat4 and mat3 code it replaces
+void UCheckMatrixBatch(const Inputs& in, vector<CheckResult>& results)
+{
+    CheckResult points = { "transformPoints", INPUT_COUNT, 0.0, TOLERANCE, true };
+    CheckResult pointsInPlace = { "transformPoints in place", INPUT_COUNT, 0.0, TOLERANCE, true };
+    CheckResult products = { "multiplyMatrices", INPUT_COUNT, 0.0, TOLERANCE, true };
+    CheckResult normals = { "normalMatrices", INPUT_COUNT, 0.0, TOLERANCE, true };
+
+    for (size_t count : UCheckCounts())
+    {
+        const glm::mat4& transform = in.models[count % INPUT_COUNT];
+
+        SoaArrays pointsIn(3, count), pointsOut(3, count), pointsInOut(3, count);
+        SoaArrays a(16, count), b(16, count), product(16, count);
+        SoaArrays model(16, count), normal(9, count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (int c = 0; c < 3; ++c)
+                pointsIn[c][i] = pointsInOut[c][i] = in.centers[i][c];
+            glm::setMatrix(a.mat4(), i, in.views[i]);
+            glm::setMatrix(b.mat4(), i, in.models[i]);
+            glm::setMatrix(model.mat4(), i, in.models[i]);
+        }
+
+        glm::transformPoints(transform, pointsIn.vec3(), pointsOut.vec3(), count);
+        glm::transformPoints(transform, pointsInOut.vec3(), pointsInOut.vec3(), count);
+        glm::multiplyMatrices(a.mat4(), b.mat4(), product.mat4(), count);
+        glm::normalMatrices(model.mat4(), normal.mat3(), count);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            glm::vec3 expected = glm::vec3(transform * glm::vec4(in.centers[i], 1.0f));
+            float reference[3] = { expected.x, expected.y, expected.z };
+            float result[3] = { pointsOut[0][i], pointsOut[1][i], pointsOut[2][i] };
+            float resultInPlace[3] = { pointsInOut[0][i], pointsInOut[1][i], pointsInOut[2][i] };
+            points.maxError = max(points.maxError, URelativeError(result, reference));
+            pointsInPlace.maxError = max(pointsInPlace.maxError, URelativeError(resultInPlace, reference));
+
+            glm::mat4 expectedProduct = in.views[i] * in.models[i];
+            glm::mat4 resultProduct = glm::getMatrix(product.mat4(), i);
+            products.maxError = max(products.maxError, URelativeError(reinterpret_cast<const float (&)[16]>(resultProduct[0][0]), reinterpret_cast<const float (&)[16]>(expectedProduct[0][0])));
+
+            glm::mat3 expectedNormal = glm::transpose(glm::inverse(glm::mat3(in.models[i])));
+            glm::mat3 resultNormal = glm::getMatrix(normal.mat3(), i);
+            normals.maxError = max(normals.maxError, URelativeError(reinterpret_cast<const float (&)[9]>(resultNormal[0][0]), reinterpret_cast<const float (&)[9]>(expectedNormal[0][0])));
+        }
+
+        points.isGuardIntact = points.isGuardIntact && pointsOut.isGuardIntact(count);
+        pointsInPlace.isGuardIntact = pointsInPlace.isGuardIntact && pointsInOut.isGuardIntact(count);
+        products.isGuardIntact = products.isGuardIntact && product.isGuardIntact(count);
+        normals.isGuardIntact = normals.isGuardIntact && normal.isGuardIntact(count);
+    }
+
+    results.push_back(points);
+    results.push_back(pointsInPlace);
+    results.push_back(products);
+    results.push_back(normals);
+}
+
+
+// fastSinCos at each accuracy against double precision sin and cos: the whole documented angle range in one call,
+// then every tail count over the first angles
+void UCheckFastSinCos(vector<CheckResult>& results)
+{
+    const struct { const char* check; glm::trig_accuracy accuracy; double bound; } accuracies[] = {
+        { "fastSinCos low", glm::trig_accuracy_low, SINCOS_BOUND_LOW },
+        { "fastSinCos medium", glm::trig_accuracy_medium, SINCOS_BOUND_MEDIUM },
+        { "fastSinCos high", glm::trig_accuracy_high, SINCOS_BOUND_HIGH },
+    };
+
+    vector<float> angles(SINCOS_CHECK_ANGLES);
+    for (size_t i = 0; i < angles.size(); ++i)
+        angles[i] = float(-SINCOS_CHECK_RANGE + 2.0 * SINCOS_CHECK_RANGE * i / (angles.size() - 1));
+
+    vector<size_t> counts = UCheckCounts();
+    counts.push_back(SINCOS_CHECK_ANGLES);
+
+    for (const auto& accuracy : accuracies)
+    {
+        CheckResult result = { accuracy.check, SINCOS_CHECK_ANGLES, 0.0, accuracy.bound, true };
+        for (size_t count : counts)
+        {
+            SoaArrays sinCos(2, count);
+            glm::fastSinCos(angles.data(), sinCos[0], sinCos[1], count, accuracy.accuracy);
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                result.maxError = max(result.maxError, fabs(double(sinCos[0][i]) - sin(double(angles[i]))));
+                result.maxError = max(result.maxError, fabs(double(sinCos[1][i]) - cos(double(angles[i]))));
+            }
+            result.isGuardIntact = result.isGuardIntact && sinCos.isGuardIntact(count);
+        }
+        results.push_back(result);
+    }
+}
+
+
+// GLM_EXT_quaternion_batch against scalar glm::quat. Every third pair is less than a degree apart, where slerp
+// is close to its limit, and every third pair more than 90 degrees apart, where the shorter path flips B
+void UCheckQuaternionBatch(const Inputs& in, vector<CheckResult>& results)
+{
+    CheckResult products = { "multiplyQuaternions", INPUT_COUNT, 0.0, TOLERANCE, true };
+    CheckResult productsInPlace = { "multiplyQuaternions in place", INPUT_COUNT, 0.0, TOLERANCE, true };
+    CheckResult nlerps = { "nlerpQuaternions", INPUT_COUNT, 0.0, TOLERANCE, true };
+    CheckResult slerps = { "slerpQuaternions", INPUT_COUNT, 0.0, TOLERANCE, true };
+    CheckResult matrices = { "rotationMatrices", INPUT_COUNT, 0.0, TOLERANCE, true };
+
+    vector<glm::quat> as, bs;
+    vector<float> factors;
+    for (size_t i = 0; i < INPUT_COUNT; ++i)
+    {
+        glm::quat a = glm::angleAxis(in.angles[i], in.axes[i]);
+        glm::quat b = glm::angleAxis(in.angles[(i + 1) % INPUT_COUNT], in.axes[(i + 1) % INPUT_COUNT]);
+        if (i % 3 == 0)
+            b = glm::normalize(a * glm::angleAxis(glm::radians(in.angles[i] / 4.0f), in.axes[(i + 1) % INPUT_COUNT]));
+        else if (i % 3 == 1 && glm::dot(a, b) > 0.0f)
+            b = -b;
+        as.push_back(a);
+        bs.push_back(b);
+        factors.push_back(float(i % 17) / 16.0f);
+    }
+
+    auto error = [](const glm::quat& result, const glm::quat& reference)
+    {
+        const float resultValues[4] = { result.x, result.y, result.z, result.w };
+        const float referenceValues[4] = { reference.x, reference.y, reference.z, reference.w };
+        return URelativeError(resultValues, referenceValues);
+    };
+
+    for (size_t count : UCheckCounts())
+    {
+        SoaArrays a(4, count), b(4, count), inPlace(4, count), product(4, count), nlerp(4, count), slerp(4, count);
+        SoaArrays matrix(16, count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            glm::setQuaternion(a.quat(), i, as[i]);
+            glm::setQuaternion(b.quat(), i, bs[i]);
+            glm::setQuaternion(inPlace.quat(), i, as[i]);
+        }
+
+        glm::multiplyQuaternions(a.quat(), b.quat(), product.quat(), count);
+        glm::multiplyQuaternions(inPlace.quat(), b.quat(), inPlace.quat(), count);
+        glm::nlerpQuaternions(a.quat(), b.quat(), factors.data(), nlerp.quat(), count);
+        glm::slerpQuaternions(a.quat(), b.quat(), factors.data(), slerp.quat(), count);
+        glm::rotationMatrices(a.quat(), matrix.mat4(), count);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            glm::quat expectedProduct = as[i] * bs[i];
+            products.maxError = max(products.maxError, error(glm::getQuaternion(product.quat(), i), expectedProduct));
+            productsInPlace.maxError = max(productsInPlace.maxError, error(glm::getQuaternion(inPlace.quat(), i), expectedProduct));
+
+            glm::quat shorterB = glm::dot(as[i], bs[i]) < 0.0f ? -bs[i] : bs[i];
+            glm::quat expectedNlerp = glm::normalize(as[i] * (1.0f - factors[i]) + shorterB * factors[i]);
+            nlerps.maxError = max(nlerps.maxError, error(glm::getQuaternion(nlerp.quat(), i), expectedNlerp));
+
+            // In double precision, since float slerp itself falls back to an unnormalized lerp near its limit
+            glm::quat expectedSlerp = glm::quat(glm::slerp(glm::dquat(as[i]), glm::dquat(bs[i]), double(factors[i])));
+            slerps.maxError = max(slerps.maxError, error(glm::getQuaternion(slerp.quat(), i), expectedSlerp));
+
+            glm::mat4 expectedMatrix = glm::mat4_cast(as[i]);
+            glm::mat4 resultMatrix = glm::getMatrix(matrix.mat4(), i);
+            matrices.maxError = max(matrices.maxError, URelativeError(reinterpret_cast<const float (&)[16]>(resultMatrix[0][0]), reinterpret_cast<const float (&)[16]>(expectedMatrix[0][0])));
+        }
+
+        products.isGuardIntact = products.isGuardIntact && product.isGuardIntact(count);
+        productsInPlace.isGuardIntact = productsInPlace.isGuardIntact && inPlace.isGuardIntact(count);
+        nlerps.isGuardIntact = nlerps.isGuardIntact && nlerp.isGuardIntact(count);
+        slerps.isGuardIntact = slerps.isGuardIntact && slerp.isGuardIntact(count);
+        matrices.isGuardIntact = matrices.isGuardIntact && matrix.isGuardIntact(count);
+    }
+
+    results.push_back(products);
+    results.push_back(productsInPlace);
+    results.push_back(nlerps);
+    results.push_back(slerps);
+    results.push_back(matrices);
+}
+
+
+// Prints one CSV row per check and returns the exit status: failure if any check exceeded its bound or wrote past Count
+int UPrintChecks(const vector<CheckResult>& results, bool header)
+{
+    if (header)
+        cout << "config, glm simd, check, counts, max error, bound, status" << endl;
+
+    bool passed = true;
+    string config = UConfigName();
+    for (const CheckResult& result : results)
+    {
+        bool ok = result.maxError <= result.bound && result.isGuardIntact;
+        passed = passed && ok;
+        cout << config << ", " << USimdName() << ", " << result.check << ", 0-" << CHECK_MAX_TAIL_COUNT << " and " << result.largestCount << ", "
+             << result.maxError << ", " << result.bound << ", "
+             << (ok ? "ok" : result.isGuardIntact ? "mismatch" : "wrote past count") << endl;
+    }
+
+    if (!passed)
+        cerr << config << ": batched results differ from scalar glm" << endl;
+
+    return passed ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,297 @@
+/*
+* ImagePostDecode.h
+
+  Fused post-decode stage for images returned by stb_image: vertical flip,
+  channel expansion/swizzle, sRGB to linear conversion and alpha
+  premultiplication in a single pass over the pixels, split across threads
+  by rows.
+*/
+
+#ifndef IMAGE_POST_DECODE_H
+#define IMAGE_POST_DECODE_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define POST_DECODE_SSE2
+#endif
+
+// The SSSE3 shuffle is compiled for that target per function and chosen at run time, so builds
+// without /arch or -mssse3 (the shipped MSVC project) still take it on CPUs that have it
+#if defined(POST_DECODE_SSE2) && (defined(_MSC_VER) || defined(__clang__) || \
+    (defined(__GNUC__) && (__GNUC__ * 100 + __GNUC_MINOR__) >= 409))
+#include <tmmintrin.h>
+#define POST_DECODE_SSSE3
+
+#ifdef _MSC_VER
+#include <intrin.h> // __cpuid
+#define POST_DECODE_SSSE3_TARGET
+
+inline bool UPostDecodeHasSsse3()
+{
+    static const bool hasSsse3 = []() {
+        int info[4];
+        __cpuid(info, 1);
+        return ((info[2] >> 9) & 1) != 0;
+    }();
+    return hasSsse3;
+}
+#else
+#define POST_DECODE_SSSE3_TARGET __attribute__((target("ssse3")))
+
+inline bool UPostDecodeHasSsse3()
+{
+    static const bool hasSsse3 = __builtin_cpu_supports("ssse3");
+    return hasSsse3;
+}
+#endif
+#endif
+
+// Images smaller than this are processed on the calling thread
+const int POST_DECODE_THREAD_MIN_PIXELS = 512 * 512;
+
+// Describes the work done by UPostDecodeImage
+struct PostDecodeOptions
+{
+    bool flipVertically;    // Images are loaded with Y going down, but OpenGL's Y axis goes up
+    int outputChannels;     // 1 to 4 channels per output pixel
+    int swizzle[4];         // Source channel for each output channel; -1 writes 255 (opaque alpha)
+    bool srgbToLinear;      // Convert color channels (not alpha) from sRGB to linear, 8 bits per channel
+    bool premultiplyAlpha;  // Multiply color channels by alpha; requires 4 output channels
+};
+
+// Options that flip the image and expand grey/grey-alpha to RGB/RGBA, keeping RGB and RGBA as they are
+inline PostDecodeOptions UDefaultPostDecodeOptions(int srcChannels)
+{
+    PostDecodeOptions options = { true, srcChannels, { 0, 1, 2, 3 }, false, false };
+
+    if (srcChannels == 1) {
+        options.outputChannels = 3;
+        options.swizzle[1] = 0;
+        options.swizzle[2] = 0;
+    }
+    else if (srcChannels == 2) {
+        options.outputChannels = 4;
+        options.swizzle[1] = 0;
+        options.swizzle[2] = 0;
+        options.swizzle[3] = 1;
+    }
+
+    return options;
+}
+
+// 8-bit sRGB to 8-bit linear lookup table. Dark values lose precision at 8 bits; filtering
+// that needs the full range (mip generation) should convert to float instead.
+inline const unsigned char* USrgbToLinearTable()
+{
+    static const std::vector<unsigned char> table = []() {
+        std::vector<unsigned char> values(256);
+        for (int i = 0; i < 256; ++i) {
+            float c = i / 255.0f;
+            float linear = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            values[i] = (unsigned char)(linear * 255.0f + 0.5f);
+        }
+        return values;
+    }();
+
+    return &table[0];
+}
+
+// Runs rowFunction(firstRow, lastRow) over [0, rows) on up to hardware_concurrency threads
+template <typename RowFunction>
+void UParallelRows(int rows, long long pixels, RowFunction rowFunction)
+{
+    int threadCount = (int)std::thread::hardware_concurrency();
+    if (pixels < POST_DECODE_THREAD_MIN_PIXELS || threadCount <= 1 || rows < 2) {
+        rowFunction(0, rows);
+        return;
+    }
+
+    threadCount = std::min(threadCount, rows);
+    std::vector<std::thread> workers;
+    int rowsPerThread = (rows + threadCount - 1) / threadCount;
+
+    for (int first = rowsPerThread; first < rows; first += rowsPerThread)
+        workers.emplace_back(rowFunction, first, std::min(first + rowsPerThread, rows));
+
+    // The calling thread takes the first band
+    rowFunction(0, std::min(rowsPerThread, rows));
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+// Flips an image in place by swapping whole rows with memcpy
+inline void UFlipImageRows(unsigned char* image, int width, int height, int channels)
+{
+    size_t rowSize = (size_t)width * channels;
+
+    UParallelRows(height / 2, (long long)width * height, [=](int first, int last) {
+        std::vector<unsigned char> tmp(rowSize);
+        for (int j = first; j < last; ++j) {
+            unsigned char* top = image + j * rowSize;
+            unsigned char* bottom = image + (height - 1 - j) * rowSize;
+            memcpy(&tmp[0], top, rowSize);
+            memcpy(top, bottom, rowSize);
+            memcpy(bottom, &tmp[0], rowSize);
+        }
+    });
+}
+
+// Multiplies the color channels of an RGBA row by alpha, rounding like (c * a + 127) / 255
+inline void UPremultiplyRowRGBA(unsigned char* row, int width)
+{
+    int x = 0;
+
+#ifdef POST_DECODE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(128);
+    const __m128i alphaMask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0); // Alpha lanes keep their value
+
+    for (; x + 4 <= width; x += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(row + x * 4));
+
+        __m128i lo = _mm_unpacklo_epi8(pixels, zero);
+        __m128i hi = _mm_unpackhi_epi8(pixels, zero);
+
+        // Broadcast each pixel's alpha over its four 16-bit lanes
+        __m128i alphaLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xFF), 0xFF);
+        __m128i alphaHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xFF), 0xFF);
+
+        // Alpha lanes multiply by 255 so they survive the divide unchanged
+        alphaLo = _mm_or_si128(_mm_andnot_si128(alphaMask, alphaLo), _mm_and_si128(alphaMask, _mm_set1_epi16(255)));
+        alphaHi = _mm_or_si128(_mm_andnot_si128(alphaMask, alphaHi), _mm_and_si128(alphaMask, _mm_set1_epi16(255)));
+
+        // Exact divide by 255: t = c * a + 128; (t + (t >> 8)) >> 8
+        __m128i productLo = _mm_add_epi16(_mm_mullo_epi16(lo, alphaLo), round);
+        __m128i productHi = _mm_add_epi16(_mm_mullo_epi16(hi, alphaHi), round);
+        productLo = _mm_srli_epi16(_mm_add_epi16(productLo, _mm_srli_epi16(productLo, 8)), 8);
+        productHi = _mm_srli_epi16(_mm_add_epi16(productHi, _mm_srli_epi16(productHi, 8)), 8);
+
+        _mm_storeu_si128((__m128i*)(row + x * 4), _mm_packus_epi16(productLo, productHi));
+    }
+#endif
+
+    for (; x < width; ++x) {
+        unsigned char* pixel = row + x * 4;
+        for (int c = 0; c < 3; ++c) {
+            unsigned int t = pixel[c] * pixel[3] + 128;
+            pixel[c] = (unsigned char)((t + (t >> 8)) >> 8);
+        }
+    }
+}
+
+#ifdef POST_DECODE_SSSE3
+// RGB -> RGBA (the common JPEG case): shuffles 4 pixels per 16-byte load and returns the pixels written
+POST_DECODE_SSSE3_TARGET inline int USwizzleRowRGBToRGBASsse3(const unsigned char* src, unsigned char* dst, const int swizzle[4], int width)
+{
+    const __m128i shuffle = _mm_setr_epi8(
+        (char)swizzle[0], (char)swizzle[1], (char)swizzle[2], -1,
+        (char)(3 + swizzle[0]), (char)(3 + swizzle[1]), (char)(3 + swizzle[2]), -1,
+        (char)(6 + swizzle[0]), (char)(6 + swizzle[1]), (char)(6 + swizzle[2]), -1,
+        (char)(9 + swizzle[0]), (char)(9 + swizzle[1]), (char)(9 + swizzle[2]), -1);
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+
+    // 16-byte loads read 4 bytes past the 4 pixels, so stop while a full load stays in the row
+    int x = 0;
+    for (; x + 6 <= width; x += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(src + x * 3));
+        _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), opaque));
+    }
+    return x;
+}
+#endif
+
+// Writes one destination row from one source row, applying the swizzle
+inline void USwizzleRow(const unsigned char* src, int srcChannels, unsigned char* dst, const PostDecodeOptions& options, int width)
+{
+    const int outChannels = options.outputChannels;
+    int x = 0;
+
+#ifdef POST_DECODE_SSSE3
+    if (srcChannels == 3 && outChannels == 4 && options.swizzle[3] < 0 &&
+        options.swizzle[0] < 3 && options.swizzle[1] < 3 && options.swizzle[2] < 3 && UPostDecodeHasSsse3())
+        x = USwizzleRowRGBToRGBASsse3(src, dst, options.swizzle, width);
+#endif
+
+    for (; x < width; ++x) {
+        const unsigned char* in = src + x * srcChannels;
+        unsigned char* out = dst + x * outChannels;
+        for (int c = 0; c < outChannels; ++c)
+            out[c] = options.swizzle[c] < 0 ? 255 : in[options.swizzle[c]];
+    }
+}
+
+// Runs the enabled post-decode steps over src in a single pass, writing options.outputChannels
+// channels per pixel into dst. dst must hold width * height * options.outputChannels bytes and may
+// be the same buffer as src only when the channel layout is unchanged (the identity swizzle); an
+// in-place call with any other swizzle asserts, and leaves the image untouched in release builds.
+inline void UPostDecodeImage(const unsigned char* src, int width, int height, int srcChannels, unsigned char* dst, const PostDecodeOptions& options)
+{
+    const int outChannels = options.outputChannels;
+
+    bool isIdentity = outChannels == srcChannels;
+    for (int c = 0; c < outChannels && isIdentity; ++c)
+        isIdentity = options.swizzle[c] == c;
+
+    // A swizzle in place would overwrite pixels, and with more output channels whole rows, before they are read
+    assert(src != dst || isIdentity);
+    if (src == dst && !isIdentity)
+        return;
+
+    // Only a flip: swap rows in place rather than copying the whole image
+    if (src == dst && isIdentity && !options.srgbToLinear && !options.premultiplyAlpha) {
+        if (options.flipVertically)
+            UFlipImageRows(dst, width, height, outChannels);
+        return;
+    }
+
+    // In-place with other work (the swizzle is the identity here): flip first so each row is processed where it ends up
+    if (src == dst && options.flipVertically) {
+        UFlipImageRows(dst, width, height, outChannels);
+        PostDecodeOptions remaining = options;
+        remaining.flipVertically = false;
+        UPostDecodeImage(src, width, height, srcChannels, dst, remaining);
+        return;
+    }
+
+    const unsigned char* linearTable = options.srgbToLinear ? USrgbToLinearTable() : nullptr;
+    const int colorChannels = outChannels == 2 || outChannels == 4 ? outChannels - 1 : outChannels;
+    const size_t srcRowSize = (size_t)width * srcChannels;
+    const size_t dstRowSize = (size_t)width * outChannels;
+
+    UParallelRows(height, (long long)width * height, [&](int first, int last) {
+        for (int y = first; y < last; ++y) {
+            int srcY = options.flipVertically ? height - 1 - y : y;
+            const unsigned char* srcRow = src + srcY * srcRowSize;
+            unsigned char* dstRow = dst + y * dstRowSize;
+
+            if (isIdentity) {
+                if (srcRow != dstRow)
+                    memcpy(dstRow, srcRow, dstRowSize);
+            }
+            else {
+                USwizzleRow(srcRow, srcChannels, dstRow, options, width);
+            }
+
+            if (linearTable) {
+                for (int x = 0; x < width; ++x) {
+                    unsigned char* pixel = dstRow + x * outChannels;
+                    for (int c = 0; c < colorChannels; ++c)
+                        pixel[c] = linearTable[pixel[c]];
+                }
+            }
+
+            if (options.premultiplyAlpha && outChannels == 4)
+                UPremultiplyRowRGBA(dstRow, width);
+        }
+    });
+}
+
+#endif
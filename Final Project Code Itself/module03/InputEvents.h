@@ -0,0 +1,197 @@
+/*
+* InputEvents.h
+
+  Event-driven input. The GLFW key, mouse button, cursor and scroll
+  callbacks only stamp each event with glfwGetTimerValue() and push it onto
+  a single-producer, single-consumer lock-free ring. Once per frame the
+  events are drained in order: keys and buttons are looked up in a binding
+  table and dispatched as actions only when they change state (GLFW's key
+  repeats are ignored), and cursor and scroll events are passed on as they
+  are. A frame costs one step per event, however many keys are bound.
+
+  Actions that work while held, such as camera movement, ask for how long
+  they were down during the frame. That is measured from the event
+  timestamps, so a key tapped for part of a frame moves the camera for
+  only that part. Timestamps are as precise as the thread handling events,
+  which is why that is a thread of its own waiting on them (RenderThread.h);
+  a poll once per frame would stamp the whole batch at once.
+*/
+
+#ifndef INPUT_EVENTS_H
+#define INPUT_EVENTS_H
+
+#include <atomic>
+#include <cstdint>
+
+#include <GLFW/glfw3.h>
+
+const int INPUT_QUEUE_SIZE = 1024;      // Events held between drains; more are dropped
+const int INPUT_MAX_ACTIONS = 64;       // Action 0 means unbound
+
+enum InputEventType
+{
+    INPUT_EVENT_KEY,
+    INPUT_EVENT_MOUSE_BUTTON,
+    INPUT_EVENT_CURSOR,
+    INPUT_EVENT_SCROLL
+};
+
+struct InputEvent
+{
+    InputEventType type;
+    int code;           // GLFW key or mouse button
+    int action;         // GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT
+    double x, y;        // Cursor position or scroll offset
+    uint64_t time;      // glfwGetTimerValue() when the callback ran
+};
+
+// Single producer (the thread polling GLFW), single consumer (the thread processing input)
+struct InputQueue
+{
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+    std::atomic<unsigned> dropped;
+    InputEvent events[INPUT_QUEUE_SIZE];
+};
+
+struct InputBinding
+{
+    InputEventType device;  // INPUT_EVENT_KEY or INPUT_EVENT_MOUSE_BUTTON
+    int code;
+    int action;
+};
+
+// Keys and buttons to actions, and which actions are down
+struct InputMap
+{
+    unsigned char keyActions[GLFW_KEY_LAST + 1];
+    unsigned char buttonActions[GLFW_MOUSE_BUTTON_LAST + 1];
+    bool isDown[INPUT_MAX_ACTIONS];
+    uint64_t downSince[INPUT_MAX_ACTIONS];  // Press time, or the start of the frame if earlier
+    uint64_t heldTicks[INPUT_MAX_ACTIONS];  // Time down during the last drained frame
+    bool isHeldListed[INPUT_MAX_ACTIONS];
+    int heldActions[INPUT_MAX_ACTIONS];     // Actions with held time in the last drained frame
+    int heldCount;
+    uint64_t frequency;
+};
+
+inline void UResetInputQueue(InputQueue& queue)
+{
+    queue.head.store(0);
+    queue.tail.store(0);
+    queue.dropped.store(0);
+}
+
+inline bool UPushInputEvent(InputQueue& queue, const InputEvent& event)
+{
+    size_t head = queue.head.load(std::memory_order_relaxed);
+    if (head - queue.tail.load(std::memory_order_acquire) >= (size_t)INPUT_QUEUE_SIZE) {
+        queue.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    queue.events[head % INPUT_QUEUE_SIZE] = event;
+    queue.head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+inline bool UPopInputEvent(InputQueue& queue, InputEvent& event)
+{
+    size_t tail = queue.tail.load(std::memory_order_relaxed);
+    if (tail == queue.head.load(std::memory_order_acquire))
+        return false;
+
+    event = queue.events[tail % INPUT_QUEUE_SIZE];
+    queue.tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+inline void UPushInputEvent(InputQueue& queue, InputEventType type, int code, int action, double x, double y)
+{
+    InputEvent event = { type, code, action, x, y, glfwGetTimerValue() };
+    UPushInputEvent(queue, event);
+}
+
+inline void UCreateInputMap(InputMap& map, const InputBinding* bindings, int bindingCount)
+{
+    map = InputMap();
+    map.frequency = glfwGetTimerFrequency();
+    for (int i = 0; i < bindingCount; ++i) {
+        const InputBinding& binding = bindings[i];
+        if (binding.device == INPUT_EVENT_KEY && binding.code >= 0 && binding.code <= GLFW_KEY_LAST)
+            map.keyActions[binding.code] = (unsigned char)binding.action;
+        else if (binding.device == INPUT_EVENT_MOUSE_BUTTON && binding.code >= 0 && binding.code <= GLFW_MOUSE_BUTTON_LAST)
+            map.buttonActions[binding.code] = (unsigned char)binding.action;
+    }
+}
+
+// Seconds the action was down during the last drained frame
+inline double UInputHeldSeconds(const InputMap& map, int action)
+{
+    return (double)map.heldTicks[action] / (double)map.frequency;
+}
+
+// Drains every queued event up to frame time now. onAction(action, isPressed, event) is called when a bound
+// key or button changes state, onCursor(x, y) and onScroll(x, y) for every cursor and scroll event.
+template <typename ActionFunction, typename CursorFunction, typename ScrollFunction>
+void UDispatchInputEvents(InputQueue& queue, InputMap& map, uint64_t now, ActionFunction onAction, CursorFunction onCursor, ScrollFunction onScroll)
+{
+    // Start the frame's held times over, forgetting actions released during the last one
+    int heldCount = 0;
+    for (int i = 0; i < map.heldCount; ++i) {
+        int action = map.heldActions[i];
+        map.heldTicks[action] = 0;
+        map.isHeldListed[action] = map.isDown[action];
+        if (map.isDown[action])
+            map.heldActions[heldCount++] = action;
+    }
+    map.heldCount = heldCount;
+
+    InputEvent event;
+    while (UPopInputEvent(queue, event)) {
+        if (event.type == INPUT_EVENT_CURSOR) {
+            onCursor(event.x, event.y);
+            continue;
+        }
+        if (event.type == INPUT_EVENT_SCROLL) {
+            onScroll(event.x, event.y);
+            continue;
+        }
+        if (event.action == GLFW_REPEAT)
+            continue;
+
+        int action = 0;
+        if (event.type == INPUT_EVENT_KEY && event.code >= 0 && event.code <= GLFW_KEY_LAST)
+            action = map.keyActions[event.code];
+        else if (event.type == INPUT_EVENT_MOUSE_BUTTON && event.code >= 0 && event.code <= GLFW_MOUSE_BUTTON_LAST)
+            action = map.buttonActions[event.code];
+
+        bool isPressed = event.action == GLFW_PRESS;
+        if (action == 0 || map.isDown[action] == isPressed)
+            continue;
+
+        map.isDown[action] = isPressed;
+        if (isPressed) {
+            map.downSince[action] = event.time;
+            if (!map.isHeldListed[action]) {
+                map.isHeldListed[action] = true;
+                map.heldActions[map.heldCount++] = action;
+            }
+        }
+        else if (event.time > map.downSince[action]) {
+            map.heldTicks[action] += event.time - map.downSince[action];
+        }
+        onAction(action, isPressed, event);
+    }
+
+    // Actions still down count until now, and the next frame counts on from there
+    for (int i = 0; i < map.heldCount; ++i) {
+        int action = map.heldActions[i];
+        if (map.isDown[action] && now > map.downSince[action]) {
+            map.heldTicks[action] += now - map.downSince[action];
+            map.downSince[action] = now;
+        }
+    }
+}
+
+#endif
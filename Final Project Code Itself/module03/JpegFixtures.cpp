@@ -0,0 +1,442 @@
+/*
+* JpegFixtures.cpp
+
+  Writes the baseline JPEGs in resources/tests/jpeg that "make decoder_check"
+  decodes on several threads. The textures in resources/textures hold a single
+  progressive JPEG, which never reaches stb_image's restart interval or
+  baseline code, so this small encoder produces the layouts those paths
+  branch on: 4:2:0, 4:4:4 and grayscale, each with and without restart
+  intervals, and one whose restart markers outnumber its intervals so the
+  decoder has to fall back to its serial path.
+
+  The images are just over 512x512, the smallest stb_image splits across
+  threads, and not a whole number of MCUs wide or high, so the partial MCUs
+  at the right and bottom edges are decoded and resampled too. The encoder
+  uses the example quantization and Huffman tables from the JPEG standard at
+  quality 75, and draws the same procedural image every time, so the files
+  only change when this program does.
+
+  Build and run with "make jpeg_fixtures", or with MSVC from this directory:
+      cl /O2 /EHsc JpegFixtures.cpp
+
+  Usage: jpeg_fixtures [directory]
+  The directory defaults to ../resources/tests/jpeg and must already exist.
+*/
+
+#include <iostream>         // cerr
+#include <algorithm>        // min, max
+#include <cmath>            // cos, sin, sqrt
+#include <cstdio>           // fopen, fwrite
+#include <cstdlib>          // EXIT_FAILURE
+#include <string>
+#include <vector>
+
+using namespace std; // Standard namespace
+
+// Unnamed namespace
+namespace
+{
+    const char* const DEFAULT_DIRECTORY = "../resources/tests/jpeg";
+    const int IMAGE_WIDTH = 517;
+    const int IMAGE_HEIGHT = 515;
+    const int QUALITY = 75;
+    const double PI = 3.14159265358979323846;
+
+    // Example tables from Annex K of the JPEG standard, in natural order
+    const unsigned char LUMA_QUANT[64] = {
+        16, 11, 10, 16, 24, 40, 51, 61,     12, 12, 14, 19, 26, 58, 60, 55,
+        14, 13, 16, 24, 40, 57, 69, 56,     14, 17, 22, 29, 51, 87, 80, 62,
+        18, 22, 37, 56, 68, 109, 103, 77,   24, 35, 55, 64, 81, 104, 113, 92,
+        49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99 };
+    const unsigned char CHROMA_QUANT[64] = {
+        17, 18, 24, 47, 99, 99, 99, 99,     18, 21, 26, 66, 99, 99, 99, 99,
+        24, 26, 56, 99, 99, 99, 99, 99,     47, 66, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99,     99, 99, 99, 99, 99, 99, 99, 99,
+        99, 99, 99, 99, 99, 99, 99, 99,     99, 99, 99, 99, 99, 99, 99, 99 };
+
+    const unsigned char ZIGZAG[64] = {
+        0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+        12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+        35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+        58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63 };
+
+    // Huffman tables as code counts per length (1 to 16 bits) followed by the symbols
+    const unsigned char LUMA_DC_BITS[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+    const unsigned char LUMA_DC_VALUES[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+    const unsigned char CHROMA_DC_BITS[16] = { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+    const unsigned char CHROMA_DC_VALUES[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+    const unsigned char LUMA_AC_BITS[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+    const unsigned char LUMA_AC_VALUES[162] = {
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+        0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+        0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+        0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+        0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+        0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa };
+    const unsigned char CHROMA_AC_BITS[16] = { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+    const unsigned char CHROMA_AC_VALUES[162] = {
+        0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+        0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+        0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+        0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+        0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+        0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+        0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+        0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+        0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+        0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa };
+
+    // One fixture: its layout and how its entropy-coded data is split up
+    struct Fixture
+    {
+        const char* name;
+        int components;         // 1 for grayscale, 3 for YCbCr
+        int lumaSampling;       // Luma samples per chroma sample in each direction: 1 for 4:4:4, 2 for 4:2:0
+        int restartInterval;    // MCUs per restart interval, 0 for none
+        bool hasExtraRestart;   // One more restart marker after the last interval
+    };
+
+    // 517x515 is 33x33 MCUs at 4:2:0 and 65x65 blocks otherwise. The intervals don't line up with MCU rows,
+    // except in the extra marker fixture, where the interval must divide the MCU count: stb_image only reads
+    // the trailing marker as a restart when the last interval ends exactly at the last MCU
+    const Fixture FIXTURES[] = {
+        { "baseline_420.jpg",                 3, 2, 0,  false },
+        { "baseline_420_restart.jpg",         3, 2, 11, false },
+        { "baseline_444.jpg",                 3, 1, 0,  false },
+        { "baseline_444_restart.jpg",         3, 1, 16, false },
+        { "grayscale.jpg",                    1, 1, 0,  false },
+        { "grayscale_restart.jpg",            1, 1, 13, false },
+        { "baseline_420_extra_restart.jpg",   3, 2, 33, true },
+    };
+
+    // Huffman codes and their lengths, indexed by symbol
+    struct HuffmanTable
+    {
+        unsigned short codes[256];
+        unsigned char lengths[256];
+    };
+
+    // Entropy-coded output with JPEG's byte stuffing
+    struct BitWriter
+    {
+        vector<unsigned char>* bytes;
+        unsigned int buffer;
+        int bitCount;
+    };
+
+    // One color plane, padded out to whole MCUs
+    struct Plane
+    {
+        int width;
+        int height;
+        vector<float> samples; // Level shifted by -128, ready for the DCT
+    };
+}
+
+/* Fixture function prototypes */
+void UImagePixel(int x, int y, float rgb[3]);
+void UBuildPlanes(const Fixture& fixture, vector<Plane>& planes);
+void UScaleQuantTable(const unsigned char table[64], unsigned char scaled[64]);
+void UBuildHuffmanTable(const unsigned char bits[16], const unsigned char* values, HuffmanTable& table);
+void UWriteBits(BitWriter& writer, unsigned int bits, int count);
+void UFlushBits(BitWriter& writer);
+void UWriteMarker(vector<unsigned char>& bytes, unsigned char marker, const vector<unsigned char>& payload);
+void UEncodeBlock(BitWriter& writer, const Plane& plane, int blockX, int blockY, const unsigned char quant[64],
+                  const HuffmanTable& dc, const HuffmanTable& ac, int& dcPrediction);
+vector<unsigned char> UEncodeFixture(const Fixture& fixture);
+
+
+int main(int argc, char* argv[])
+{
+    string directory = argc > 1 ? argv[1] : DEFAULT_DIRECTORY;
+
+    for (const Fixture& fixture : FIXTURES) {
+        vector<unsigned char> contents = UEncodeFixture(fixture);
+        string filename = directory + "/" + fixture.name;
+        FILE* file = fopen(filename.c_str(), "wb");
+        bool isWritten = file && fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+        if (file)
+            fclose(file);
+        if (!isWritten) {
+            cerr << filename << ": failed to write" << endl;
+            return EXIT_FAILURE;
+        }
+        cerr << filename << ": " << contents.size() << " bytes" << endl;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+// The test image: soft gradients with rings and stripes, so every block has some detail to code
+void UImagePixel(int x, int y, float rgb[3])
+{
+    float dx = x - IMAGE_WIDTH * 0.4f;
+    float dy = y - IMAGE_HEIGHT * 0.6f;
+    float ring = (float)sin(sqrt(dx * dx + dy * dy) * 0.12);
+    float stripe = (float)cos((x + 2 * y) * 0.05);
+
+    rgb[0] = 128.0f + 100.0f * ring * (float)x / IMAGE_WIDTH;
+    rgb[1] = 60.0f + 150.0f * (float)y / IMAGE_HEIGHT + 30.0f * stripe;
+    rgb[2] = 200.0f - 150.0f * (float)x / IMAGE_WIDTH + 40.0f * ring * stripe;
+}
+
+
+// Converts the image to YCbCr (or luma alone) and averages chroma down when subsampled. Edge pixels
+// are repeated out to the MCU boundary, as encoders usually do
+void UBuildPlanes(const Fixture& fixture, vector<Plane>& planes)
+{
+    int mcuSize = 8 * fixture.lumaSampling;
+    int paddedWidth = (IMAGE_WIDTH + mcuSize - 1) / mcuSize * mcuSize;
+    int paddedHeight = (IMAGE_HEIGHT + mcuSize - 1) / mcuSize * mcuSize;
+
+    planes.assign(fixture.components, Plane());
+    for (int c = 0; c < fixture.components; ++c) {
+        int scale = c == 0 ? 1 : fixture.lumaSampling;
+        planes[c].width = paddedWidth / scale;
+        planes[c].height = paddedHeight / scale;
+        planes[c].samples.assign((size_t)planes[c].width * planes[c].height, 0.0f);
+    }
+
+    for (int y = 0; y < paddedHeight; ++y) {
+        for (int x = 0; x < paddedWidth; ++x) {
+            float rgb[3];
+            UImagePixel(min(x, IMAGE_WIDTH - 1), min(y, IMAGE_HEIGHT - 1), rgb);
+            float ycc[3] = {
+                0.299f * rgb[0] + 0.587f * rgb[1] + 0.114f * rgb[2],
+                -0.168736f * rgb[0] - 0.331264f * rgb[1] + 0.5f * rgb[2] + 128.0f,
+                0.5f * rgb[0] - 0.418688f * rgb[1] - 0.081312f * rgb[2] + 128.0f };
+
+            for (int c = 0; c < fixture.components; ++c) {
+                int scale = c == 0 ? 1 : fixture.lumaSampling;
+                float weight = 1.0f / (scale * scale);
+                planes[c].samples[(size_t)(y / scale) * planes[c].width + x / scale] += (ycc[c] - 128.0f) * weight;
+            }
+        }
+    }
+}
+
+
+// The standard's table scaled to QUALITY the way the IJG library does
+void UScaleQuantTable(const unsigned char table[64], unsigned char scaled[64])
+{
+    int scale = QUALITY < 50 ? 5000 / QUALITY : 200 - 2 * QUALITY;
+    for (int i = 0; i < 64; ++i)
+        scaled[i] = (unsigned char)max(1, min(255, (table[i] * scale + 50) / 100));
+}
+
+
+// Assigns canonical codes in order of length, as a decoder rebuilds them from the DHT segment
+void UBuildHuffmanTable(const unsigned char bits[16], const unsigned char* values, HuffmanTable& table)
+{
+    int code = 0;
+    int k = 0;
+    for (int length = 1; length <= 16; ++length) {
+        for (int i = 0; i < bits[length - 1]; ++i, ++k) {
+            table.codes[values[k]] = (unsigned short)code++;
+            table.lengths[values[k]] = (unsigned char)length;
+        }
+        code <<= 1;
+    }
+}
+
+
+void UWriteBits(BitWriter& writer, unsigned int bits, int count)
+{
+    writer.buffer = writer.buffer << count | (bits & ((1u << count) - 1));
+    writer.bitCount += count;
+    while (writer.bitCount >= 8) {
+        unsigned char byte = (unsigned char)(writer.buffer >> (writer.bitCount - 8));
+        writer.bytes->push_back(byte);
+        if (byte == 0xFF)
+            writer.bytes->push_back(0x00);
+        writer.bitCount -= 8;
+    }
+}
+
+
+// Pads the last byte with one bits, as required before a marker
+void UFlushBits(BitWriter& writer)
+{
+    if (writer.bitCount > 0)
+        UWriteBits(writer, 0x7F, 8 - writer.bitCount);
+    writer.buffer = 0;
+}
+
+
+void UWriteMarker(vector<unsigned char>& bytes, unsigned char marker, const vector<unsigned char>& payload)
+{
+    bytes.push_back(0xFF);
+    bytes.push_back(marker);
+    size_t length = payload.size() + 2;
+    bytes.push_back((unsigned char)(length >> 8));
+    bytes.push_back((unsigned char)length);
+    bytes.insert(bytes.end(), payload.begin(), payload.end());
+}
+
+
+// Transforms, quantizes and Huffman codes one 8x8 block of the plane
+void UEncodeBlock(BitWriter& writer, const Plane& plane, int blockX, int blockY, const unsigned char quant[64],
+                  const HuffmanTable& dc, const HuffmanTable& ac, int& dcPrediction)
+{
+    // Straightforward separable DCT; speed doesn't matter here
+    double rows[64];
+    for (int y = 0; y < 8; ++y) {
+        const float* line = &plane.samples[(size_t)(blockY * 8 + y) * plane.width + blockX * 8];
+        for (int u = 0; u < 8; ++u) {
+            double sum = 0.0;
+            for (int x = 0; x < 8; ++x)
+                sum += line[x] * cos((2 * x + 1) * u * PI / 16);
+            rows[y * 8 + u] = sum * (u == 0 ? sqrt(0.125) : 0.5);
+        }
+    }
+
+    int coefficients[64];
+    for (int u = 0; u < 8; ++u) {
+        for (int v = 0; v < 8; ++v) {
+            double sum = 0.0;
+            for (int y = 0; y < 8; ++y)
+                sum += rows[y * 8 + u] * cos((2 * y + 1) * v * PI / 16);
+            sum *= v == 0 ? sqrt(0.125) : 0.5;
+            double quantized = sum / quant[v * 8 + u];
+            coefficients[v * 8 + u] = (int)(quantized < 0 ? quantized - 0.5 : quantized + 0.5);
+        }
+    }
+
+    // Coefficients are coded as a size category followed by that many bits, one's complement when negative
+    auto writeValue = [&](const HuffmanTable& table, int symbolHigh, int value) {
+        int magnitude = value < 0 ? -value : value;
+        int size = 0;
+        while (magnitude >> size)
+            ++size;
+        int symbol = symbolHigh << 4 | size;
+        UWriteBits(writer, table.codes[symbol], table.lengths[symbol]);
+        if (size)
+            UWriteBits(writer, value < 0 ? value - 1 : value, size);
+    };
+
+    writeValue(dc, 0, coefficients[0] - dcPrediction);
+    dcPrediction = coefficients[0];
+
+    int run = 0;
+    for (int i = 1; i < 64; ++i) {
+        int value = coefficients[ZIGZAG[i]];
+        if (value == 0) {
+            ++run;
+            continue;
+        }
+        for (; run >= 16; run -= 16)
+            UWriteBits(writer, ac.codes[0xF0], ac.lengths[0xF0]);
+        writeValue(ac, run, value);
+        run = 0;
+    }
+    if (run)
+        UWriteBits(writer, ac.codes[0x00], ac.lengths[0x00]);
+}
+
+
+vector<unsigned char> UEncodeFixture(const Fixture& fixture)
+{
+    vector<Plane> planes;
+    UBuildPlanes(fixture, planes);
+
+    unsigned char quant[2][64];
+    UScaleQuantTable(LUMA_QUANT, quant[0]);
+    UScaleQuantTable(CHROMA_QUANT, quant[1]);
+
+    HuffmanTable dcTables[2], acTables[2];
+    UBuildHuffmanTable(LUMA_DC_BITS, LUMA_DC_VALUES, dcTables[0]);
+    UBuildHuffmanTable(LUMA_AC_BITS, LUMA_AC_VALUES, acTables[0]);
+    UBuildHuffmanTable(CHROMA_DC_BITS, CHROMA_DC_VALUES, dcTables[1]);
+    UBuildHuffmanTable(CHROMA_AC_BITS, CHROMA_AC_VALUES, acTables[1]);
+
+    vector<unsigned char> bytes = { 0xFF, 0xD8 };
+    vector<unsigned char> payload = { 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 };
+    UWriteMarker(bytes, 0xE0, payload);
+
+    for (int t = 0; t < (fixture.components == 3 ? 2 : 1); ++t) {
+        payload.assign(1, (unsigned char)t);
+        for (int i = 0; i < 64; ++i)
+            payload.push_back(quant[t][ZIGZAG[i]]);
+        UWriteMarker(bytes, 0xDB, payload);
+    }
+
+    payload = { 8, (unsigned char)(IMAGE_HEIGHT >> 8), (unsigned char)IMAGE_HEIGHT,
+                (unsigned char)(IMAGE_WIDTH >> 8), (unsigned char)IMAGE_WIDTH, (unsigned char)fixture.components };
+    for (int c = 0; c < fixture.components; ++c) {
+        int sampling = c == 0 ? fixture.lumaSampling : 1;
+        payload.push_back((unsigned char)(c + 1));
+        payload.push_back((unsigned char)(sampling << 4 | sampling));
+        payload.push_back(c == 0 ? 0 : 1);
+    }
+    UWriteMarker(bytes, 0xC0, payload);
+
+    const unsigned char* huffmanBits[4] = { LUMA_DC_BITS, LUMA_AC_BITS, CHROMA_DC_BITS, CHROMA_AC_BITS };
+    const unsigned char* huffmanValues[4] = { LUMA_DC_VALUES, LUMA_AC_VALUES, CHROMA_DC_VALUES, CHROMA_AC_VALUES };
+    for (int t = 0; t < (fixture.components == 3 ? 4 : 2); ++t) {
+        payload.assign(1, (unsigned char)((t & 1) << 4 | t >> 1)); // Class in the high nibble, table id in the low
+        int count = 0;
+        for (int i = 0; i < 16; ++i) {
+            payload.push_back(huffmanBits[t][i]);
+            count += huffmanBits[t][i];
+        }
+        payload.insert(payload.end(), huffmanValues[t], huffmanValues[t] + count);
+        UWriteMarker(bytes, 0xC4, payload);
+    }
+
+    if (fixture.restartInterval) {
+        payload = { (unsigned char)(fixture.restartInterval >> 8), (unsigned char)fixture.restartInterval };
+        UWriteMarker(bytes, 0xDD, payload);
+    }
+
+    payload.assign(1, (unsigned char)fixture.components);
+    for (int c = 0; c < fixture.components; ++c) {
+        payload.push_back((unsigned char)(c + 1));
+        payload.push_back(c == 0 ? 0x00 : 0x11);
+    }
+    payload.push_back(0);   // Spectral selection start
+    payload.push_back(63);  // Spectral selection end
+    payload.push_back(0);   // Successive approximation
+    UWriteMarker(bytes, 0xDA, payload);
+
+    // A single component scan codes one block per MCU; otherwise an MCU holds each component's blocks in turn
+    int mcuBlocks = fixture.components == 1 ? 1 : fixture.lumaSampling;
+    int mcuColumns = planes[0].width / (8 * mcuBlocks);
+    int mcuRows = planes[0].height / (8 * mcuBlocks);
+    int mcuCount = mcuColumns * mcuRows;
+    int dcPredictions[3] = { 0, 0, 0 };
+    int restarts = 0;
+    BitWriter writer = { &bytes, 0, 0 };
+
+    for (int mcu = 0; mcu < mcuCount; ++mcu) {
+        int mcuX = mcu % mcuColumns;
+        int mcuY = mcu / mcuColumns;
+        for (int c = 0; c < fixture.components; ++c) {
+            int blocks = c == 0 ? mcuBlocks : 1;
+            for (int y = 0; y < blocks; ++y) {
+                for (int x = 0; x < blocks; ++x)
+                    UEncodeBlock(writer, planes[c], mcuX * blocks + x, mcuY * blocks + y, quant[c == 0 ? 0 : 1],
+                                 dcTables[c == 0 ? 0 : 1], acTables[c == 0 ? 0 : 1], dcPredictions[c]);
+            }
+        }
+
+        bool isIntervalEnd = fixture.restartInterval && (mcu + 1) % fixture.restartInterval == 0;
+        if (isIntervalEnd && (mcu + 1 < mcuCount || fixture.hasExtraRestart)) {
+            UFlushBits(writer);
+            bytes.push_back(0xFF);
+            bytes.push_back((unsigned char)(0xD0 + (restarts++ & 7)));
+            dcPredictions[0] = dcPredictions[1] = dcPredictions[2] = 0;
+        }
+    }
+
+    UFlushBits(writer);
+    bytes.push_back(0xFF);
+    bytes.push_back(0xD9);
+    return bytes;
+}
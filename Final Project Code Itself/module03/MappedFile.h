@@ -0,0 +1,127 @@
+/*
+* MappedFile.h
+
+  Read-only memory mapping of whole files, so images can be probed and
+  decoded straight from the page cache with stbi_info_from_memory and
+  stbi_load_from_memory instead of through stdio's small buffered reads.
+  The kernel is told the mapping will be read once, front to back.
+*/
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A file mapped into memory; data is null when nothing is mapped
+struct MappedFile
+{
+    const unsigned char* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int file;
+#endif
+};
+
+// Maps the whole file read-only. Returns false (and leaves nothing mapped) on failure or for empty files.
+inline bool UMapFile(const char* filename, MappedFile& mapped)
+{
+    mapped.data = nullptr;
+    mapped.size = 0;
+
+#ifdef _WIN32
+    mapped.file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    mapped.mapping = nullptr;
+    if (mapped.file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mapped.file, &size) || size.QuadPart == 0) {
+        CloseHandle(mapped.file);
+        return false;
+    }
+
+    mapped.mapping = CreateFileMappingA(mapped.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapped.mapping) {
+        CloseHandle(mapped.file);
+        return false;
+    }
+
+    mapped.data = (const unsigned char*)MapViewOfFile(mapped.mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!mapped.data) {
+        CloseHandle(mapped.mapping);
+        CloseHandle(mapped.file);
+        return false;
+    }
+
+    // Fault the pages in ahead of the decoder where the API exists (Windows 8 and later)
+#if _WIN32_WINNT >= 0x0602
+    WIN32_MEMORY_RANGE_ENTRY range = { (PVOID)mapped.data, (SIZE_T)size.QuadPart };
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+
+    mapped.size = (size_t)size.QuadPart;
+#else
+    mapped.file = open(filename, O_RDONLY);
+    if (mapped.file < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(mapped.file, &info) != 0 || info.st_size == 0) {
+        close(mapped.file);
+        return false;
+    }
+
+    void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, mapped.file, 0);
+    if (data == MAP_FAILED) {
+        close(mapped.file);
+        return false;
+    }
+
+    // Decoders read the file once from start to end: read ahead aggressively, drop pages behind
+    madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+    madvise(data, (size_t)info.st_size, MADV_WILLNEED);
+
+    mapped.data = (const unsigned char*)data;
+    mapped.size = (size_t)info.st_size;
+#endif
+
+    return true;
+}
+
+inline void UUnmapFile(MappedFile& mapped)
+{
+    if (!mapped.data)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(mapped.data);
+    CloseHandle(mapped.mapping);
+    CloseHandle(mapped.file);
+#else
+    munmap((void*)mapped.data, mapped.size);
+    close(mapped.file);
+#endif
+
+    mapped.data = nullptr;
+    mapped.size = 0;
+}
+
+#endif
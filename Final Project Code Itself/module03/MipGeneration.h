@@ -0,0 +1,312 @@
+/*
+* MipGeneration.h
+
+  CPU mip chain generation and resampling for 8-bit RGB/RGBA images. Each level is filtered
+  from the previous one in linear light (color channels are decoded from
+  sRGB first) with a separable box, Kaiser-windowed sinc or Lanczos kernel.
+  RGBA color is premultiplied by alpha while it is filtered, so transparent
+  texels, whatever color they hold, don't bleed into their visible neighbors.
+  Row bands of each pass run on separate threads and the inner loops work on
+  one SSE register per RGBA pixel.
+*/
+
+#ifndef MIP_GENERATION_H
+#define MIP_GENERATION_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "ImagePostDecode.h" // UParallelRows
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define MIP_GENERATION_SSE
+#endif
+
+// Downsampling kernels
+enum MipFilter
+{
+    MIP_FILTER_BOX,     // 2x2 average; cheapest, slightly blurry
+    MIP_FILTER_KAISER,  // Kaiser-windowed sinc, alpha 4, 3 lobes; sharp with little ringing
+    MIP_FILTER_LANCZOS  // Lanczos 3; sharpest, may ring on hard edges
+};
+
+// One generated level: width * height * channels bytes
+struct MipLevel
+{
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;
+};
+
+// Number of levels in a full chain down to 1x1, including the base level
+inline int UMipLevelCount(int width, int height)
+{
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2)
+        ++levels;
+    return levels;
+}
+
+// Kernel value at t destination pixels from the sample center
+inline float UMipFilterWeight(MipFilter filter, float t)
+{
+    const float PI = 3.14159265f;
+    t = std::fabs(t);
+
+    auto sinc = [PI](float x) { return x < 1e-5f ? 1.0f : std::sin(PI * x) / (PI * x); };
+
+    switch (filter) {
+    case MIP_FILTER_BOX:
+        return t <= 0.5f ? 1.0f : 0.0f;
+
+    case MIP_FILTER_LANCZOS:
+        return t < 3.0f ? sinc(t) * sinc(t / 3.0f) : 0.0f;
+
+    case MIP_FILTER_KAISER: {
+        if (t >= 3.0f)
+            return 0.0f;
+
+        // Zeroth order modified Bessel function of the first kind, by its power series
+        auto besselI0 = [](float x) {
+            float sum = 1.0f, term = 1.0f;
+            for (int k = 1; k < 16; ++k) {
+                term *= (x / (2.0f * k)) * (x / (2.0f * k));
+                sum += term;
+            }
+            return sum;
+        };
+        const float alpha = 4.0f;
+        float ratio = t / 3.0f;
+        return sinc(t) * besselI0(alpha * std::sqrt(1.0f - ratio * ratio)) / besselI0(alpha);
+    }
+    }
+
+    return 0.0f;
+}
+
+// Half-width of the kernel in destination pixels
+inline float UMipFilterSupport(MipFilter filter)
+{
+    return filter == MIP_FILTER_BOX ? 0.5f : 3.0f;
+}
+
+// Normalized taps for every destination pixel along one axis
+struct MipFilterTaps
+{
+    std::vector<int> first;         // First source index for each destination pixel
+    std::vector<int> count;         // Taps per destination pixel
+    std::vector<float> weights;     // count[i] weights per destination pixel, tapsPerPixel apart
+    int tapsPerPixel;
+};
+
+inline MipFilterTaps UComputeMipTaps(MipFilter filter, int srcSize, int dstSize)
+{
+    MipFilterTaps taps;
+    float scale = (float)srcSize / dstSize;
+    float filterScale = std::max(scale, 1.0f); // Upsampling keeps the kernel one source pixel wide
+    float support = UMipFilterSupport(filter) * filterScale;
+
+    taps.tapsPerPixel = (int)std::ceil(support * 2.0f) + 2;
+    taps.first.resize(dstSize);
+    taps.count.resize(dstSize);
+    taps.weights.assign((size_t)dstSize * taps.tapsPerPixel, 0.0f);
+
+    for (int i = 0; i < dstSize; ++i) {
+        float center = (i + 0.5f) * scale;
+        int first = std::max(0, (int)std::floor(center - support));
+        int last = std::min(srcSize - 1, (int)std::ceil(center + support) - 1);
+        last = std::max(last, first);
+        last = std::min(last, first + taps.tapsPerPixel - 1);
+
+        float* weights = &taps.weights[(size_t)i * taps.tapsPerPixel];
+        float total = 0.0f;
+        for (int s = first; s <= last; ++s) {
+            float w = UMipFilterWeight(filter, (s + 0.5f - center) / filterScale);
+            weights[s - first] = w;
+            total += w;
+        }
+
+        // Normalize so flat areas keep their value; fall back to nearest if the kernel missed
+        if (std::fabs(total) < 1e-6f) {
+            weights[0] = 1.0f;
+            last = first;
+            total = 1.0f;
+        }
+        for (int s = first; s <= last; ++s)
+            weights[s - first] /= total;
+
+        taps.first[i] = first;
+        taps.count[i] = last - first + 1;
+    }
+
+    return taps;
+}
+
+// Weighted sum of count RGBA float pixels spaced stride floats apart
+inline void UMipAccumulate(const float* src, int stride, const float* weights, int count, float* dst)
+{
+#ifdef MIP_GENERATION_SSE
+    __m128 sum = _mm_setzero_ps();
+    for (int k = 0; k < count; ++k)
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(src + (size_t)k * stride)));
+    _mm_storeu_ps(dst, sum);
+#else
+    float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int k = 0; k < count; ++k)
+        for (int c = 0; c < 4; ++c)
+            sum[c] += weights[k] * src[(size_t)k * stride + c];
+    for (int c = 0; c < 4; ++c)
+        dst[c] = sum[c];
+#endif
+}
+
+// Downsamples a linear RGBA float image with a separable filter, threading each pass by rows
+inline void UDownsampleLevel(const std::vector<float>& src, int srcWidth, int srcHeight,
+                             std::vector<float>& dst, int dstWidth, int dstHeight, MipFilter filter)
+{
+    MipFilterTaps horizontal = UComputeMipTaps(filter, srcWidth, dstWidth);
+    MipFilterTaps vertical = UComputeMipTaps(filter, srcHeight, dstHeight);
+
+    // Horizontal pass: srcHeight rows of dstWidth pixels
+    std::vector<float> columns((size_t)dstWidth * srcHeight * 4);
+    UParallelRows(srcHeight, (long long)srcWidth * srcHeight, [&](int firstRow, int lastRow) {
+        for (int y = firstRow; y < lastRow; ++y) {
+            const float* srcRow = &src[(size_t)y * srcWidth * 4];
+            float* dstRow = &columns[(size_t)y * dstWidth * 4];
+            for (int x = 0; x < dstWidth; ++x)
+                UMipAccumulate(srcRow + (size_t)horizontal.first[x] * 4, 4,
+                               &horizontal.weights[(size_t)x * horizontal.tapsPerPixel], horizontal.count[x], dstRow + (size_t)x * 4);
+        }
+    });
+
+    // Vertical pass: dstHeight rows, each tap steps a whole row
+    dst.resize((size_t)dstWidth * dstHeight * 4);
+    UParallelRows(dstHeight, (long long)dstWidth * srcHeight, [&](int firstRow, int lastRow) {
+        for (int y = firstRow; y < lastRow; ++y) {
+            const float* weights = &vertical.weights[(size_t)y * vertical.tapsPerPixel];
+            const float* srcColumn = &columns[(size_t)vertical.first[y] * dstWidth * 4];
+            float* dstRow = &dst[(size_t)y * dstWidth * 4];
+            for (int x = 0; x < dstWidth; ++x)
+                UMipAccumulate(srcColumn + (size_t)x * 4, dstWidth * 4, weights, vertical.count[y], dstRow + (size_t)x * 4);
+        }
+    });
+}
+
+// Linear [0, 1] to 8-bit sRGB through a 4096 entry table
+inline unsigned char ULinearToSrgb8(float linear)
+{
+    static const std::vector<unsigned char> table = []() {
+        std::vector<unsigned char> values(4096);
+        for (int i = 0; i < 4096; ++i) {
+            float l = i / 4095.0f;
+            float s = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            values[i] = (unsigned char)(s * 255.0f + 0.5f);
+        }
+        return values;
+    }();
+
+    linear = std::min(std::max(linear, 0.0f), 1.0f);
+    return table[(int)(linear * 4095.0f + 0.5f)];
+}
+
+// 8-bit image with 3 or 4 channels to RGBA floats, decoding sRGB for color channels when srgb is set.
+// Color is premultiplied by alpha for 4 channels
+inline std::vector<float> UDecodeToLinear(const unsigned char* image, int width, int height, int channels, bool srgb)
+{
+    float decode[256];
+    for (int i = 0; i < 256; ++i) {
+        float c = i / 255.0f;
+        decode[i] = !srgb ? c : (c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f));
+    }
+
+    std::vector<float> linear((size_t)width * height * 4);
+    UParallelRows(height, (long long)width * height, [&](int firstRow, int lastRow) {
+        for (size_t i = (size_t)firstRow * width; i < (size_t)lastRow * width; ++i) {
+            const unsigned char* in = image + i * channels;
+            float* out = &linear[i * 4];
+            float alpha = channels == 4 ? in[3] / 255.0f : 1.0f;
+            out[0] = decode[in[0]] * alpha;
+            out[1] = decode[in[1]] * alpha;
+            out[2] = decode[in[2]] * alpha;
+            out[3] = alpha;
+        }
+    });
+
+    return linear;
+}
+
+// Premultiplied RGBA floats back to an 8-bit image with 3 or 4 channels
+inline MipLevel UEncodeFromLinear(const std::vector<float>& linear, int width, int height, int channels, bool srgb)
+{
+    MipLevel level;
+    level.width = width;
+    level.height = height;
+    level.pixels.resize((size_t)width * height * channels);
+
+    UParallelRows(height, (long long)width * height, [&](int firstRow, int lastRow) {
+        for (size_t i = (size_t)firstRow * width; i < (size_t)lastRow * width; ++i) {
+            const float* in = &linear[i * 4];
+            unsigned char* out = &level.pixels[i * channels];
+
+            // Wide kernels can ring alpha past [0, 1]; a texel that ends up fully transparent is left black
+            float alpha = channels == 4 ? std::min(std::max(in[3], 0.0f), 1.0f) : 1.0f;
+            float unpremultiply = alpha >= 0.5f / 255.0f ? 1.0f / alpha : 0.0f;
+            for (int c = 0; c < 3; ++c) {
+                float color = in[c] * unpremultiply;
+                out[c] = srgb ? ULinearToSrgb8(color) : (unsigned char)(std::min(std::max(color, 0.0f), 1.0f) * 255.0f + 0.5f);
+            }
+            if (channels == 4)
+                out[3] = (unsigned char)(alpha * 255.0f + 0.5f);
+        }
+    });
+
+    return level;
+}
+
+// Builds levels 1..N of the mip chain for an 8-bit image with 3 or 4 channels. With srgb set the
+// color channels are filtered in linear light and re-encoded; alpha itself is always filtered as is,
+// and weights the color of 4 channel images.
+inline std::vector<MipLevel> UGenerateMipChain(const unsigned char* image, int width, int height, int channels,
+                                               MipFilter filter, bool srgb)
+{
+    std::vector<MipLevel> levels;
+    if (channels != 3 && channels != 4)
+        return levels;
+
+    std::vector<float> current = UDecodeToLinear(image, width, height, channels, srgb);
+
+    int levelWidth = width;
+    int levelHeight = height;
+    std::vector<float> next;
+
+    while (levelWidth > 1 || levelHeight > 1) {
+        int nextWidth = std::max(1, levelWidth / 2);
+        int nextHeight = std::max(1, levelHeight / 2);
+
+        // Each level is filtered from the previous float level, never from quantized bytes
+        UDownsampleLevel(current, levelWidth, levelHeight, next, nextWidth, nextHeight, filter);
+        current.swap(next);
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+
+        levels.push_back(UEncodeFromLinear(current, levelWidth, levelHeight, channels, srgb));
+    }
+
+    return levels;
+}
+
+// Resamples an 8-bit image with 3 or 4 channels to any size, up or down, with the given filter
+inline MipLevel UResizeImage(const unsigned char* image, int width, int height, int channels,
+                             int dstWidth, int dstHeight, MipFilter filter, bool srgb)
+{
+    std::vector<float> linear = UDecodeToLinear(image, width, height, channels, srgb);
+    std::vector<float> resized;
+
+    UDownsampleLevel(linear, width, height, resized, dstWidth, dstHeight, filter);
+
+    return UEncodeFromLinear(resized, dstWidth, dstHeight, channels, srgb);
+}
+
+#endif
@@ -0,0 +1,101 @@
+/*
+* RenderThread.h
+
+  Splits the program between two threads. GLFW requires events to be
+  handled on the main thread, so that thread becomes the event thread: it
+  blocks in glfwWaitEvents and its callbacks only queue what happened. A
+  dedicated render thread takes over the GL context and runs the frame
+  loop, draining the queued input just before each frame is drawn. A slow
+  frame no longer delays event handling, so input is timestamped when it
+  arrives rather than when the next frame gets round to polling, and the
+  render thread keeps drawing while the OS holds the event thread in a
+  window move or resize.
+
+  Nothing is locked between the two. Input events travel through the
+  InputQueue ring, and the framebuffer size through a single atomic that
+  always holds the latest size posted. A quit decided on the render thread
+  (the Escape key, a finished benchmark) sets a flag and wakes the event
+  thread with glfwPostEmptyEvent; closing the window stops the render
+  thread through another flag. The context is handed back to the main
+  thread once the render thread has stopped, to release GL resources.
+*/
+
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include <GLFW/glfw3.h>
+
+struct RenderThread
+{
+    std::thread thread;
+    std::atomic<bool> isStopping;           // Set by the event thread once the window is closing
+    std::atomic<bool> isCloseRequested;     // Set by the render thread to close the window
+    std::atomic<uint64_t> framebufferSize;  // Latest size posted, width in the high half; 0 once taken
+};
+
+// Event thread: records the framebuffer size for the render thread's next frame
+inline void UPostFramebufferSize(RenderThread& renderThread, int width, int height)
+{
+    uint64_t size = (uint64_t)(uint32_t)width << 32 | (uint32_t)height;
+    renderThread.framebufferSize.store(size | (uint64_t)1 << 63, std::memory_order_release);
+}
+
+// Render thread: the framebuffer size if one was posted since the last call
+inline bool UTakeFramebufferSize(RenderThread& renderThread, int& width, int& height)
+{
+    uint64_t size = renderThread.framebufferSize.exchange(0, std::memory_order_acquire);
+    if (size == 0)
+        return false;
+
+    width = (int)(size >> 32 & 0x7fffffff);
+    height = (int)(uint32_t)size;
+    return true;
+}
+
+inline bool URenderThreadRunning(const RenderThread& renderThread)
+{
+    return !renderThread.isStopping.load(std::memory_order_acquire);
+}
+
+// Render thread: asks the event thread to close the window and stop rendering
+inline void URequestClose(RenderThread& renderThread)
+{
+    renderThread.isCloseRequested.store(true, std::memory_order_release);
+    glfwPostEmptyEvent();
+}
+
+// Event thread: releases the window's context and starts renderFrames() on a new thread that owns it
+template <typename RenderFunction>
+void UStartRenderThread(RenderThread& renderThread, GLFWwindow* window, RenderFunction renderFrames)
+{
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    UPostFramebufferSize(renderThread, width, height);
+    renderThread.isStopping.store(false);
+    renderThread.isCloseRequested.store(false);
+
+    glfwMakeContextCurrent(NULL);
+    renderThread.thread = std::thread([&renderThread, window, renderFrames]() {
+        glfwMakeContextCurrent(window);
+        renderFrames();
+        glfwMakeContextCurrent(NULL);
+        URequestClose(renderThread);
+    });
+}
+
+// Event thread: handles events until the window closes, then stops the render thread and takes the context back
+inline void URunEventLoop(RenderThread& renderThread, GLFWwindow* window)
+{
+    while (!glfwWindowShouldClose(window) && !renderThread.isCloseRequested.load(std::memory_order_acquire))
+        glfwWaitEvents();
+
+    renderThread.isStopping.store(true, std::memory_order_release);
+    renderThread.thread.join();
+    glfwMakeContextCurrent(window);
+}
+
+#endif
@@ -0,0 +1,408 @@
+/*
+* ScenePicking.h
+
+  Ray cast picking of scene objects. A ray from the cursor through the
+  inverse view-projection is tested against a bounding volume hierarchy over
+  the objects' world space boxes, so only objects whose boxes the ray enters
+  have their triangles tested, nearest box first. The hierarchy is built with
+  the binned surface area heuristic (SAH) and refit in place when objects
+  move; the SAH cost of the refit tree tells when it has degraded enough to
+  be worth rebuilding.
+*/
+
+#ifndef SCENE_PICKING_H
+#define SCENE_PICKING_H
+
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/intersect.hpp>
+
+const int PICK_BVH_LEAF_SIZE = 4;           // Largest leaf the build makes
+const int PICK_BVH_BINS = 16;               // Candidate split planes per axis
+const int PICK_BVH_STACK_SIZE = 64;         // Traversal stack; the build never goes deeper
+const float PICK_BVH_REBUILD_RATIO = 1.5f;  // Rebuild once refits make the SAH cost this much worse
+
+struct PickBox
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// A ray with the reciprocal of its direction precomputed for the box tests
+struct PickRay
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+    glm::vec3 inverseDirection;
+};
+
+// Triangles of a mesh in object space: positions are the first three floats of each vertex
+struct PickMesh
+{
+    const float* vertices;
+    int floatsPerVertex;
+    const unsigned short* indices;
+    int indexCount;
+    PickBox bounds;         // Of the indexed vertices
+};
+
+struct PickHit
+{
+    int object;             // -1 when nothing was hit
+    float distance;         // Along the ray, in world units when the ray direction is normalized
+};
+
+// Interior nodes have count 0 and their left child right after them; leaves list count objects
+struct PickBvhNode
+{
+    PickBox box;
+    int first;      // Right child of an interior node, first entry in objects of a leaf
+    int count;
+    int parent;     // -1 for the root
+};
+
+struct PickBvh
+{
+    std::vector<PickBvhNode> nodes;     // Depth first, so every child comes after its parent
+    std::vector<int> objects;           // Object indices, grouped by leaf
+    std::vector<PickBox> objectBoxes;   // World space box of every object
+    std::vector<int> objectLeaf;        // Leaf holding every object
+    float builtCost;                    // SAH cost right after the last build
+};
+
+inline PickBox UEmptyPickBox()
+{
+    return { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+}
+
+inline void UGrowPickBox(PickBox& box, const glm::vec3& point)
+{
+    box.min = glm::min(box.min, point);
+    box.max = glm::max(box.max, point);
+}
+
+inline void UGrowPickBox(PickBox& box, const PickBox& other)
+{
+    box.min = glm::min(box.min, other.min);
+    box.max = glm::max(box.max, other.max);
+}
+
+inline float UPickBoxArea(const PickBox& box)
+{
+    glm::vec3 size = glm::max(box.max - box.min, glm::vec3(0.0f));
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+// World space box of an object space box: the center is transformed and the half extents
+// are summed along the absolute values of the matrix's axes
+inline PickBox UTransformPickBox(const PickBox& box, const glm::mat4& model)
+{
+    glm::vec3 center = glm::vec3(model * glm::vec4((box.min + box.max) * 0.5f, 1.0f));
+    glm::vec3 extent = (box.max - box.min) * 0.5f;
+    glm::mat3 axes = glm::mat3(model);
+    glm::vec3 worldExtent = glm::abs(axes[0]) * extent.x + glm::abs(axes[1]) * extent.y + glm::abs(axes[2]) * extent.z;
+    return { center - worldExtent, center + worldExtent };
+}
+
+inline PickRay UMakePickRay(const glm::vec3& origin, const glm::vec3& direction)
+{
+    return { origin, direction, 1.0f / direction };
+}
+
+// Ray from the camera through a point in window coordinates (origin top left), starting on the near plane
+inline PickRay UCursorPickRay(double x, double y, int width, int height, const glm::mat4& view, const glm::mat4& projection)
+{
+    glm::vec2 ndc(2.0f * (float)x / width - 1.0f, 1.0f - 2.0f * (float)y / height);
+    glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+
+    glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+
+    return UMakePickRay(origin, glm::normalize(glm::vec3(farPoint) / farPoint.w - origin));
+}
+
+// Slab test; entry is where the ray enters the box, 0 when it starts inside
+inline bool URayHitsPickBox(const PickRay& ray, const PickBox& box, float maxDistance, float& entry)
+{
+    glm::vec3 t0 = (box.min - ray.origin) * ray.inverseDirection;
+    glm::vec3 t1 = (box.max - ray.origin) * ray.inverseDirection;
+    glm::vec3 nearSlab = glm::min(t0, t1);
+    glm::vec3 farSlab = glm::max(t0, t1);
+
+    entry = std::max(std::max(nearSlab.x, nearSlab.y), std::max(nearSlab.z, 0.0f));
+    float leave = std::min(std::min(farSlab.x, farSlab.y), std::min(farSlab.z, maxDistance));
+    return entry <= leave;
+}
+
+inline PickMesh UMakePickMesh(const float* vertices, int floatsPerVertex, const unsigned short* indices, int indexCount)
+{
+    PickMesh mesh = { vertices, floatsPerVertex, indices, indexCount, UEmptyPickBox() };
+    for (int i = 0; i < indexCount; ++i)
+        UGrowPickBox(mesh.bounds, glm::make_vec3(vertices + (size_t)indices[i] * floatsPerVertex));
+    return mesh;
+}
+
+// Closest triangle of the mesh placed by model that the ray hits before maxDistance. The ray is
+// taken into object space without normalizing its direction, so distances stay in world units.
+inline bool UIntersectPickMesh(const PickMesh& mesh, const glm::mat4& model, const PickRay& ray, float maxDistance, float& distance)
+{
+    glm::mat4 inverseModel = glm::inverse(model);
+    glm::vec3 origin = glm::vec3(inverseModel * glm::vec4(ray.origin, 1.0f));
+    glm::vec3 direction = glm::mat3(inverseModel) * ray.direction;
+
+    bool isHit = false;
+    for (int i = 0; i + 2 < mesh.indexCount; i += 3) {
+        glm::vec3 v0 = glm::make_vec3(mesh.vertices + (size_t)mesh.indices[i] * mesh.floatsPerVertex);
+        glm::vec3 v1 = glm::make_vec3(mesh.vertices + (size_t)mesh.indices[i + 1] * mesh.floatsPerVertex);
+        glm::vec3 v2 = glm::make_vec3(mesh.vertices + (size_t)mesh.indices[i + 2] * mesh.floatsPerVertex);
+
+        glm::vec2 barycentric;
+        float t;
+        if (glm::intersectRayTriangle(origin, direction, v0, v1, v2, barycentric, t) && t >= 0.0f && t < maxDistance) {
+            maxDistance = t;
+            distance = t;
+            isHit = true;
+        }
+    }
+    return isHit;
+}
+
+// Builds the subtree over objects [begin, end) into node nodeIndex and the nodes appended after it.
+// The objects are split on the cheapest of PICK_BVH_BINS planes along the widest axis of their centers.
+inline void UBuildPickBvhNode(PickBvh& bvh, int nodeIndex, int begin, int end, int depth)
+{
+    PickBox box = UEmptyPickBox();
+    PickBox centers = UEmptyPickBox();
+    for (int i = begin; i < end; ++i) {
+        const PickBox& objectBox = bvh.objectBoxes[bvh.objects[i]];
+        UGrowPickBox(box, objectBox);
+        UGrowPickBox(centers, (objectBox.min + objectBox.max) * 0.5f);
+    }
+    bvh.nodes[nodeIndex].box = box;
+
+    int count = end - begin;
+    int axis = 0;
+    glm::vec3 spread = centers.max - centers.min;
+    if (spread.y > spread[axis])
+        axis = 1;
+    if (spread.z > spread[axis])
+        axis = 2;
+
+    // Leaf: a single object, centers that cannot be told apart, or the stack limit is near
+    bool isLeaf = count <= 1 || spread[axis] <= 0.0f || depth >= PICK_BVH_STACK_SIZE - 2;
+    int split = begin + count / 2;
+
+    if (!isLeaf) {
+        struct Bin
+        {
+            PickBox box;
+            int count;
+        };
+        Bin bins[PICK_BVH_BINS];
+        for (Bin& bin : bins)
+            bin = { UEmptyPickBox(), 0 };
+
+        float binScale = PICK_BVH_BINS / spread[axis];
+        auto binOf = [&](int object) {
+            const PickBox& objectBox = bvh.objectBoxes[object];
+            float center = (objectBox.min[axis] + objectBox.max[axis]) * 0.5f;
+            return std::min(PICK_BVH_BINS - 1, (int)((center - centers.min[axis]) * binScale));
+        };
+        for (int i = begin; i < end; ++i) {
+            Bin& bin = bins[binOf(bvh.objects[i])];
+            UGrowPickBox(bin.box, bvh.objectBoxes[bvh.objects[i]]);
+            ++bin.count;
+        }
+
+        // Cost of every split relative to the node's own area: one box test plus the objects on each side
+        float rightArea[PICK_BVH_BINS];
+        int rightCount[PICK_BVH_BINS];
+        PickBox rightBox = UEmptyPickBox();
+        int rightTotal = 0;
+        for (int b = PICK_BVH_BINS - 1; b > 0; --b) {
+            UGrowPickBox(rightBox, bins[b].box);
+            rightTotal += bins[b].count;
+            rightArea[b] = UPickBoxArea(rightBox);
+            rightCount[b] = rightTotal;
+        }
+
+        float bestCost = FLT_MAX;
+        int bestBin = -1;
+        PickBox leftBox = UEmptyPickBox();
+        int leftTotal = 0;
+        for (int b = 1; b < PICK_BVH_BINS; ++b) {
+            UGrowPickBox(leftBox, bins[b - 1].box);
+            leftTotal += bins[b - 1].count;
+            if (leftTotal == 0 || rightCount[b] == 0)
+                continue;
+            float cost = UPickBoxArea(leftBox) * leftTotal + rightArea[b] * rightCount[b];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestBin = b;
+            }
+        }
+
+        // Small nodes stay leaves unless a split is cheaper than testing every object
+        float area = UPickBoxArea(box);
+        if (count <= PICK_BVH_LEAF_SIZE && (bestBin < 0 || area * count <= area + bestCost)) {
+            isLeaf = true;
+        }
+        else if (bestBin >= 0) {
+            split = (int)(std::partition(bvh.objects.begin() + begin, bvh.objects.begin() + end,
+                                         [&](int object) { return binOf(object) < bestBin; }) - bvh.objects.begin());
+        }
+    }
+
+    if (isLeaf) {
+        bvh.nodes[nodeIndex].first = begin;
+        bvh.nodes[nodeIndex].count = count;
+        for (int i = begin; i < end; ++i)
+            bvh.objectLeaf[bvh.objects[i]] = nodeIndex;
+        return;
+    }
+
+    // Too many objects for a leaf with no useful plane: split them in half along the axis
+    if (split == begin || split == end) {
+        split = begin + count / 2;
+        std::nth_element(bvh.objects.begin() + begin, bvh.objects.begin() + split, bvh.objects.begin() + end, [&](int a, int b) {
+            return bvh.objectBoxes[a].min[axis] + bvh.objectBoxes[a].max[axis] < bvh.objectBoxes[b].min[axis] + bvh.objectBoxes[b].max[axis];
+        });
+    }
+
+    int left = (int)bvh.nodes.size();
+    bvh.nodes.push_back({ UEmptyPickBox(), 0, 0, nodeIndex });
+    UBuildPickBvhNode(bvh, left, begin, split, depth + 1);
+
+    int right = (int)bvh.nodes.size();
+    bvh.nodes.push_back({ UEmptyPickBox(), 0, 0, nodeIndex });
+    UBuildPickBvhNode(bvh, right, split, end, depth + 1);
+
+    bvh.nodes[nodeIndex].first = right;
+    bvh.nodes[nodeIndex].count = 0;
+}
+
+// SAH cost of the tree, relative to the root's area: expected box and object tests for a ray through the root
+inline float UPickBvhCost(const PickBvh& bvh)
+{
+    if (bvh.nodes.empty())
+        return 0.0f;
+
+    float cost = 0.0f;
+    for (const PickBvhNode& node : bvh.nodes)
+        cost += UPickBoxArea(node.box) * (node.count > 0 ? (float)node.count : 1.0f);
+    return cost / std::max(UPickBoxArea(bvh.nodes[0].box), FLT_MIN);
+}
+
+// Builds the hierarchy over objects with the given world space boxes; object i is reported as index i
+inline void UBuildPickBvh(PickBvh& bvh, const std::vector<PickBox>& boxes)
+{
+    bvh.objectBoxes = boxes;
+    bvh.objectLeaf.assign(boxes.size(), -1);
+    bvh.objects.resize(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i)
+        bvh.objects[i] = (int)i;
+
+    bvh.nodes.clear();
+    bvh.nodes.reserve(boxes.size() * 2);
+    if (!boxes.empty()) {
+        bvh.nodes.push_back({ UEmptyPickBox(), 0, 0, -1 });
+        UBuildPickBvhNode(bvh, 0, 0, (int)boxes.size(), 0);
+    }
+    bvh.builtCost = UPickBvhCost(bvh);
+}
+
+// Moves one object: its leaf and every ancestor are refit, stopping at the first box that does not change
+inline void URefitPickBvh(PickBvh& bvh, int object, const PickBox& box)
+{
+    bvh.objectBoxes[object] = box;
+
+    for (int nodeIndex = bvh.objectLeaf[object]; nodeIndex >= 0; nodeIndex = bvh.nodes[nodeIndex].parent) {
+        PickBvhNode& node = bvh.nodes[nodeIndex];
+        PickBox refit = UEmptyPickBox();
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; ++i)
+                UGrowPickBox(refit, bvh.objectBoxes[bvh.objects[i]]);
+        }
+        else {
+            refit = bvh.nodes[nodeIndex + 1].box;
+            UGrowPickBox(refit, bvh.nodes[node.first].box);
+        }
+
+        if (refit.min == node.box.min && refit.max == node.box.max)
+            break;
+        node.box = refit;
+    }
+}
+
+// Whether refits have degraded the tree so far that a rebuild pays off
+inline bool UPickBvhNeedsRebuild(const PickBvh& bvh)
+{
+    return UPickBvhCost(bvh) > bvh.builtCost * PICK_BVH_REBUILD_RATIO;
+}
+
+// Closest object hit by the ray. test(object, ray, maxDistance, distance) returns whether the object
+// itself is hit before maxDistance, and where; it is only called for objects whose box the ray enters.
+template <typename TestFunction>
+PickHit UCastPickRay(const PickBvh& bvh, const PickRay& ray, TestFunction test)
+{
+    PickHit hit = { -1, FLT_MAX };
+    float entry;
+    if (bvh.nodes.empty() || !URayHitsPickBox(ray, bvh.nodes[0].box, hit.distance, entry))
+        return hit;
+
+    int stack[PICK_BVH_STACK_SIZE];
+    int stackSize = 0;
+    int nodeIndex = 0;
+
+    for (;;) {
+        const PickBvhNode& node = bvh.nodes[nodeIndex];
+
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; ++i) {
+                int object = bvh.objects[i];
+                float distance;
+                if (URayHitsPickBox(ray, bvh.objectBoxes[object], hit.distance, entry) && test(object, ray, hit.distance, distance) &&
+                    distance < hit.distance) {
+                    hit.object = object;
+                    hit.distance = distance;
+                }
+            }
+        }
+        else {
+            // Visit the nearer child first; the farther one is skipped later if a hit comes before it
+            int left = nodeIndex + 1;
+            int right = node.first;
+            float leftEntry, rightEntry;
+            bool isLeftHit = URayHitsPickBox(ray, bvh.nodes[left].box, hit.distance, leftEntry);
+            bool isRightHit = URayHitsPickBox(ray, bvh.nodes[right].box, hit.distance, rightEntry);
+
+            if (isLeftHit && isRightHit) {
+                if (rightEntry < leftEntry)
+                    std::swap(left, right);
+                stack[stackSize++] = right;
+                nodeIndex = left;
+                continue;
+            }
+            if (isLeftHit || isRightHit) {
+                nodeIndex = isLeftHit ? left : right;
+                continue;
+            }
+        }
+
+        // Pop the next subtree that still starts before the closest hit so far
+        bool isFound = false;
+        while (stackSize > 0 && !isFound) {
+            nodeIndex = stack[--stackSize];
+            isFound = URayHitsPickBox(ray, bvh.nodes[nodeIndex].box, hit.distance, entry);
+        }
+        if (!isFound)
+            return hit;
+    }
+}
+
+#endif
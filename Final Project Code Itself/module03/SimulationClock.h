@@ -0,0 +1,76 @@
+/*
+* SimulationClock.h
+
+  Fixed-timestep simulation clock. Frame times are read from a 64-bit
+  monotonic tick counter (glfwGetTimerValue) and kept as integer ticks, so
+  nothing loses precision however long the program runs. Elapsed time is
+  accumulated and the simulation is advanced in whole steps of one fixed
+  length; what is left over becomes the blend factor between the previous
+  and current simulation states for rendering.
+
+  A frame that took too long would otherwise ask for more steps than can be
+  simulated in a frame, falling further behind each time. Steps are capped
+  per frame and the time beyond the cap is dropped, so the simulation slows
+  down instead.
+*/
+
+#ifndef SIMULATION_CLOCK_H
+#define SIMULATION_CLOCK_H
+
+#include <cstdint>
+
+struct SimulationClock
+{
+    uint64_t frequency;     // Timer ticks per second
+    uint64_t stepTicks;     // Length of one simulation step
+    uint64_t lastTime;      // Timer value at the last advance
+    uint64_t accumulator;   // Ticks elapsed but not simulated yet, less than stepTicks after an advance
+    uint64_t stepCount;     // Steps simulated since the clock started
+    int maxStepsPerFrame;
+};
+
+inline void UStartSimulationClock(SimulationClock& clock, uint64_t now, uint64_t frequency, int stepsPerSecond, int maxStepsPerFrame)
+{
+    clock.frequency = frequency;
+    clock.stepTicks = frequency / (uint64_t)stepsPerSecond;
+    clock.lastTime = now;
+    clock.accumulator = 0;
+    clock.stepCount = 0;
+    clock.maxStepsPerFrame = maxStepsPerFrame;
+}
+
+inline double UTicksToSeconds(const SimulationClock& clock, uint64_t ticks)
+{
+    return (double)ticks / (double)clock.frequency;
+}
+
+// Exact length of a step in seconds; stepTicks is rounded down so this is what is simulated
+inline double USimulationStepSeconds(const SimulationClock& clock)
+{
+    return UTicksToSeconds(clock, clock.stepTicks);
+}
+
+// Accumulates the time since the last advance and returns the number of steps to simulate now
+inline int UAdvanceSimulationClock(SimulationClock& clock, uint64_t now)
+{
+    clock.accumulator += now - clock.lastTime;
+    clock.lastTime = now;
+
+    uint64_t steps = clock.accumulator / clock.stepTicks;
+    if (steps > (uint64_t)clock.maxStepsPerFrame) {
+        steps = (uint64_t)clock.maxStepsPerFrame;
+        clock.accumulator = steps * clock.stepTicks + clock.accumulator % clock.stepTicks;
+    }
+
+    clock.accumulator -= steps * clock.stepTicks;
+    clock.stepCount += steps;
+    return (int)steps;
+}
+
+// How far rendering is between the previous and current simulation states, in [0, 1)
+inline double USimulationAlpha(const SimulationClock& clock)
+{
+    return (double)clock.accumulator / (double)clock.stepTicks;
+}
+
+#endif
@@ -0,0 +1,143 @@
+/*
+* StaticTransform.h
+
+  Model matrices for scenery that never moves, built entirely at compile
+  time. glm's matrices are only constexpr when glm is compiled without SIMD,
+  and its rotate calls the runtime sin and cos, so placements are composed
+  here as plain column-major float arrays with constexpr scale, rotate,
+  translate and multiply. Declared static constexpr, the finished matrices
+  are emitted as read-only data and only copied into a glm::mat4 where one
+  is needed.
+
+  The functions mirror glm::scale, glm::rotate (angle in radians, axis
+  normalized) and glm::translate. The trigonometry is evaluated in double
+  precision, so results agree with glm's to float rounding.
+*/
+
+#ifndef STATIC_TRANSFORM_H
+#define STATIC_TRANSFORM_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// Column-major 4x4 matrix: element (column, row) is m[column * 4 + row], as in glm
+struct StaticTransform
+{
+    float m[16];
+};
+
+constexpr double STATIC_TRANSFORM_PI = 3.14159265358979323846;
+
+// sin and cos by their Taylor series after reducing the angle to [-pi, pi]
+constexpr double UStaticReduceAngle(double radians)
+{
+    double turns = radians / (2.0 * STATIC_TRANSFORM_PI);
+    long long nearestTurn = (long long)(turns + (turns >= 0.0 ? 0.5 : -0.5));
+    return radians - (double)nearestTurn * 2.0 * STATIC_TRANSFORM_PI;
+}
+
+constexpr double UStaticSeries(double x, double term, int firstPower)
+{
+    // term is x^firstPower / firstPower!; each following term is -x^2 / ((n + 1)(n + 2)) times it
+    double sum = 0.0;
+    for (int n = firstPower; n < firstPower + 40; n += 2) {
+        sum += term;
+        term *= -x * x / ((n + 1) * (n + 2));
+    }
+    return sum;
+}
+
+constexpr double UStaticSin(double radians)
+{
+    double x = UStaticReduceAngle(radians);
+    return UStaticSeries(x, x, 1);
+}
+
+constexpr double UStaticCos(double radians)
+{
+    return UStaticSeries(UStaticReduceAngle(radians), 1.0, 0);
+}
+
+// Newton's method from a starting guess of at least the root
+constexpr double UStaticSqrt(double value)
+{
+    if (value <= 0.0)
+        return 0.0;
+
+    double root = value > 1.0 ? value : 1.0;
+    for (int i = 0; i < 100; ++i) {
+        double next = 0.5 * (root + value / root);
+        if (next >= root)
+            break;
+        root = next;
+    }
+    return root;
+}
+
+constexpr StaticTransform UStaticIdentity()
+{
+    return { { 1.0f, 0.0f, 0.0f, 0.0f,
+               0.0f, 1.0f, 0.0f, 0.0f,
+               0.0f, 0.0f, 1.0f, 0.0f,
+               0.0f, 0.0f, 0.0f, 1.0f } };
+}
+
+constexpr StaticTransform operator*(const StaticTransform& a, const StaticTransform& b)
+{
+    StaticTransform product = {};
+    for (int column = 0; column < 4; ++column)
+        for (int row = 0; row < 4; ++row) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k)
+                sum += a.m[k * 4 + row] * b.m[column * 4 + k];
+            product.m[column * 4 + row] = sum;
+        }
+    return product;
+}
+
+constexpr StaticTransform UStaticScale(float x, float y, float z)
+{
+    StaticTransform scale = UStaticIdentity();
+    scale.m[0] = x;
+    scale.m[5] = y;
+    scale.m[10] = z;
+    return scale;
+}
+
+constexpr StaticTransform UStaticTranslate(float x, float y, float z)
+{
+    StaticTransform translation = UStaticIdentity();
+    translation.m[12] = x;
+    translation.m[13] = y;
+    translation.m[14] = z;
+    return translation;
+}
+
+// Rotation by radians about the axis (x, y, z), which need not be normalized
+constexpr StaticTransform UStaticRotate(float radians, float x, float y, float z)
+{
+    double length = UStaticSqrt((double)x * x + (double)y * y + (double)z * z);
+    double ax = x / length, ay = y / length, az = z / length;
+    double c = UStaticCos(radians);
+    double s = UStaticSin(radians);
+    double t = 1.0 - c;
+
+    StaticTransform rotation = UStaticIdentity();
+    rotation.m[0] = (float)(c + t * ax * ax);
+    rotation.m[1] = (float)(t * ax * ay + s * az);
+    rotation.m[2] = (float)(t * ax * az - s * ay);
+    rotation.m[4] = (float)(t * ay * ax - s * az);
+    rotation.m[5] = (float)(c + t * ay * ay);
+    rotation.m[6] = (float)(t * ay * az + s * ax);
+    rotation.m[8] = (float)(t * az * ax + s * ay);
+    rotation.m[9] = (float)(t * az * ay - s * ax);
+    rotation.m[10] = (float)(c + t * az * az);
+    return rotation;
+}
+
+inline glm::mat4 UToMat4(const StaticTransform& transform)
+{
+    return glm::make_mat4(transform.m);
+}
+
+#endif
@@ -0,0 +1,51 @@
+/*
+* StbImageAug.c
+
+  Builds includes/stb_image_aug.c as its own translation unit for the decoder
+  benchmark. The decoder calls malloc, realloc and free directly, so they are
+  redirected to the counting allocator once the C headers are in. The DDS
+  loader is left out; its sources are not part of this tree.
+*/
+
+#include <assert.h>
+#include <math.h>
+#include <memory.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "StbImageAug.h"
+
+#define STBI_NO_DDS
+#define STBI_NO_WRITE
+
+#define malloc(size) UCountedMalloc(size)
+#define realloc(block, size) UCountedRealloc(block, size)
+#define free(block) UCountedFree(block)
+
+#include <stb_image_aug.c>
+
+#undef malloc
+#undef realloc
+#undef free
+
+unsigned char* UAugLoadFromMemory(const unsigned char* buffer, int length, int* width, int* height, int* channels, int requiredChannels)
+{
+    return stbi_load_from_memory(buffer, length, width, height, channels, requiredChannels);
+}
+
+float* UAugLoadfFromMemory(const unsigned char* buffer, int length, int* width, int* height, int* channels, int requiredChannels)
+{
+    return stbi_loadf_from_memory(buffer, length, width, height, channels, requiredChannels);
+}
+
+void UAugImageFree(void* image)
+{
+    stbi_image_free(image);
+}
+
+const char* UAugFailureReason(void)
+{
+    return stbi_failure_reason();
+}
@@ -0,0 +1,34 @@
+/*
+* StbImageAug.h
+
+  The older stb_image_aug decoder (stbi 1.16) behind prefixed entry points, so
+  it can be linked into the same program as stb_image.h, whose public functions
+  have the same names. StbImageAug.c compiles the decoder with its heap calls
+  routed through the counting allocator declared here.
+*/
+
+#ifndef STB_IMAGE_AUG_H
+#define STB_IMAGE_AUG_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Heap calls made by the decoders under test; defined by the program that links StbImageAug.c
+void* UCountedMalloc(size_t size);
+void* UCountedRealloc(void* block, size_t size);
+void UCountedFree(void* block);
+
+// stbi_load_from_memory, stbi_loadf_from_memory, stbi_image_free and stbi_failure_reason from stb_image_aug
+unsigned char* UAugLoadFromMemory(const unsigned char* buffer, int length, int* width, int* height, int* channels, int requiredChannels);
+float* UAugLoadfFromMemory(const unsigned char* buffer, int length, int* width, int* height, int* channels, int requiredChannels);
+void UAugImageFree(void* image);
+const char* UAugFailureReason(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,367 @@
+/*
+* VirtualTexture.h
+
+  CPU side of tiled virtual texturing. Large images are pre-tiled, with
+  borders for filtering, into a page file holding every mip. At run time a
+  fixed number of tiles are resident in a physical cache; tiles requested
+  by the GPU feedback pass are read from the memory-mapped page file on a
+  streaming thread, and an indirection table maps every virtual tile to the
+  cache slot of itself or its closest resident ancestor.
+*/
+
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "MappedFile.h"
+#include "MipGeneration.h"
+
+const int VT_TILE_SIZE = 128;                                   // Texels per tile side in the cache, borders included
+const int VT_TILE_BORDER = 4;                                   // Texels copied from neighbouring tiles on each side
+const int VT_TILE_PAYLOAD = VT_TILE_SIZE - 2 * VT_TILE_BORDER;  // Texels of the tile's own area per side
+const int VT_TILE_BYTES = VT_TILE_SIZE * VT_TILE_SIZE * 4;      // RGBA8
+const int VT_MAX_MIPS = 16;
+const unsigned int VT_NO_TILE = 0xFFFFFFFFu;                    // Feedback value for pixels without a request
+
+// Page file layout: this header, then every tile of mip 0 row by row, then mip 1, ...
+struct VirtualTextureHeader
+{
+    char magic[4];          // "VTPF"
+    unsigned int version;
+    unsigned int width;     // Base level size in texels
+    unsigned int height;
+    unsigned int mipCount;  // The last mip fits in a single tile
+    unsigned int tileSize;
+    unsigned int tileBorder;
+};
+
+const unsigned int VT_PAGE_FILE_VERSION = 1;
+
+// Tile ids pack the mip and tile coordinates the same way the feedback shader does
+inline unsigned int UVirtualTileId(int mip, int x, int y)
+{
+    return ((unsigned int)mip << 28) | ((unsigned int)y << 14) | (unsigned int)x;
+}
+
+inline int UVirtualTileMip(unsigned int id) { return (int)(id >> 28); }
+inline int UVirtualTileY(unsigned int id) { return (int)((id >> 14) & 0x3FFF); }
+inline int UVirtualTileX(unsigned int id) { return (int)(id & 0x3FFF); }
+
+// Size of a mip in texels, matching floor(size / 2^mip) in the shaders
+inline int UVirtualMipSize(int size, int mip)
+{
+    return std::max(1, size >> mip);
+}
+
+inline int UVirtualTileCount(int mipSize)
+{
+    return (mipSize + VT_TILE_PAYLOAD - 1) / VT_TILE_PAYLOAD;
+}
+
+// Mips down to the first one that fits in a single tile
+inline int UVirtualMipCount(int width, int height)
+{
+    int mips = 1;
+    while (mips < VT_MAX_MIPS && (UVirtualMipSize(width, mips - 1) > VT_TILE_PAYLOAD || UVirtualMipSize(height, mips - 1) > VT_TILE_PAYLOAD))
+        ++mips;
+    return mips;
+}
+
+// Copies one tile with its borders out of an RGBA8 level, clamping at the level's edges
+inline void UExtractVirtualTile(const unsigned char* level, int width, int height, int tileX, int tileY, unsigned char* tile)
+{
+    int originX = tileX * VT_TILE_PAYLOAD - VT_TILE_BORDER;
+    int originY = tileY * VT_TILE_PAYLOAD - VT_TILE_BORDER;
+
+    for (int y = 0; y < VT_TILE_SIZE; ++y) {
+        int srcY = std::min(std::max(originY + y, 0), height - 1);
+        for (int x = 0; x < VT_TILE_SIZE; ++x) {
+            int srcX = std::min(std::max(originX + x, 0), width - 1);
+            memcpy(tile + ((size_t)y * VT_TILE_SIZE + x) * 4, level + ((size_t)srcY * width + srcX) * 4, 4);
+        }
+    }
+}
+
+// Offline step: tiles an RGBA8 image (rows bottom-up, as uploaded to OpenGL) and its mip chain into a
+// page file. The image has to fit in memory once here; at run time only resident tiles are.
+inline bool UBuildVirtualTexturePageFile(const unsigned char* image, int width, int height, const char* pageFilename)
+{
+    FILE* file = fopen(pageFilename, "wb");
+    if (!file)
+        return false;
+
+    VirtualTextureHeader header = { { 'V', 'T', 'P', 'F' }, VT_PAGE_FILE_VERSION, (unsigned int)width, (unsigned int)height,
+                                    (unsigned int)UVirtualMipCount(width, height), VT_TILE_SIZE, VT_TILE_BORDER };
+    bool isWritten = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    std::vector<MipLevel> mips = UGenerateMipChain(image, width, height, 4, MIP_FILTER_KAISER, true);
+    std::vector<unsigned char> tile(VT_TILE_BYTES);
+
+    for (int mip = 0; mip < (int)header.mipCount && isWritten; ++mip) {
+        const unsigned char* level = mip == 0 ? image : &mips[mip - 1].pixels[0];
+        int levelWidth = UVirtualMipSize(width, mip);
+        int levelHeight = UVirtualMipSize(height, mip);
+
+        for (int y = 0; y < UVirtualTileCount(levelHeight) && isWritten; ++y) {
+            for (int x = 0; x < UVirtualTileCount(levelWidth) && isWritten; ++x) {
+                UExtractVirtualTile(level, levelWidth, levelHeight, x, y, &tile[0]);
+                isWritten = fwrite(&tile[0], VT_TILE_BYTES, 1, file) == 1;
+            }
+        }
+    }
+
+    return fclose(file) == 0 && isWritten;
+}
+
+// Run time state of one virtual texture: the mapped page file, the streaming thread and the
+// residency of the physical cache. GPU resources are owned by the renderer.
+struct VirtualTexture
+{
+    MappedFile pageFile;
+    VirtualTextureHeader header;
+    int tilesX[VT_MAX_MIPS];
+    int tilesY[VT_MAX_MIPS];
+    size_t firstTile[VT_MAX_MIPS];                  // Index of each mip's first tile in the page file
+    int mipRowOffset[VT_MAX_MIPS];                  // First indirection row of each mip
+
+    // Physical cache: cacheSlots x cacheSlots tiles
+    int cacheSlots;
+    std::unordered_map<unsigned int, int> residentSlot;
+    std::vector<unsigned int> slotTile;             // VT_NO_TILE for free slots
+    std::vector<unsigned int> slotLastUsed;         // Frame the tile was last requested by the feedback pass
+    unsigned int frame;
+
+    // Indirection table: one RGBA8 entry per tile of every mip (slot x, slot y, mip of the resident data, 255)
+    int indirectionWidth;
+    int indirectionHeight;
+    std::vector<unsigned char> indirection;
+    bool isIndirectionDirty;
+
+    // Streaming thread: reads requested tiles from the page file
+    std::thread streamer;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<unsigned int> requests;
+    std::vector<std::pair<unsigned int, std::vector<unsigned char>>> completed;
+    std::unordered_set<unsigned int> inFlight;      // Requested and not yet made resident
+    bool isStopping;
+};
+
+inline const unsigned char* UVirtualTileData(const VirtualTexture& vt, unsigned int id)
+{
+    size_t index = vt.firstTile[UVirtualTileMip(id)] + (size_t)UVirtualTileY(id) * vt.tilesX[UVirtualTileMip(id)] + UVirtualTileX(id);
+    return vt.pageFile.data + sizeof(VirtualTextureHeader) + index * VT_TILE_BYTES;
+}
+
+// Rebuilds the indirection table: every tile points at itself if resident, otherwise at its parent's entry
+inline void URebuildVirtualIndirection(VirtualTexture& vt)
+{
+    int mipCount = (int)vt.header.mipCount;
+
+    for (int mip = mipCount - 1; mip >= 0; --mip) {
+        for (int y = 0; y < vt.tilesY[mip]; ++y) {
+            for (int x = 0; x < vt.tilesX[mip]; ++x) {
+                unsigned char* entry = &vt.indirection[((size_t)(vt.mipRowOffset[mip] + y) * vt.indirectionWidth + x) * 4];
+                auto resident = vt.residentSlot.find(UVirtualTileId(mip, x, y));
+
+                if (resident != vt.residentSlot.end()) {
+                    entry[0] = (unsigned char)(resident->second % vt.cacheSlots);
+                    entry[1] = (unsigned char)(resident->second / vt.cacheSlots);
+                    entry[2] = (unsigned char)mip;
+                    entry[3] = 255;
+                }
+                else if (mip + 1 < mipCount) {
+                    int parentX = std::min(x / 2, vt.tilesX[mip + 1] - 1);
+                    int parentY = std::min(y / 2, vt.tilesY[mip + 1] - 1);
+                    memcpy(entry, &vt.indirection[((size_t)(vt.mipRowOffset[mip + 1] + parentY) * vt.indirectionWidth + parentX) * 4], 4);
+                }
+                else {
+                    memset(entry, 0, 4); // Nothing resident yet; alpha 0 tells the shader to use a flat fallback
+                }
+            }
+        }
+    }
+
+    vt.isIndirectionDirty = true;
+}
+
+// Records the tiles seen by the feedback pass: resident ones are marked used this frame, missing ones
+// are queued for streaming (coarsest first, so fallbacks sharpen progressively)
+inline void URequestVirtualTiles(VirtualTexture& vt, std::vector<unsigned int>& tiles)
+{
+    ++vt.frame;
+
+    std::sort(tiles.begin(), tiles.end());
+    tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+    std::stable_sort(tiles.begin(), tiles.end(), [](unsigned int a, unsigned int b) { return UVirtualTileMip(a) > UVirtualTileMip(b); });
+
+    std::vector<unsigned int> missing;
+    for (unsigned int id : tiles) {
+        if (id == VT_NO_TILE || UVirtualTileMip(id) >= (int)vt.header.mipCount ||
+            UVirtualTileX(id) >= vt.tilesX[UVirtualTileMip(id)] || UVirtualTileY(id) >= vt.tilesY[UVirtualTileMip(id)])
+            continue;
+
+        auto resident = vt.residentSlot.find(id);
+        if (resident != vt.residentSlot.end())
+            vt.slotLastUsed[resident->second] = vt.frame;
+        else if (vt.inFlight.insert(id).second)
+            missing.push_back(id);
+    }
+
+    if (!missing.empty()) {
+        {
+            std::lock_guard<std::mutex> guard(vt.lock);
+            vt.requests.insert(vt.requests.end(), missing.begin(), missing.end());
+        }
+        vt.wake.notify_one();
+    }
+}
+
+// Takes up to maxTiles streamed tiles and assigns each a cache slot, evicting the least recently used
+// tile that was not requested this frame. upload(slot, pixels) copies the tile into the cache texture.
+template <typename UploadFunction>
+int UResolveVirtualTiles(VirtualTexture& vt, int maxTiles, UploadFunction upload)
+{
+    std::vector<std::pair<unsigned int, std::vector<unsigned char>>> ready;
+    {
+        std::lock_guard<std::mutex> guard(vt.lock);
+        int count = std::min((int)vt.completed.size(), maxTiles);
+        ready.assign(std::make_move_iterator(vt.completed.begin()), std::make_move_iterator(vt.completed.begin() + count));
+        vt.completed.erase(vt.completed.begin(), vt.completed.begin() + count);
+    }
+
+    int uploaded = 0;
+    for (auto& tile : ready) {
+        vt.inFlight.erase(tile.first);
+
+        // The coarsest mip is a single tile and stays resident as the fallback for everything
+        unsigned int pinned = UVirtualTileId((int)vt.header.mipCount - 1, 0, 0);
+        int slot = -1;
+        for (int i = 0; i < (int)vt.slotTile.size(); ++i) {
+            if (vt.slotTile[i] == VT_NO_TILE) {
+                slot = i;
+                break;
+            }
+            if (vt.slotTile[i] != pinned && vt.slotLastUsed[i] != vt.frame &&
+                (slot < 0 || vt.slotLastUsed[i] < vt.slotLastUsed[slot]))
+                slot = i;
+        }
+
+        // Every slot is in use this frame: the cache budget is too small for the view, keep the fallback
+        if (slot < 0)
+            continue;
+
+        if (vt.slotTile[slot] != VT_NO_TILE)
+            vt.residentSlot.erase(vt.slotTile[slot]);
+
+        upload(slot, &tile.second[0]);
+        vt.slotTile[slot] = tile.first;
+        vt.slotLastUsed[slot] = vt.frame;
+        vt.residentSlot[tile.first] = slot;
+        ++uploaded;
+    }
+
+    if (uploaded > 0)
+        URebuildVirtualIndirection(vt);
+
+    return uploaded;
+}
+
+// Opens a page file, sizes the residency tables for a cacheSlots x cacheSlots cache and starts the streaming thread
+inline bool UOpenVirtualTexture(VirtualTexture& vt, const char* pageFilename, int cacheSlots)
+{
+    if (!UMapFile(pageFilename, vt.pageFile))
+        return false;
+
+    memcpy(&vt.header, vt.pageFile.data, std::min(sizeof(vt.header), vt.pageFile.size));
+    if (vt.pageFile.size < sizeof(vt.header) || memcmp(vt.header.magic, "VTPF", 4) != 0 || vt.header.version != VT_PAGE_FILE_VERSION ||
+        vt.header.tileSize != VT_TILE_SIZE || vt.header.tileBorder != VT_TILE_BORDER ||
+        vt.header.mipCount == 0 || vt.header.mipCount > VT_MAX_MIPS) {
+        UUnmapFile(vt.pageFile);
+        return false;
+    }
+
+    size_t tiles = 0;
+    int rows = 0;
+    for (int mip = 0; mip < (int)vt.header.mipCount; ++mip) {
+        vt.tilesX[mip] = UVirtualTileCount(UVirtualMipSize(vt.header.width, mip));
+        vt.tilesY[mip] = UVirtualTileCount(UVirtualMipSize(vt.header.height, mip));
+        vt.firstTile[mip] = tiles;
+        vt.mipRowOffset[mip] = rows;
+        tiles += (size_t)vt.tilesX[mip] * vt.tilesY[mip];
+        rows += vt.tilesY[mip];
+    }
+
+    if (vt.pageFile.size < sizeof(vt.header) + tiles * VT_TILE_BYTES) {
+        UUnmapFile(vt.pageFile);
+        return false;
+    }
+
+    vt.cacheSlots = cacheSlots;
+    vt.residentSlot.clear();
+    vt.slotTile.assign((size_t)cacheSlots * cacheSlots, VT_NO_TILE);
+    vt.slotLastUsed.assign((size_t)cacheSlots * cacheSlots, 0);
+    vt.frame = 0;
+
+    vt.indirectionWidth = vt.tilesX[0];
+    vt.indirectionHeight = rows;
+    vt.indirection.assign((size_t)vt.indirectionWidth * vt.indirectionHeight * 4, 0);
+    vt.isIndirectionDirty = true;
+
+    vt.requests.clear();
+    vt.completed.clear();
+    vt.inFlight.clear();
+    vt.isStopping = false;
+
+    vt.streamer = std::thread([&vt]() {
+        std::unique_lock<std::mutex> guard(vt.lock);
+        for (;;) {
+            vt.wake.wait(guard, [&vt]() { return vt.isStopping || !vt.requests.empty(); });
+            if (vt.isStopping)
+                return;
+
+            unsigned int id = vt.requests.front();
+            vt.requests.pop_front();
+
+            // Copy out of the mapping without holding the lock; page faults happen here, not on the render thread
+            guard.unlock();
+            const unsigned char* data = UVirtualTileData(vt, id);
+            std::vector<unsigned char> tile(data, data + VT_TILE_BYTES);
+            guard.lock();
+
+            vt.completed.emplace_back(id, std::move(tile));
+        }
+    });
+
+    // The coarsest mip backs every fallback, so it is streamed in before anything asks for it
+    std::vector<unsigned int> top(1, UVirtualTileId((int)vt.header.mipCount - 1, 0, 0));
+    URequestVirtualTiles(vt, top);
+
+    return true;
+}
+
+inline void UCloseVirtualTexture(VirtualTexture& vt)
+{
+    if (vt.streamer.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(vt.lock);
+            vt.isStopping = true;
+        }
+        vt.wake.notify_one();
+        vt.streamer.join();
+    }
+
+    UUnmapFile(vt.pageFile);
+}
+
+#endif